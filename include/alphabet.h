@@ -27,11 +27,16 @@
 #ifndef ALPHABET_H_
 #define ALPHABET_H_
 
+// Code of the chars that are not a nucleotide (see Alphabet::code)
+#define NOT_NUCLEOTIDE 4
+
 /*
  * Alphabet is a singleton class (instanciate once and only once)
  *
  * It is used to know if a char is an A, C, G, or T
- * See usage in index_reads.h and search_reads.h
+ * and to get its 2 bits code: A -> 0, C -> 1, G -> 2, T -> 3
+ * (NOT_NUCLEOTIDE for any other char, the only code with the bit 2 set)
+ * See usage in hash_key.h, index_reads.h and search_reads.h
  */
 class Alphabet
 {
@@ -41,24 +46,32 @@ public:
 		static Alphabet theOnlyInstance;
 		return &theOnlyInstance;
 	}
-	bool is_in (int i) {return (bool) alpha[i];};
+	bool is_in (int i) {return codes[(unsigned char) i] != NOT_NUCLEOTIDE;};
+	const unsigned char & code (const char & c) const {return codes[(unsigned char) c];};
+	
+	// Table of the 256 codes, indexed by unsigned char
+	const unsigned char * get_codes () const {return codes;};
+	
+	// All ones for the code of a nucleotide, 0 for NOT_NUCLEOTIDE, to clear
+	// a count without a branch (see count_kmers in index_reads.h)
+	static unsigned long valid_mask (const unsigned long & code) {return (code >> 2) - 1;};
 private:
 	Alphabet() {
-		for (int i = 0; i < 255; i++) {
-			alpha[i] = 0;
+		for (int i = 0; i < 256; i++) {
+			codes[i] = NOT_NUCLEOTIDE;
 		}
-		alpha[(int)'A'] = 1;
-		alpha[(int)'a'] = 1;
-		alpha[(int)'C'] = 1;
-		alpha[(int)'c'] = 1;
-		alpha[(int)'G'] = 1;
-		alpha[(int)'g'] = 1;
-		alpha[(int)'T'] = 1;
-		alpha[(int)'t'] = 1;
+		codes[(int)'A'] = 0;
+		codes[(int)'a'] = 0;
+		codes[(int)'C'] = 1;
+		codes[(int)'c'] = 1;
+		codes[(int)'G'] = 2;
+		codes[(int)'g'] = 2;
+		codes[(int)'T'] = 3;
+		codes[(int)'t'] = 3;
 	};
 	~Alphabet() {};
 	
-	char alpha [255];
+	unsigned char codes [256];
 };
 
 #endif
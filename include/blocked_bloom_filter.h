@@ -0,0 +1,150 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCKED_BLOOM_FILTER_H_
+#define BLOCKED_BLOOM_FILTER_H_
+
+#include "bloom_filter.h"
+
+// Size of a block in bytes (one cache line)
+#define BLOOM_BLOCK_SIZE 64
+
+/*
+ * Blocked Bloom filter
+ *
+ * The 4 bits of a k-mer are set in a single block of 64 bytes (a cache
+ * line) so that a query costs one cache miss instead of 4.
+ * By default the filter has the same size as the classic one (2^(k-1)
+ * bytes), a memory budget is rounded down to a power of 2.
+ *
+ * The block is given by the low bits of the mixed key of the k-mer and the
+ * positions of the 4 bits in the block (4 x 9 bits) by its 36 high bits.
+ */
+class BlockedBloomFilter : public BloomFilter
+{
+private:
+	unsigned long block_mask;
+	
+	char * block (const unsigned long & key) const
+	{
+		return bloom_vector + (key & block_mask) * BLOOM_BLOCK_SIZE;
+	}
+	
+	static unsigned long bit_pos (const unsigned long & key, const int & i)
+	{
+		return (key >> (28 + 9 * i)) & 511;
+	}
+	
+	static char bit_mask (const unsigned long & pos)
+	{
+		return (char) (1 << (pos % 8));
+	}
+	
+public:
+	// size must be a power of 2 (see index_size in index_type.h)
+	BlockedBloomFilter (const int & kmer_size, const unsigned long & size, const char * vector = NULL)
+	{
+		init(size, vector);
+		index_type = BLOCKED_INDEX;
+		// bloom_size is a power of 2, so is the number of blocks
+		if (bloom_size >= BLOOM_BLOCK_SIZE) {
+			block_mask = bloom_size / BLOOM_BLOCK_SIZE - 1;
+		} else {
+			block_mask = 0;
+		}
+	}
+	
+	void feed (const HashKey & hash_key)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		char * current_block = block(key);
+		for (int i = 0; i < 4; i++) {
+			current_block[bit_pos(key, i) / 8] |= bit_mask(bit_pos(key, i));
+		}
+	}
+	
+	void feed_atomic (const HashKey & hash_key)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		const unsigned long block_pos = (key & block_mask) * BLOOM_BLOCK_SIZE;
+		for (int i = 0; i < 4; i++) {
+			feed_atomic_bit(block_pos + bit_pos(key, i) / 8, bit_mask(bit_pos(key, i)));
+		}
+	}
+	
+	bool feed_new (const HashKey & hash_key, const bool & atomic)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		const unsigned long block_pos = (key & block_mask) * BLOOM_BLOCK_SIZE;
+		bool is_new = false;
+		for (int i = 0; i < 4; i++) {
+			is_new |= set_new_bit(block_pos + bit_pos(key, i) / 8, bit_mask(bit_pos(key, i)), atomic);
+		}
+		return is_new;
+	}
+	
+	// The 4 bits of a k-mer are in the same block: the estimated false
+	// positive rate is the mean of the occupancy^4 of the blocks
+	double get_fpr (const unsigned long & step = 0) const
+	{
+		const unsigned long nb_blocks = bloom_size / BLOOM_BLOCK_SIZE;
+		if (nb_blocks == 0) {
+			return pow(get_occupancy(step), 4);
+		}
+		double fpr = 0;
+		unsigned long nb_read_blocks = 0;
+		for (unsigned long block_pos = step / 2; block_pos < nb_blocks; block_pos += std::max(step, 1UL)) {
+			unsigned long nb_bits = 0;
+			if (step == 0) {
+				count_bits(bloom_vector + block_pos * BLOOM_BLOCK_SIZE, BLOOM_BLOCK_SIZE, &nb_bits);
+			} else {
+				nb_bits = count_line_atomic(block_pos);
+			}
+			const double occupancy = nb_bits / (8.0 * BLOOM_BLOCK_SIZE);
+			fpr += occupancy * occupancy * occupancy * occupancy;
+			nb_read_blocks++;
+		}
+		return fpr / nb_read_blocks;
+	}
+	
+	void prefetch (const HashKey & hash_key) const
+	{
+		__builtin_prefetch(block(hash_key.mixed_key()));
+	}
+	
+	bool is_found (const HashKey & hash_key) const
+	{
+		const unsigned long key = hash_key.mixed_key();
+		const char * current_block = block(key);
+		return
+		(current_block[bit_pos(key, 0) / 8] & bit_mask(bit_pos(key, 0))) &&
+		(current_block[bit_pos(key, 1) / 8] & bit_mask(bit_pos(key, 1))) &&
+		(current_block[bit_pos(key, 2) / 8] & bit_mask(bit_pos(key, 2))) &&
+		(current_block[bit_pos(key, 3) / 8] & bit_mask(bit_pos(key, 3)));
+	}
+};
+
+#endif
@@ -31,8 +31,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 #include "hash_key.h"
+#include "index_memory.h"
+
+// Filters are merged by vectors of 2 words (SSE2, NEON)
+typedef unsigned long merge_vector_t __attribute__ ((vector_size (16)));
+
+// Number of random k-mers searched to measure the false positive rate of a
+// classic filter (see BloomFilter::get_fpr)
+#define BLOOM_FPR_PROBES (1UL << 20)
+
+/*
+ * Types of index that can be built from the reads (see index_type.h)
+ */
+enum IndexType
+{
+	CLASSIC_INDEX,
+	BLOCKED_INDEX,
+	HASHED_INDEX,
+	EXACT_INDEX,
+	SLICED_INDEX
+};
 
 /*
  * 4 hash functions
@@ -44,9 +65,14 @@
 
 class BloomFilter
 {
-private:
+protected:
+	int index_type;
+	bool canonical;
+	char * bloom_memory;
 	char * bloom_vector;
 	long bloom_size;
+	unsigned long memory_size;
+	int memory_path;
 	char MASK_A_EVEN;
 	char MASK_B_EVEN;
 	char MASK_C_EVEN;
@@ -56,9 +82,51 @@ private:
 	char MASK_C_ODD;
 	char MASK_D_ODD;
 
+	void feed_atomic_bit (const unsigned long & pos, const char & mask)
+	{
+		if (!(__atomic_load_n(&bloom_vector[pos], __ATOMIC_RELAXED) & mask)) {
+			__atomic_fetch_or(&bloom_vector[pos], mask, __ATOMIC_RELAXED);
+		}
+	}
 	
-public:
-	explicit BloomFilter (const int & kmer_size)
+	// Same as feed_atomic_bit, or a plain 'or', and return true if the bit
+	// was not set (see feed_new)
+	bool set_new_bit (const unsigned long & pos, const char & mask, const bool & atomic)
+	{
+		if (__atomic_load_n(&bloom_vector[pos], __ATOMIC_RELAXED) & mask) {
+			return false;
+		}
+		if (!atomic) {
+			bloom_vector[pos] |= mask;
+			return true;
+		}
+		return !(__atomic_fetch_or(&bloom_vector[pos], mask, __ATOMIC_RELAXED) & mask);
+	}
+	
+	// Allocate the Bloom filter, aligned on a cache line (64 bytes)
+	// and in huge pages when possible (see index_memory.h)
+	void allocate ()
+	{
+		memory_size = bloom_size;
+		bloom_memory = IndexMemory::getInstance()->allocate(memory_size, memory_path);
+		if (bloom_memory == NULL) {
+			fprintf(stderr, "Index memory allocation impossible, try with a lower k value, a lower memory budget (-m) or with more RAM memory\n");
+			exit(1);
+		}
+		bloom_vector = bloom_memory;
+	}
+	
+	// Free the memory given by allocate
+	void release ()
+	{
+		IndexMemory::getInstance()->release(bloom_memory, memory_size, memory_path);
+		bloom_memory = NULL;
+	}
+	
+	// Set the masks and allocate a Bloom filter of size bytes
+	// or use the given vector of size bytes (ie mapped read-only from an
+	// index file): such a filter is only searched or merged, never fed
+	void init (const unsigned long & size, const char * vector = NULL)
 	{
 		MASK_A_EVEN = 128;
 		MASK_B_EVEN = 64;
@@ -69,33 +137,194 @@ public:
 		MASK_C_ODD = 2;
 		MASK_D_ODD = 1;
 		
-		// Set bloom filter size 1000...0
-		bloom_size = (unsigned long) pow (2, kmer_size - 1);
+		index_type = CLASSIC_INDEX;
+		canonical = false;
+		bloom_size = size;
 		
 		// Allocate Bloom filter
-		bloom_vector = (char *) calloc (bloom_size, sizeof(char));
-		if (bloom_vector == NULL) {
-			fprintf(stderr, "Index memory allocation impossible, try with a lower k value or with more RAM memory\n");
-			exit(1);
+		if (vector != NULL) {
+			bloom_memory = NULL;
+			bloom_vector = const_cast<char *> (vector);
+		} else {
+			allocate();
 		}
 	}
 	
-	~BloomFilter () {
-		free (bloom_vector);
+	// Add to nb_bits[0] the number of bits set in the size bytes of
+	// vector, counted 16 bytes at a time (SWAR popcount on vectors of 2
+	// words): the counts of the bytes are summed in byte counters, 31
+	// vectors at most so that they do not overflow, then in the total
+	static void count_bits (const char * vector, const unsigned long & size, unsigned long * nb_bits)
+	{
+		const unsigned long mask_1 = 0x5555555555555555UL;
+		const unsigned long mask_2 = 0x3333333333333333UL;
+		const unsigned long mask_4 = 0x0f0f0f0f0f0f0f0fUL;
+		const merge_vector_t * vectors = (const merge_vector_t *) vector;
+		const unsigned long nb_vectors = size / sizeof(merge_vector_t);
+		for (unsigned long i = 0; i < nb_vectors; ) {
+			const unsigned long end = std::min(nb_vectors, i + 31);
+			merge_vector_t bytes = {0, 0};
+			for (; i < end; i++) {
+				merge_vector_t x = vectors[i];
+				x = x - ((x >> 1) & mask_1);
+				x = (x & mask_2) + ((x >> 2) & mask_2);
+				bytes += (x + (x >> 4)) & mask_4;
+			}
+			nb_bits[0] += sum_bytes(bytes);
+		}
+		for (unsigned long i = nb_vectors * sizeof(merge_vector_t); i < size; i++) {
+			nb_bits[0] += __builtin_popcount((unsigned char) vector[i]);
+		}
+	}
+	
+	// Sum of the 16 bytes of a vector, each at most 255
+	static unsigned long sum_bytes (merge_vector_t bytes)
+	{
+		const unsigned long mask_8 = 0x00ff00ff00ff00ffUL;
+		bytes = (bytes & mask_8) + ((bytes >> 8) & mask_8);
+		bytes = bytes * 0x0001000100010001UL;
+		return (bytes[0] >> 48) + (bytes[1] >> 48);
 	}
 	
-	void clear()
+	// Number of bits set in the line-th line of 64 bytes of the filter,
+	// read with relaxed atomic loads: other threads may be feeding it
+	// (see feed_atomic)
+	unsigned long count_line_atomic (const unsigned long & line) const
 	{
-		if (bloom_vector != NULL) {
-			free (bloom_vector);
+		const unsigned long * words = (const unsigned long *) (bloom_vector + 64 * line);
+		unsigned long nb_bits = 0;
+		for (int i = 0; i < 8; i++) {
+			nb_bits += __builtin_popcountl(__atomic_load_n(&words[i], __ATOMIC_RELAXED));
 		}
-		bloom_vector = (char *) calloc (bloom_size, sizeof(char));
-		if (bloom_vector == NULL) {
-			fprintf(stderr, "Index memory allocation impossible, try with a lower k value or with more RAM memory\n");
-			exit(1);
+		return nb_bits;
+	}
+	
+	// Same as is_found, with relaxed atomic loads (see count_line_atomic)
+	bool is_found_atomic (const HashKey & hash_key) const
+	{
+		return
+		is_set_atomic(hash_key.keya() / 2, (hash_key.keya() % 2 ? MASK_A_ODD : MASK_A_EVEN)) &&
+		is_set_atomic(hash_key.keyb() / 2, (hash_key.keyb() % 2 ? MASK_B_ODD : MASK_B_EVEN)) &&
+		is_set_atomic(hash_key.keyc() / 2, (hash_key.keyc() % 2 ? MASK_C_ODD : MASK_C_EVEN)) &&
+		is_set_atomic(hash_key.keyd() / 2, (hash_key.keyd() % 2 ? MASK_D_ODD : MASK_D_EVEN));
+	}
+	
+	bool is_set_atomic (const unsigned long & pos, const char & mask) const
+	{
+		return __atomic_load_n(&bloom_vector[pos], __ATOMIC_RELAXED) & mask;
+	}
+	
+	// Count the bits of the filter in nb_bits and return the number of
+	// bytes read. With a step, the filter may be fed at the same time
+	// (see ChunkLimit): the bits are read with atomic loads, on every
+	// step-th line of 64 bytes (the whole filter with step 1)
+	unsigned long count_line_bits (const unsigned long & step, unsigned long & nb_bits) const
+	{
+		if (step == 0) {
+			count_bits(bloom_vector, bloom_size, &nb_bits);
+			return bloom_size;
+		}
+		const unsigned long nb_lines = bloom_size / 64;
+		unsigned long nb_bytes = 0;
+		for (unsigned long line = step / 2; line < nb_lines; line += step) {
+			nb_bits += count_line_atomic(line);
+			nb_bytes += 64;
+		}
+		if (step == 1) {
+			for (unsigned long i = nb_lines * 64; i < (unsigned long) bloom_size; i++) {
+				nb_bits += __builtin_popcount((unsigned char) __atomic_load_n(&bloom_vector[i], __ATOMIC_RELAXED));
+				nb_bytes++;
+			}
+		}
+		return nb_bytes;
+	}
+	
+	// Derived filters choose their size and call init
+	BloomFilter () {}
+	
+public:
+	// vector, if given, is the content of the filter, read-only and not freed
+	explicit BloomFilter (const int & kmer_size, const char * vector = NULL)
+	{
+		// Set bloom filter size 1000...0
+		init((unsigned long) pow (2, kmer_size - 1), vector);
+	}
+	
+	virtual ~BloomFilter () {
+		release();
+	}
+	
+	// Type of the index, used to call the non virtual methods of the
+	// right class in the k-mer loops (see search_reads.h)
+	const int & get_type () const {return index_type;}
+	
+	// A canonical index contains the smallest key of each k-mer and of its
+	// reverse complement (see CanonicalKey in hash_key.h)
+	void set_canonical (const bool & is_canonical) {canonical = is_canonical;}
+	const bool & is_canonical () const {return canonical;}
+	
+	// Size of the index in bytes
+	const long & get_size () const {return bloom_size;}
+	
+	// Content of the index (get_size() bytes)
+	const char * get_vector () const {return bloom_vector;}
+	
+	virtual void clear()
+	{
+		release();
+		allocate();
+	}
+	
+	// Add the k-mers of other, a filter of the same type and size, by
+	// ORing its bits in this filter (see merge_index.cpp)
+	// Not valid for the exact index, whose k-mers are compressed
+	void merge (const BloomFilter & other)
+	{
+		const long nb_vectors = bloom_size / sizeof(merge_vector_t);
+		merge_vector_t * target = (merge_vector_t *) bloom_vector;
+		const merge_vector_t * source = (const merge_vector_t *) other.bloom_vector;
+		for (long i = 0; i < nb_vectors; i++) {
+			target[i] |= source[i];
+		}
+		for (long i = nb_vectors * sizeof(merge_vector_t); i < bloom_size; i++) {
+			bloom_vector[i] |= other.bloom_vector[i];
 		}
 	}
 	
+	// Fraction of the bits of the filter that are set, read on every
+	// step-th line of 64 bytes with a step (see count_line_bits): a step
+	// larger than 1 gives a fast estimate while the filter is fed
+	virtual double get_occupancy (const unsigned long & step = 0) const
+	{
+		unsigned long nb_bits = 0;
+		const unsigned long nb_bytes = count_line_bits(step, nb_bits);
+		return nb_bytes > 0 ? (double) nb_bits / (8.0 * nb_bytes) : 0;
+	}
+	
+	// Measured probability that a k-mer that is not indexed is found:
+	// the 4 keys of a k-mer are not independent (keyc and keyd are
+	// computed from keya and keyb, and keyd sets 3 bits out of 4), so the
+	// product of the occupancies of the 4 keys is far below the real rate.
+	// Random k-mers are searched instead, the same ones at each call, and
+	// 64 times fewer with a step, given while the filter is fed (see
+	// ChunkLimit). The other filters read every step-th line with a step
+	virtual double get_fpr (const unsigned long & step = 0) const
+	{
+		const unsigned long nb_probes = step == 0 ? BLOOM_FPR_PROBES : BLOOM_FPR_PROBES / 64;
+		// The keys of a classic filter of 2^(k-1) bytes have k bits
+		HashKey hash (__builtin_ctzl(2 * bloom_size));
+		unsigned long nb_found = 0;
+		for (unsigned long i = 0; i < nb_probes; i++) {
+			hash.set(HashKey::mix(2 * i + 1), HashKey::mix(2 * i + 2));
+			nb_found += step == 0 ? BloomFilter::is_found(hash) : is_found_atomic(hash);
+		}
+		return (double) nb_found / nb_probes;
+	}
+	
+	// Called once all the k-mers are fed, before any search
+	// (the exact index is sorted and compressed there)
+	virtual void finalize () {}
+	
 	bool empty() {
 		for (long i = 0; i < bloom_size; i++) {
 			if (bloom_vector[i] > 0) {
@@ -109,19 +338,52 @@ public:
 	// THIS IS WHERE WE PEND MOST OF THE TIME
 	// key/2 -> shift the last number, ie : 110010 -> 11001
 	// the %2 give if the last number is 0 or 1
-	void feed (const HashKey & hash_key)
+	virtual void feed (const HashKey & hash_key)
 	{
 		bloom_vector[hash_key.keya() / 2] |= (hash_key.keya() % 2 ? MASK_A_ODD : MASK_A_EVEN);
 		bloom_vector[hash_key.keyb() / 2] |= (hash_key.keyb() % 2 ? MASK_B_ODD : MASK_B_EVEN);
 		bloom_vector[hash_key.keyc() / 2] |= (hash_key.keyc() % 2 ? MASK_C_ODD : MASK_C_EVEN);
 		bloom_vector[hash_key.keyd() / 2] |= (hash_key.keyd() % 2 ? MASK_D_ODD : MASK_D_EVEN);
 	}
+	
+	// Same as feed but several threads may feed the same filter at once
+	// The byte is read first so that the atomic 'or' is only issued when
+	// the bit is not already set (most k-mers are seen several times)
+	virtual void feed_atomic (const HashKey & hash_key)
+	{
+		feed_atomic_bit (hash_key.keya() / 2, (hash_key.keya() % 2 ? MASK_A_ODD : MASK_A_EVEN));
+		feed_atomic_bit (hash_key.keyb() / 2, (hash_key.keyb() % 2 ? MASK_B_ODD : MASK_B_EVEN));
+		feed_atomic_bit (hash_key.keyc() / 2, (hash_key.keyc() % 2 ? MASK_C_ODD : MASK_C_EVEN));
+		feed_atomic_bit (hash_key.keyd() / 2, (hash_key.keyd() % 2 ? MASK_D_ODD : MASK_D_EVEN));
+	}
+	
+	// Same as feed, or feed_atomic, and return true if the k-mer was new to
+	// the filter, ie one of its bits was not set
+	// feed and feed_atomic do not check it, they stay as fast as possible
+	virtual bool feed_new (const HashKey & hash_key, const bool & atomic)
+	{
+		// | and not ||: the 4 bits are set
+		return
+		set_new_bit (hash_key.keya() / 2, (hash_key.keya() % 2 ? MASK_A_ODD : MASK_A_EVEN), atomic) |
+		set_new_bit (hash_key.keyb() / 2, (hash_key.keyb() % 2 ? MASK_B_ODD : MASK_B_EVEN), atomic) |
+		set_new_bit (hash_key.keyc() / 2, (hash_key.keyc() % 2 ? MASK_C_ODD : MASK_C_EVEN), atomic) |
+		set_new_bit (hash_key.keyd() / 2, (hash_key.keyd() % 2 ? MASK_D_ODD : MASK_D_EVEN), atomic);
+	}
+
+	// Prefetch the byte of keya in the cache
+	// so that a later is_found does not wait for the memory
+	// Only keya is prefetched: most searched k-mers are not indexed and
+	// is_found stops on the first key, prefetching the 4 keys is slower
+	virtual void prefetch (const HashKey & hash_key) const
+	{
+		__builtin_prefetch(&bloom_vector[hash_key.keya() / 2]);
+	}
 
 	// Check values to the Bloom filter
 	// THIS IS WHERE WE PEND MOST OF THE TIME
 	// key/2 -> shift the last number, ie : 110010 -> 11001
 	// the %2 give if the last number is 0 or 1
-	bool is_found (const HashKey & hash_key) const
+	virtual bool is_found (const HashKey & hash_key) const
 	{
 		return
 		(bloom_vector[hash_key.keya() / 2] & (hash_key.keya() % 2 ? MASK_A_ODD : MASK_A_EVEN)) &&
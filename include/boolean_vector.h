@@ -63,6 +63,12 @@ private:
 	// The comment at the beginning of the file
 	std::string comment;
 	
+	// The bits after the last one of the vector may be 1 (see init_true)
+	unsigned long found_at (const unsigned long & i) const
+	{
+		return i < boolean_vector_size ? i : boolean_vector_size;
+	}
+	
 public:
 	
 	//
@@ -224,6 +230,39 @@ public:
 		return (boolean_vector[i / 8] & mask[i % 8]);
 	}
 	
+	//
+	// Get the position of the first bit to 1 from position i, or the size
+	// of the boolean vector if there is none. The chars to 0 are skipped
+	// 8 at a time.
+	//
+	unsigned long next_set (const unsigned long & i) const
+	{
+		if (i >= boolean_vector_size) {
+			return boolean_vector_size;
+		}
+		unsigned long c = i / 8;
+		const unsigned char first = (unsigned char) boolean_vector[c] >> (i % 8);
+		if (first != 0) {
+			return found_at(i + __builtin_ctz(first));
+		}
+		c++;
+		unsigned long word;
+		while (c + sizeof(word) <= boolean_vector_char_size) {
+			memcpy(&word, &boolean_vector[c], sizeof(word));
+			if (word != 0) {
+				break;
+			}
+			c += sizeof(word);
+		}
+		while (c < boolean_vector_char_size && boolean_vector[c] == 0) {
+			c++;
+		}
+		if (c == boolean_vector_char_size) {
+			return boolean_vector_size;
+		}
+		return found_at(c * 8 + __builtin_ctz((unsigned char) boolean_vector[c]));
+	}
+	
 	//
 	// Set the bit at position i to 1
 	//
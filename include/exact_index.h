@@ -0,0 +1,312 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXACT_INDEX_H_
+#define EXACT_INDEX_H_
+
+#include "bloom_filter.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Number of k-mers in a block of the feeding buffer
+#define EXACT_BLOCK_SIZE (1UL << 16)
+// Maximal number of blocks of the feeding buffer (2^32 k-mers)
+#define EXACT_MAX_BLOCKS (1UL << 16)
+// Mean number of k-mers per bucket of the compressed index
+#define EXACT_BUCKET_SIZE 4
+// Number of 64 bits words before the directory in the compressed index
+#define EXACT_HEADER_SIZE 4
+
+/*
+ * Exact index
+ *
+ * Contains exactly the k-mers of the indexed reads: no false positive.
+ * A k-mer is the number of 2k bits (keya << k) | keyb.
+ *
+ * The fed k-mers are stored in a buffer of blocks (16 bytes per fed
+ * k-mer), then finalize() sorts them, removes the duplicates and
+ * compresses them in the vector of the index:
+ *   header    : number of k-mers, bucket_bits, rem_bits, k
+ *   directory : for each of the 2^bucket_bits buckets (the high bits of
+ *               the k-mers), the rank of its first k-mer, then the number
+ *               of k-mers (2^bucket_bits + 1 words of 32 bits)
+ *   remainders: the rem_bits low bits of each k-mer, packed, in order
+ * There are EXACT_BUCKET_SIZE to 2 * EXACT_BUCKET_SIZE k-mers per bucket,
+ * so a query reads one word of the directory and a few consecutive
+ * remainders, usually in the same cache line.
+ * The index takes about 2k - log2(n) + 8 bits per distinct k-mer.
+ */
+class ExactIndex : public BloomFilter
+{
+private:
+	typedef unsigned __int128 kmer_t;
+	
+	int kmer_size;
+	
+	// Feeding buffer
+	kmer_t ** blocks;
+	unsigned long nb_fed_kmers;
+	pthread_mutex_t mutex;
+	
+	// Compressed index, in bloom_vector
+	unsigned long nb_kmers;
+	int bucket_bits;
+	int rem_bits;
+	kmer_t rem_mask;
+	const unsigned int * directory;
+	char * remainders;
+	
+	kmer_t value (const HashKey & hash_key) const
+	{
+		return ((kmer_t) hash_key.keya() << kmer_size) | hash_key.keyb();
+	}
+	
+	// Remainders are read and written 16 bytes at a time (rem_bits <= 120)
+	// or 8 bytes at a time if rem_bits <= 56 (get_short_remainder)
+	kmer_t get_remainder (const unsigned long & rank) const
+	{
+		const unsigned long pos = rank * rem_bits;
+		kmer_t word;
+		memcpy(&word, remainders + pos / 8, sizeof(word));
+		return (word >> (pos % 8)) & rem_mask;
+	}
+	
+	unsigned long get_short_remainder (const unsigned long & rank) const
+	{
+		const unsigned long pos = rank * rem_bits;
+		unsigned long word;
+		memcpy(&word, remainders + pos / 8, sizeof(word));
+		return (word >> (pos % 8)) & (unsigned long) rem_mask;
+	}
+	
+	void set_remainder (const unsigned long & rank, const kmer_t & remainder)
+	{
+		const unsigned long pos = rank * rem_bits;
+		kmer_t word;
+		memcpy(&word, remainders + pos / 8, sizeof(word));
+		word |= remainder << (pos % 8);
+		memcpy(remainders + pos / 8, &word, sizeof(word));
+	}
+	
+	// Size in bytes of a compressed index
+	static unsigned long compressed_size (const unsigned long & nb_kmers, const int & bucket_bits, const int & rem_bits)
+	{
+		return 8 * EXACT_HEADER_SIZE + 4 * ((1UL << bucket_bits) + 1) + (nb_kmers * rem_bits + 7) / 8 + sizeof(kmer_t);
+	}
+	
+	// Set the pointers of the compressed index from its header
+	void read_header ()
+	{
+		const unsigned long * header = (const unsigned long *) bloom_vector;
+		nb_kmers = header[0];
+		bucket_bits = header[1];
+		rem_bits = header[2];
+		rem_mask = ((kmer_t) 1 << rem_bits) - 1;
+		directory = (const unsigned int *) (header + EXACT_HEADER_SIZE);
+		remainders = bloom_vector + 8 * EXACT_HEADER_SIZE + 4 * ((1UL << bucket_bits) + 1);
+	}
+	
+	void free_blocks ()
+	{
+		for (unsigned long block = 0; block < EXACT_MAX_BLOCKS && blocks[block] != NULL; block++) {
+			free(blocks[block]);
+			blocks[block] = NULL;
+		}
+		nb_fed_kmers = 0;
+	}
+	
+	kmer_t * get_block (const unsigned long & block)
+	{
+		if (block >= EXACT_MAX_BLOCKS) {
+			fprintf(stderr, "Too many k-mers for the exact index, try with a lower memory budget (-m)\n");
+			exit(1);
+		}
+		kmer_t * current_block = __atomic_load_n(&blocks[block], __ATOMIC_ACQUIRE);
+		if (current_block == NULL) {
+			pthread_mutex_lock(&mutex);
+			current_block = blocks[block];
+			if (current_block == NULL) {
+				current_block = (kmer_t *) malloc(EXACT_BLOCK_SIZE * sizeof(kmer_t));
+				if (current_block == NULL) {
+					fprintf(stderr, "Index memory allocation impossible, try with a lower memory budget (-m) or with more RAM memory\n");
+					exit(1);
+				}
+				__atomic_store_n(&blocks[block], current_block, __ATOMIC_RELEASE);
+			}
+			pthread_mutex_unlock(&mutex);
+		}
+		return current_block;
+	}
+	
+public:
+	// vector, if given, is a compressed index (ie mapped from an index file)
+	// and size its size in bytes
+	ExactIndex (const int & kmer_size, const unsigned long & size, const char * vector = NULL)
+	{
+		this->kmer_size = kmer_size;
+		blocks = (kmer_t **) calloc(EXACT_MAX_BLOCKS, sizeof(kmer_t *));
+		nb_fed_kmers = 0;
+		pthread_mutex_init(&mutex, NULL);
+		if (vector != NULL) {
+			init(size, vector);
+			read_header();
+		} else {
+			init(0);
+			nb_kmers = 0;
+			directory = NULL;
+			remainders = NULL;
+		}
+		index_type = EXACT_INDEX;
+	}
+	
+	~ExactIndex ()
+	{
+		free_blocks();
+		free(blocks);
+		pthread_mutex_destroy(&mutex);
+	}
+	
+	void clear ()
+	{
+		free_blocks();
+		bloom_size = 0;
+		BloomFilter::clear();
+		nb_kmers = 0;
+		directory = NULL;
+		remainders = NULL;
+	}
+	
+	void feed (const HashKey & hash_key)
+	{
+		const unsigned long rank = nb_fed_kmers++;
+		get_block(rank / EXACT_BLOCK_SIZE)[rank % EXACT_BLOCK_SIZE] = value(hash_key);
+	}
+	
+	void feed_atomic (const HashKey & hash_key)
+	{
+		const unsigned long rank = __atomic_fetch_add(&nb_fed_kmers, 1, __ATOMIC_RELAXED);
+		get_block(rank / EXACT_BLOCK_SIZE)[rank % EXACT_BLOCK_SIZE] = value(hash_key);
+	}
+	
+	// Each fed k-mer takes 16 bytes until finalize(), even fed again:
+	// it is always new
+	bool feed_new (const HashKey & hash_key, const bool & atomic)
+	{
+		if (atomic) {
+			ExactIndex::feed_atomic(hash_key);
+		} else {
+			ExactIndex::feed(hash_key);
+		}
+		return true;
+	}
+	
+	// Sort the fed k-mers and compress them in the index
+	void finalize ()
+	{
+		std::vector<kmer_t> kmers;
+		kmers.reserve(nb_fed_kmers);
+		for (unsigned long block = 0; block * EXACT_BLOCK_SIZE < nb_fed_kmers; block++) {
+			const unsigned long block_end = std::min(EXACT_BLOCK_SIZE, nb_fed_kmers - block * EXACT_BLOCK_SIZE);
+			kmers.insert(kmers.end(), blocks[block], blocks[block] + block_end);
+			free(blocks[block]);
+			blocks[block] = NULL;
+		}
+		nb_fed_kmers = 0;
+		std::sort(kmers.begin(), kmers.end());
+		kmers.erase(std::unique(kmers.begin(), kmers.end()), kmers.end());
+		
+		// About EXACT_BUCKET_SIZE k-mers per bucket,
+		// and remainders of at most 120 bits
+		int nb_bits = 0;
+		while ((kmers.size() / EXACT_BUCKET_SIZE) >> (nb_bits + 1) > 0) {
+			nb_bits++;
+		}
+		nb_bits = std::max(nb_bits, 2 * kmer_size - 120);
+		
+		release();
+		bloom_size = compressed_size(kmers.size(), nb_bits, 2 * kmer_size - nb_bits);
+		allocate();
+		unsigned long * header = (unsigned long *) bloom_vector;
+		header[0] = kmers.size();
+		header[1] = nb_bits;
+		header[2] = 2 * kmer_size - nb_bits;
+		header[3] = kmer_size;
+		read_header();
+		unsigned int * buckets = (unsigned int *) (header + EXACT_HEADER_SIZE);
+		unsigned long bucket = 0;
+		for (unsigned long rank = 0; rank < nb_kmers; rank++) {
+			const unsigned long kmer_bucket = (unsigned long) (kmers[rank] >> rem_bits);
+			while (bucket <= kmer_bucket) {
+				buckets[bucket++] = rank;
+			}
+			set_remainder(rank, kmers[rank] & rem_mask);
+		}
+		while (bucket <= (1UL << bucket_bits)) {
+			buckets[bucket++] = nb_kmers;
+		}
+	}
+	
+	// Number of distinct k-mers of the index
+	const unsigned long & get_nb_kmers () const {return nb_kmers;}
+	
+	// No false positive (the occupancy of the compressed k-mers means nothing)
+	double get_fpr (const unsigned long & step = 0) const {return 0;}
+	
+	void prefetch (const HashKey & hash_key) const
+	{
+		__builtin_prefetch(&directory[(unsigned long) (value(hash_key) >> rem_bits)]);
+	}
+	
+	bool is_found (const HashKey & hash_key) const
+	{
+		const kmer_t kmer = value(hash_key);
+		const unsigned long bucket = (unsigned long) (kmer >> rem_bits);
+		const unsigned long bucket_end = directory[bucket + 1];
+		if (rem_bits <= 56) {
+			const unsigned long remainder = (unsigned long) kmer & (unsigned long) rem_mask;
+			for (unsigned long rank = directory[bucket]; rank < bucket_end; rank++) {
+				const unsigned long current = get_short_remainder(rank);
+				if (current >= remainder) {
+					return current == remainder;
+				}
+			}
+			return false;
+		}
+		const kmer_t remainder = kmer & rem_mask;
+		for (unsigned long rank = directory[bucket]; rank < bucket_end; rank++) {
+			const kmer_t current = get_remainder(rank);
+			if (current >= remainder) {
+				return current == remainder;
+			}
+		}
+		return false;
+	}
+};
+
+#endif
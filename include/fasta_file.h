@@ -28,6 +28,7 @@
 #define __FASTA_FILE_H__
 
 #include "read_file.h"
+#include "line_reader.h"
 
 #include <fstream>
 #include <zlib.h>
@@ -38,90 +39,129 @@
 class FastaFile : public ReadFile
 {
 private:
-	std::ifstream infile;
-	std::string tmp_str;
-	
-public:
+	LineReader infile;
+	Line line;
+	// current_read_data is only built when get_data asks for it
+	mutable bool has_data;
 	
 	////////////////////////////////////////////////////////////
-	// Open the file, count reads and set boolean vector to 1
+	// Set nb_reads from the read index of the file or count the
+	// reads and write the index (see read_index.h)
 	//
-	explicit FastaFile (const std::string & file_name)
+	void count_reads ()
 	{
-		//std::cerr << "Open FASTA\n";
-		fname = file_name;
-		// Open the file
-		infile.open (file_name.c_str());
-		if (!infile.good()) {
-			std::cerr << "Error: Cannot open Fasta File " << file_name << "\n";
-			exit(1);
-		}
-		// Count reads
-		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (infile.good()) {
-			getline (infile, tmp_str);
-			try {
-				if (tmp_str.at(0) == '>')
+		if (!read_index.load(fname, nb_reads)) {
+			nb_reads = 0;
+			while (true) {
+				infile.begin_record();
+				const unsigned long line_pos = infile.tell();
+				if (!infile.next_line(line)) {
+					break;
+				}
+				if (line.size > 0 && infile.get(line)[0] == '>') {
+					read_index.add_read(nb_reads, line_pos);
 					nb_reads++;
-			} catch (std::exception & e) {}
+				}
+			}
+			read_index.save(nb_reads);
 		}
 		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Set boolean vector to 1
-		bv.init_true(nb_reads);
-		current_read_pos = 0;
-		_nb_valid_reads = bv.nb_one();
-		_cnt_valid_reads = 0;
-		first_read = true;
 	}
 	
+	////////////////////////////////////////////////////////////
+	// Go straight to the last read of the read index (see
+	// read_index.h) before the read at read_pos, if it is after the
+	// current read: the reads in between are not parsed
+	//
+	void skip_to (const unsigned long & read_pos)
+	{
+		const std::vector<unsigned long> & offsets = read_index.get_offsets();
+		const unsigned long indexed = read_pos / READ_INDEX_STEP;
+		if (indexed < offsets.size() && indexed * READ_INDEX_STEP > current_read_pos && infile.seek(offsets[indexed])) {
+			current_read_pos = indexed * READ_INDEX_STEP;
+			has_data = false;
+		}
+	}
 	
 	////////////////////////////////////////////////////////////
-	// Open the file, count reads and read boolean vector in bv file
+	// Read the header of the next entry, exit if it is not a
+	// FASTA header. Return false at the end of the file.
+	//
+	bool read_header ()
+	{
+		infile.begin_record();
+		current_read_offset = infile.tell();
+		if (!infile.next_line(line)) {
+			return false;
+		}
+		if (line.size == 0 || infile.get(line)[0] != '>') {
+			std::cerr << "Error in Fasta format !!\n";
+			exit(1);
+		}
+		return true;
+	}
+	
+protected:
+	
+	////////////////////////////////////////////////////////////
+	// Nothing is opened yet, for the readers of gzipped files
+	//
+	FastaFile () : has_data (false) {}
+	
+	////////////////////////////////////////////////////////////
+	// Open the file, gzipped or not, and count reads. Set the
+	// boolean vector to 1, or read it in bv file if one is given
 	// + check boolean vector size and nb_reads are equal
 	//
-	explicit FastaFile (const std::string & file_name, const std::string & bv_file_name)
+	void open_file (const std::string & file_name, const std::string * bv_file_name, const bool & gzip)
 	{
 		fname = file_name;
+		has_data = false;
 		// Open the file
-		infile.open (file_name.c_str());
-		if (!infile.good()) {
-			std::cerr << "Error: Cannot open Fastq File " << file_name << "\n";
+		if (!infile.open(file_name, gzip)) {
+			std::cerr << "Error: Cannot open Fasta File " << file_name << "\n";
 			exit(1);
 		}
 		// Count reads
 		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (infile.good()) {
-			getline (infile, tmp_str);
-			try {
-				if (tmp_str.at(0) == '>')
-					nb_reads++;
-			} catch (std::exception & e) {}
-		}
-		rewind();
+		count_reads();
 		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Read the boolean vector in bv file
-		bv.read(bv_file_name);
-		// Check boolean vector size and nb_reads are equal
-		if (nb_reads != bv.size()) {
-			std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
-			exit(1);
+		if (bv_file_name == NULL) {
+			// Set boolean vector to 1
+			bv.init_true(nb_reads);
+		} else {
+			// Read the boolean vector in bv file
+			bv.read(*bv_file_name);
+			// Check boolean vector size and nb_reads are equal
+			if (nb_reads != bv.size()) {
+				std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
+				exit(1);
+			}
 		}
+		current_read_pos = 0;
 		_nb_valid_reads = bv.nb_one();
 		_cnt_valid_reads = 0;
-		current_read_pos = 0;
 		first_read = true;
 	}
 	
+public:
 	
 	////////////////////////////////////////////////////////////
-	// Destructor only closes the file
+	// Open the file, count reads and set boolean vector to 1
 	//
-	~FastaFile ()
+	explicit FastaFile (const std::string & file_name)
+	{
+		open_file(file_name, NULL, false);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Open the file, count reads and read boolean vector in bv file
+	// + check boolean vector size and nb_reads are equal
+	//
+	explicit FastaFile (const std::string & file_name, const std::string & bv_file_name)
 	{
-		infile.close();
+		open_file(file_name, &bv_file_name, false);
 	}
 	
 	
@@ -137,12 +177,16 @@ public:
 		} else {
 			current_read_pos++;
 		}
-		current_read_data.clear();
+		has_data = false;
 		current_read_seq.clear();
 		
 		if (_cnt_valid_reads < _nb_valid_reads) {
+			// Jump to the indexed read before the next valid read
+			if (current_read_pos < nb_reads && !bv.is_set(current_read_pos)) {
+				skip_to(bv.next_set(current_read_pos));
+			}
 			// While reads are not valid in the boolean vector, flush them
-			while (current_read_pos < nb_reads && infile.good()) {
+			while (current_read_pos < nb_reads && infile.peek() != EOF) {
 				if (!bv.is_set(current_read_pos)) {
 					flush_next_read ();
 					current_read_pos++;
@@ -152,27 +196,11 @@ public:
 			}
 			// The current read is 1 in the boolean vector
 			// Or current_read_pos >= nb_reads -> end of file
-			if (current_read_pos < nb_reads) {
-				if (infile.good()) {
-					getline (infile, tmp_str);
-					if (tmp_str[0] != '>') {
-						std::cerr << "Error in Fasta format !!\n";
-						exit(1);
-					}
-					if (tmp_str[tmp_str.size() - 1] == '\n' ) {
-						tmp_str.erase(tmp_str.size() - 1);
-					}
-					current_read_data += tmp_str + "\n";
-					while (infile.good() && infile.peek() != '>' && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-						getline (infile, tmp_str);
-						if (!tmp_str.empty()) {
-							if (tmp_str[tmp_str.size() - 1] == '\n' ) {
-								tmp_str.erase(tmp_str.size() - 1);
-							}
-							current_read_seq += tmp_str;
-							current_read_data += tmp_str + "\n";
-						}
-					}
+			if (current_read_pos < nb_reads && read_header()) {
+				// The sequence lines are copied, without their '\n'
+				while (infile.peek() != '>' && infile.peek() != EOF) {
+					infile.next_line(line);
+					current_read_seq.append(infile.get(line), line.size);
 				}
 			}
 			if (!current_read_seq.empty()) {
@@ -187,26 +215,29 @@ public:
 	// Just read the next read without storing it
 	//
 	void flush_next_read () {
-		current_read_data.clear();
+		has_data = false;
 		current_read_seq.clear();
-		if (infile.good()) {
-			getline (infile, tmp_str);
-		}
-		if (tmp_str[0] != '>') {
-			std::cerr << "Error in Fasta format !!\n";
-			exit(1);
-		}
-		while (infile.good() && infile.peek() != '>') {
-			getline (infile, tmp_str);
+		if (read_header()) {
+			while (infile.peek() != '>' && infile.peek() != EOF) {
+				infile.next_line(line);
+			}
 		}
 	}
 	
 	
 	////////////////////////////////////////////////////////////
-	// Return the full FASTQ entry of the current read
+	// Return the full FASTA entry of the current read, without
+	// its empty lines
 	//
 	const std::string & get_data() const
 	{
+		if (!has_data) {
+			current_read_data.clear();
+			if (!current_read_seq.empty()) {
+				infile.get_record(current_read_data);
+			}
+			has_data = true;
+		}
 		return current_read_data;
 	}
 	
@@ -261,8 +292,9 @@ public:
 	// because no read has been read
 	//
 	void rewind () {
-		infile.clear();
-		infile.seekg(0);
+		infile.rewind();
+		has_data = false;
+		current_read_seq.clear();
 		_cnt_valid_reads = 0;
 		current_read_pos = 0;
 		first_read = true;
@@ -313,250 +345,22 @@ public:
 	}
 };
 
-class GzFastaFile : public ReadFile
+////////////////////////////////////////////////////////////
+// This class is used to read a gzipped FASTA file: it is read as
+// a FASTA file, decompressed ahead by other threads (see
+// gzip_reader.h), and the selected reads are saved gzipped
+//
+class GzFastaFile : public FastaFile
 {
-private:
-	gzFile infile;
-	static const int NORMALSIZEREAD = 1048576;
-	char tmp_str[NORMALSIZEREAD];
 public:
-	GzFastaFile (const std::string & file_name)  {
-		//std::cerr << "Add Gzip Fasta File " << file_name << "\n";
-		fname = file_name;
-		// Open the file
-		infile = (gzFile) gzopen (file_name.c_str(), "r");
-		if (infile == NULL) {
-			std::cerr << "Error: Cannot open Fasta File " << file_name << "\n";
-			exit(1);
-		}
-		// Count reads
-		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (gzgets(infile, tmp_str, NORMALSIZEREAD) != NULL) {
-			if (tmp_str[0] == '>') {
-				nb_reads++;
-			}
-		}
-		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Set boolean vector to 1
-		bv.init_true(nb_reads);
-		current_read_pos = 0;
-		_nb_valid_reads = bv.nb_one();
-		_cnt_valid_reads = 0;
-		first_read = true;
-
-	}
-	
-	GzFastaFile (const std::string & file_name, const std::string & bv_file_name)  {
-		//std::cerr << "Add Gzip Fasta File " << file_name << " with bv " << bv_file_name << "\n";
-		fname = file_name;
-		// Open the file
-		infile = (gzFile) gzopen (file_name.c_str(), "r");
-		if (infile == NULL) {
-			std::cerr << "Error: Cannot open Fasta File " << file_name << "\n";
-			exit(1);
-		}
-		// Count reads
-		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (gzgets(infile, tmp_str, NORMALSIZEREAD) != NULL) {
-			if (tmp_str[0] == '>') {
-				nb_reads++;
-			}
-		}
-		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Read the boolean vector in bv file
-		bv.read(bv_file_name);
-		// Check boolean vector size and nb_reads are equal
-		if (nb_reads != bv.size()) {
-			std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
-			exit(1);
-		}
-		current_read_pos = 0;
-		_nb_valid_reads = bv.nb_one();
-		_cnt_valid_reads = 0;
-		first_read = true;
-	}
-	
-	~GzFastaFile ()
-	{
-		gzclose(infile);
-	}
-	
-	////////////////////////////////////////////////////////////
-	// get_next_read returns the next read in the file
-	// OR an empty string if no more read is available
-	//
-	std::string & get_next_read ()
-	{
-		// clear data and increment the position
-		if (first_read) {
-			first_read = false;
-		} else {
-			current_read_pos++;
-		}
-		current_read_data.clear();
-		current_read_seq.clear();
-		
-		if (_cnt_valid_reads < _nb_valid_reads) {
-			// While reads are not valid in the boolean vector, flush them
-			while (current_read_pos < nb_reads && !gzeof(infile)) {
-				if (!bv.is_set(current_read_pos)) {
-					flush_next_read ();
-					current_read_pos++;
-				} else {
-					break;
-				}
-			}
-			// The current read is 1 in the boolean vector
-			// Or current_read_pos >= nb_reads -> end of file
-			if (current_read_pos < nb_reads) {
-				if (!gzeof(infile)) {
-					if(gzgets(infile, tmp_str, NORMALSIZEREAD) != NULL) {
-						if (tmp_str[0] != '>') {
-							std::cerr << "Error in Fasta format !!\n";
-							exit(1);
-						}
-						current_read_data += std::string(tmp_str);
-						if (current_read_data[current_read_data.size() - 1] != '\n') {
-							current_read_data += '\n';
-						}
-						char c = gzgetc(infile);
-						while (!gzeof(infile) && c != '>') {
-							if (c != '\n') {
-								current_read_seq += c;
-							}
-							current_read_data += c;
-							c = gzgetc(infile);
-						}
-						gzungetc(c, infile);
-					}
-				}
-			}
-			if (!current_read_seq.empty()) {
-				_cnt_valid_reads++;
-			}
-		}
-		return current_read_seq;
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Just read the next read without storing it
-	//
-	void flush_next_read () {
-		current_read_data.clear();
-		current_read_seq.clear();
-		if (gzgets(infile, tmp_str, NORMALSIZEREAD) != NULL) {
-			if (tmp_str[0] != '>') {
-				std::cerr << "Error in Fasta format !!\n";
-				exit(1);
-			}
-			char c = gzgetc(infile);
-			while (!gzeof(infile) && c != '>') {
-				gzungetc(c, infile);
-				gzgets(infile, tmp_str, NORMALSIZEREAD);
-				c = gzgetc(infile);
-			}
-			gzungetc(c, infile);
-		}
-	}
-
-	
-	////////////////////////////////////////////////////////////
-	// Return the full FASTQ entry of the current read
-	//
-	const std::string & get_data() const
+	explicit GzFastaFile (const std::string & file_name)
 	{
-		return current_read_data;
+		open_file(file_name, NULL, true);
 	}
 	
-	
-	////////////////////////////////////////////////////////////
-	// Return the sequence of the current read
-	//
-	const std::string & get_read() const
+	GzFastaFile (const std::string & file_name, const std::string & bv_file_name)
 	{
-		return current_read_seq;
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the current read to 1 in the boolean vector
-	//
-	void tag_current_read ()
-	{
-		bv.set(current_read_pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the current read to 0 in the boolean vector
-	//
-	void untag_current_read ()
-	{
-		bv.unset(current_read_pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the read at pos to 1 in the boolean vector
-	//
-	void tag (const unsigned long & pos)
-	{
-		bv.set(pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the read at pos to 0 in the boolean vector
-	//
-	void untag (const unsigned long & pos)
-	{
-		bv.unset(pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Go to the beginning of the file -> current_read_pos = -1
-	// because no read has been read
-	//
-	void rewind () {
-		gzclose(infile);
-		infile = (gzFile) gzopen (fname.c_str(), "r");
-		if (infile == NULL) {
-			std::cerr << "Error: Cannot open Fasta File " << fname << "\n";
-			exit(1);
-		}
-		current_read_pos = 0;
-		_cnt_valid_reads = 0;
-		first_read = true;
-	};
-	
-	////////////////////////////////////////////////////////////
-	// Set the comment of the boolean vector
-	//
-	void set_bv_comment (const std::string & str)
-	{
-		bv.set_comment(str);
-	}
-	
-	////////////////////////////////////////////////////////////
-	// Save the boolean vector in the given file name
-	//
-	void save_bv (const std::string & file_name)
-	{
-		bv.print(file_name);
-	}
-	
-	////////////////////////////////////////////////////////////
-	// Save the boolean vector in fname.bv
-	//
-	void save_bv ()
-	{
-		bv.print(fname + ".bv");
+		open_file(file_name, &bv_file_name, true);
 	}
 	
 	////////////////////////////////////////////////////////////
@@ -577,7 +381,6 @@ public:
 		}
 		gzclose(filetmp);
 	}
-
 };
 
 #endif
@@ -28,6 +28,7 @@
 #define __FASTQ_FILE_H__
 
 #include "read_file.h"
+#include "line_reader.h"
 
 #include <fstream>
 #include <zlib.h>
@@ -38,89 +39,151 @@
 class FastqFile : public ReadFile
 {
 private:
-	std::ifstream infile;
-	std::string tmp_str;
-public:
+	LineReader infile;
+	Line line, sequence;
+	// current_read_data is only built when get_data asks for it
+	mutable bool has_data;
 	
 	////////////////////////////////////////////////////////////
-	// Open the file, count reads and set boolean vector to 1
+	// Set nb_reads from the read index of the file or count the
+	// reads (4 non empty lines each) and write the index (see
+	// read_index.h)
 	//
-	explicit FastqFile (const std::string & file_name)
+	void count_reads ()
 	{
-		//std::cerr << "Open FASTQ\n";
-		fname = file_name;
-		// Open the file
-		infile.open (file_name.c_str());
-		if (!infile.good()) {
-			std::cerr << "Error: Cannot open Fastq File " << file_name << "\n";
-			exit(1);
-		}
-		// Count reads
-		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (infile.good()) {
-			getline (infile, tmp_str);
-			if (!tmp_str.empty()) {
-				nb_reads++;
+		if (!read_index.load(fname, nb_reads)) {
+			unsigned long nb_lines = 0;
+			while (true) {
+				infile.begin_record();
+				const unsigned long line_pos = infile.tell();
+				if (!infile.next_line(line)) {
+					break;
+				}
+				if (line.size > 0) {
+					if (nb_lines % 4 == 0) {
+						read_index.add_read(nb_lines / 4, line_pos);
+					}
+					nb_lines++;
+				}
 			}
+			nb_reads = nb_lines / 4;
+			read_index.save(nb_reads);
 		}
-		nb_reads = nb_reads / 4;
 		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Set boolean vector to 1
-		bv.init_true(nb_reads);
-		current_read_pos = 0;
-		_nb_valid_reads = bv.nb_one();
-		_cnt_valid_reads = 0;
-		first_read = true;
 	}
 	
+	////////////////////////////////////////////////////////////
+	// Go straight to the last read of the read index (see
+	// read_index.h) before the read at read_pos, if it is after the
+	// current read: the reads in between are not parsed
+	//
+	void skip_to (const unsigned long & read_pos)
+	{
+		const std::vector<unsigned long> & offsets = read_index.get_offsets();
+		const unsigned long indexed = read_pos / READ_INDEX_STEP;
+		if (indexed < offsets.size() && indexed * READ_INDEX_STEP > current_read_pos && infile.seek(offsets[indexed])) {
+			current_read_pos = indexed * READ_INDEX_STEP;
+			has_data = false;
+		}
+	}
 	
 	////////////////////////////////////////////////////////////
-	// Open the file, count reads and read boolean vector in bv file
+	// Read the next line that is not empty
+	//
+	bool next_non_empty_line ()
+	{
+		while (infile.next_line(line)) {
+			if (line.size > 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Read the 4 lines of the next FASTQ entry: "@sequence comment",
+	// sequence, "+quality comment" and "quality sequence", with the
+	// empty lines between them but before the sequence. Return false
+	// if the entry is not complete.
+	//
+	bool read_entry ()
+	{
+		infile.begin_record();
+		const unsigned long record_offset = infile.tell();
+		if (!next_non_empty_line()) {
+			return false;
+		}
+		current_read_offset = record_offset + line.start;
+		if (!infile.next_line(sequence) || !next_non_empty_line()) {
+			return false;
+		}
+		if (infile.get(line)[0] != '+') {
+			std::cerr << "Error\n";
+		}
+		return next_non_empty_line();
+	}
+	
+protected:
+	
+	////////////////////////////////////////////////////////////
+	// Nothing is opened yet, for the readers of gzipped files
+	//
+	FastqFile () : has_data (false) {}
+	
+	////////////////////////////////////////////////////////////
+	// Open the file, gzipped or not, and count reads. Set the
+	// boolean vector to 1, or read it in bv file if one is given
 	// + check boolean vector size and nb_reads are equal
 	//
-	explicit FastqFile (const std::string & file_name, const std::string & bv_file_name)
+	void open_file (const std::string & file_name, const std::string * bv_file_name, const bool & gzip)
 	{
 		fname = file_name;
+		has_data = false;
 		// Open the file
-		infile.open (file_name.c_str());
-		if (!infile.good()) {
+		if (!infile.open(file_name, gzip)) {
 			std::cerr << "Error: Cannot open Fastq File " << file_name << "\n";
 			exit(1);
 		}
 		// Count reads
 		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (infile.good()) {
-			getline (infile, tmp_str);
-			if (!tmp_str.empty()) {
-				nb_reads++;
+		count_reads();
+		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
+		if (bv_file_name == NULL) {
+			// Set boolean vector to 1
+			bv.init_true(nb_reads);
+		} else {
+			// Read the boolean vector in bv file
+			bv.read(*bv_file_name);
+			// Check boolean vector size and nb_reads are equal
+			if (nb_reads != bv.size()) {
+				std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
+				exit(1);
 			}
 		}
-		nb_reads = nb_reads / 4;
-		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s in " << file_name << "\n";
-		// Read the boolean vector in bv file
-		bv.read(bv_file_name);
-		// Check boolean vector size and nb_reads are equal
-		if (nb_reads != bv.size()) {
-			std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
-			exit(1);
-		}
-		
 		current_read_pos = 0;
 		_nb_valid_reads = bv.nb_one();
 		_cnt_valid_reads = 0;
 		first_read = true;
 	}
 	
+public:
 	
 	////////////////////////////////////////////////////////////
-	// Destructor only closes the file
+	// Open the file, count reads and set boolean vector to 1
 	//
-	~FastqFile () {
-		infile.close();
+	explicit FastqFile (const std::string & file_name)
+	{
+		open_file(file_name, NULL, false);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Open the file, count reads and read boolean vector in bv file
+	// + check boolean vector size and nb_reads are equal
+	//
+	explicit FastqFile (const std::string & file_name, const std::string & bv_file_name)
+	{
+		open_file(file_name, &bv_file_name, false);
 	}
 	
 	
@@ -135,12 +198,16 @@ public:
 		} else {
 			first_read = false;
 		}
-		current_read_data.clear();
+		has_data = false;
 		current_read_seq.clear();
 		
 		if (_cnt_valid_reads < _nb_valid_reads) {
+			// Jump to the indexed read before the next valid read
+			if (current_read_pos < nb_reads && !bv.is_set(current_read_pos)) {
+				skip_to(bv.next_set(current_read_pos));
+			}
 			// While reads are not valid in the boolean vector, flush them
-			while (current_read_pos < nb_reads && infile.good()) {
+			while (current_read_pos < nb_reads && infile.peek() != EOF) {
 				if (!bv.is_set(current_read_pos)) {
 					flush_next_read ();
 					current_read_pos++;
@@ -150,53 +217,8 @@ public:
 			}
 			// The current read is 1 in the boolean vector
 			// Or current_read_pos >= nb_reads -> end of file
-			if (current_read_pos < nb_reads) {
-				// Read the first line of FASTQ entry -> "@sequence comment"
-				if (infile.good() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-					getline (infile, tmp_str);
-					while (tmp_str.empty() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-						getline (infile, tmp_str);
-					}
-					current_read_data += tmp_str + "\n";
-				} else {
-					return current_read_seq;
-				}
-				// Read the second line of FASTQ entry -> sequence of the read
-				if (infile.good() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-					getline (infile, current_read_seq);
-					while (tmp_str.empty() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-						getline (infile, tmp_str);
-					}
-					current_read_data += current_read_seq + "\n";
-				} else {
-					return current_read_seq;
-				}
-				// Read the third line of FASTQ entry -> "+quality comment"
-				if (infile.good() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-					getline (infile, tmp_str);
-					while (tmp_str.empty() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-						getline (infile, tmp_str);
-					}
-					if (tmp_str[0] != '+') {
-						std::cerr << "Error\n";
-					}
-					current_read_data += tmp_str + "\n";
-				} else {
-					current_read_seq.clear();
-					current_read_data.clear();
-					return current_read_seq;
-				}
-				// Read the fourth line of FASTQ entry -> "quality sequence"
-				if (infile.good()) {
-					getline (infile, tmp_str);
-					while (tmp_str.empty() && infile.good()) {
-						getline (infile, tmp_str);
-					}
-					current_read_data += tmp_str + "\n";
-				} else {
-					current_read_seq.clear();
-					current_read_data.clear();
-				}
+			if (current_read_pos < nb_reads && read_entry()) {
+				current_read_seq.assign(infile.get(sequence), sequence.size);
 			}
 			if (!current_read_seq.empty()) {
 				_cnt_valid_reads++;
@@ -210,40 +232,25 @@ public:
 	// Just read the next four lines without storing them
 	//
 	void flush_next_read () {
-		current_read_data.clear();
+		has_data = false;
 		current_read_seq.clear();
-		if (infile.good() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-			getline (infile, tmp_str);
-			while (tmp_str.empty() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-				getline (infile, tmp_str);
-			}
-		}
-		if (infile.good() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-			getline (infile, tmp_str);
-			while (tmp_str.empty() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-				getline (infile, tmp_str);
-			}
-		}
-		if (infile.good() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-			getline (infile, tmp_str);
-			while (tmp_str.empty() && infile.peek() != (int) std::char_traits<wchar_t>::eof()) {
-				getline (infile, tmp_str);
-			}
-		}
-		if (infile.good()) {
-			getline (infile, tmp_str);
-			while (tmp_str.empty() && infile.good()) {
-				getline (infile, tmp_str);
-			}
-		}
+		read_entry();
 	}
 	
 	
 	////////////////////////////////////////////////////////////
-	// Return the full FASTQ entry of the current read
+	// Return the full FASTQ entry of the current read, without
+	// its empty lines
 	//
 	const std::string & get_data() const
 	{
+		if (!has_data) {
+			current_read_data.clear();
+			if (!current_read_seq.empty()) {
+				infile.get_record(current_read_data);
+			}
+			has_data = true;
+		}
 		return current_read_data;
 	}
 	
@@ -298,8 +305,9 @@ public:
 	// because no read has been read
 	//
 	void rewind () {
-		infile.clear();
-		infile.seekg(0);
+		infile.rewind();
+		has_data = false;
+		current_read_seq.clear();
 		_cnt_valid_reads = 0;
 		current_read_pos = 0;
 		first_read = true;
@@ -350,314 +358,22 @@ public:
 	}
 };
 
-class GzFastqFile : public ReadFile  {
-private:
-	gzFile infile;
-	static const int NORMALSIZEREAD = 1048576;
-	char tmp_str[NORMALSIZEREAD];
+////////////////////////////////////////////////////////////
+// This class is used to read a gzipped FASTQ file: it is read as
+// a FASTQ file, decompressed ahead by other threads (see
+// gzip_reader.h), and the selected reads are saved gzipped
+//
+class GzFastqFile : public FastqFile
+{
 public:
-	////////////////////////////////////////////////////////////
-	// Open the file, count reads and set boolean vector to 1
-	//
 	explicit GzFastqFile (const std::string & file_name)
 	{
-		//std::cerr << "Add Gzip Fastq File " << file_name << "\n";
-		fname = file_name;
-		// Open the file
-		infile = (gzFile) gzopen (file_name.c_str(), "r");
-		if (infile == NULL) {
-			std::cerr << "Error: Cannot open Fasta File " << file_name << "\n";
-			exit(1);
-		}
-		// Count reads
-		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (gzgets(infile, tmp_str, NORMALSIZEREAD) != NULL) {
-			if (tmp_str[0] != '\0') {
-				nb_reads++;
-			}
-		}
-		nb_reads = nb_reads / 4;
-		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Set boolean vector to 1
-		bv.init_true(nb_reads);
-		current_read_pos = 0;
-		_nb_valid_reads = bv.nb_one();
-		_cnt_valid_reads = 0;
-		
-		first_read = true;
-		
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Open the file, count reads and read boolean vector in bv file
-	// + check boolean vector size and nb_reads are equal
-	//
-	explicit GzFastqFile (const std::string & file_name, const std::string & bv_file_name)
-	{
-		//std::cerr << "Add Gzip Fastq File " << file_name << "\n";
-		fname = file_name;
-		// Open the file
-		infile = (gzFile) gzopen (file_name.c_str(), "r");
-		if (infile == NULL) {
-			std::cerr << "Error: Cannot open Fasta File " << file_name << "\n";
-			exit(1);
-		}
-		// Count reads
-		//const clock_t begin_time = clock();
-		nb_reads = 0;
-		while (gzgets(infile, tmp_str, NORMALSIZEREAD) != NULL) {
-			if (tmp_str[0] != '\0') {
-				nb_reads++;
-			}
-		}
-		nb_reads = nb_reads / 4;
-		rewind();
-		//std::cerr << "Count " << nb_reads << " reads in " << float( clock () - begin_time ) / CLOCKS_PER_SEC << " s\n";
-		// Read the boolean vector in bv file
-		bv.read(bv_file_name);
-		// Check boolean vector size and nb_reads are equal
-		if (nb_reads != bv.size()) {
-			std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
-			exit(1);
-		}
-		current_read_pos = 0;
-		_nb_valid_reads = bv.nb_one();
-		_cnt_valid_reads = 0;
-		
-		first_read = true;
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Destructor only closes the file
-	//
-	~GzFastqFile () {
-		gzclose(infile);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// get_next_read returns the next read in the file
-	// OR an empty string if no more read is available
-	//
-	std::string & get_next_read () {
-		// clear data and increment the position
-		if (!first_read) {
-			current_read_pos++;
-		} else {
-			first_read = false;
-		}
-		current_read_data.clear();
-		current_read_seq.clear();
-		
-		if (_cnt_valid_reads < _nb_valid_reads) {
-			// While reads are not valid in the boolean vector, flush them
-			while (current_read_pos < nb_reads && !gzeof(infile)) {
-				if (!bv.is_set(current_read_pos)) {
-					flush_next_read ();
-					current_read_pos++;
-				} else {
-					break;
-				}
-			}
-			
-			// The current read is 1 in the boolean vector
-			// Or current_read_pos >= nb_reads -> end of file
-			if (current_read_pos < nb_reads) {
-				// Read the first line of FASTQ entry -> "@sequence comment"
-				if (!gzeof(infile)) {
-					gzgets(infile, tmp_str, NORMALSIZEREAD);
-					while (tmp_str[0] == '\0' && !gzeof(infile)) {
-						gzgets(infile, tmp_str, NORMALSIZEREAD);
-					}
-					current_read_data += std::string(tmp_str);
-					if (current_read_data[current_read_data.size() - 1] != '\n') {
-						current_read_data += '\n';
-					}
-				} else {
-					return current_read_seq;
-				}
-				// Read the second line of FASTQ entry -> sequence of the read
-				if (!gzeof(infile)) {
-					gzgets(infile, tmp_str, NORMALSIZEREAD);
-					while (tmp_str[0] == '\0' && !gzeof(infile)) {
-						gzgets(infile, tmp_str, NORMALSIZEREAD);
-					}
-					current_read_seq = tmp_str;
-					current_read_seq = current_read_seq.substr(0, current_read_seq.size() - 1);
-					current_read_data += current_read_seq;
-					if (current_read_data[current_read_data.size() - 1] != '\n') {
-						current_read_data += '\n';
-					}
-				} else {
-					return current_read_seq;
-				}
-				// Read the third line of FASTQ entry -> "+quality comment"
-				if (!gzeof(infile)) {
-					gzgets(infile, tmp_str, NORMALSIZEREAD);
-					while (tmp_str[0] == '\0' && !gzeof(infile)) {
-						gzgets(infile, tmp_str, NORMALSIZEREAD);
-					}
-					current_read_data += std::string(tmp_str);
-					if (current_read_data[current_read_data.size() - 1] != '\n') {
-						current_read_data += '\n';
-					}
-				} else {
-					current_read_seq.clear();
-					current_read_data.clear();
-					return current_read_seq;
-				}
-				// Read the fourth line of FASTQ entry -> "quality sequence"
-				if (!gzeof(infile)) {
-					gzgets(infile, tmp_str, NORMALSIZEREAD);
-					while (tmp_str[0] == '\0' && !gzeof(infile)) {
-						gzgets(infile, tmp_str, NORMALSIZEREAD);
-					}
-					current_read_data += std::string(tmp_str);
-					if (current_read_data[current_read_data.size() - 1] != '\n') {
-						current_read_data += '\n';
-					}
-				} else {
-					current_read_seq.clear();
-					current_read_data.clear();
-				}
-			}
-			if (!current_read_seq.empty()) {
-				_cnt_valid_reads++;
-			}
-		}
-		return current_read_seq;
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Just read the next four lines without storing them
-	//
-	void flush_next_read () {
-		current_read_data.clear();
-		current_read_seq.clear();
-		if (!gzeof(infile)) {
-			gzgets(infile, tmp_str, NORMALSIZEREAD);
-			while (tmp_str[0] == '\0' && !gzeof(infile)) {
-				gzgets(infile, tmp_str, NORMALSIZEREAD);
-			}
-		}
-		if (!gzeof(infile)) {
-			gzgets(infile, tmp_str, NORMALSIZEREAD);
-			while (tmp_str[0] == '\0' && !gzeof(infile)) {
-				gzgets(infile, tmp_str, NORMALSIZEREAD);
-			}
-		}
-		if (!gzeof(infile)) {
-			gzgets(infile, tmp_str, NORMALSIZEREAD);
-			while (tmp_str[0] == '\0' && !gzeof(infile)) {
-				gzgets(infile, tmp_str, NORMALSIZEREAD);
-			}
-		}
-		if (!gzeof(infile)) {
-			gzgets(infile, tmp_str, NORMALSIZEREAD);
-			while (tmp_str[0] == '\0' && !gzeof(infile)) {
-				gzgets(infile, tmp_str, NORMALSIZEREAD);
-			}
-		}
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Return the full FASTQ entry of the current read
-	//
-	const std::string & get_data() const
-	{
-		return current_read_data;
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Return the sequence of the current read
-	//
-	const std::string & get_read() const
-	{
-		return current_read_seq;
-	}
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the current read to 1 in the boolean vector
-	//
-	void tag_current_read ()
-	{
-		bv.set(current_read_pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the current read to 0 in the boolean vector
-	//
-	void untag_current_read ()
-	{
-		bv.unset(current_read_pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the read at pos to 1 in the boolean vector
-	//
-	void tag (const unsigned long & pos)
-	{
-		bv.set(pos);
-	}
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the bit of the read at pos to 0 in the boolean vector
-	//
-	void untag (const unsigned long & pos)
-	{
-		bv.unset(pos);
+		open_file(file_name, NULL, true);
 	}
 	
-	
-	////////////////////////////////////////////////////////////
-	// Go to the beginning of the file -> current_read_pos = -1
-	// because no read has been read
-	//
-	void rewind () {
-		gzclose(infile);
-		infile = (gzFile) gzopen (fname.c_str(), "r");
-		if (infile == NULL) {
-			std::cerr << "Error: Cannot open Fasta File " << fname << "\n";
-			exit(1);
-		}
-		current_read_pos = 0;
-		_cnt_valid_reads = 0;
-		first_read = true;
-	};
-	
-	
-	////////////////////////////////////////////////////////////
-	// Set the comment of the boolean vector
-	//
-	void set_bv_comment (const std::string & str)
+	GzFastqFile (const std::string & file_name, const std::string & bv_file_name)
 	{
-		bv.set_comment(str);
-	}
-	
-	////////////////////////////////////////////////////////////
-	// Save the boolean vector in the given file name
-	//
-	void save_bv (const std::string & file_name)
-	{
-		bv.print(file_name);
-	}
-	
-	////////////////////////////////////////////////////////////
-	// Save the boolean vector in fname.bv
-	//
-	void save_bv ()
-	{
-		bv.print(fname + ".bv");
+		open_file(file_name, &bv_file_name, true);
 	}
 	
 	////////////////////////////////////////////////////////////
@@ -678,7 +394,6 @@ public:
 		}
 		gzclose(filetmp);
 	}
-
 };
 
 #endif
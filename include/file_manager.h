@@ -29,6 +29,7 @@
 
 #include "fasta_file.h"
 #include "fastq_file.h"
+#include "packed_read_file.h"
 
 #include <iostream>
 #include <vector>
@@ -133,6 +134,11 @@ public:
 			infile.close();
 			files.push_back(new FastqFile(file_name));
 		}
+		// Packed read file (see pack_reads)
+		else if (c == 'C' && PackedReadFile::is_packed(file_name)) {
+			infile.close();
+			files.push_back(new PackedReadFile(file_name));
+		}
 		// Gzip file
 		else {
 			infile.close();
@@ -186,6 +192,9 @@ public:
 		} else if (c == '@') {
 			infile.close();
 			files.push_back(new FastqFile(file_name, bv_file_name));
+		} else if (c == 'C' && PackedReadFile::is_packed(file_name)) {
+			infile.close();
+			files.push_back(new PackedReadFile(file_name, bv_file_name));
 		} else {
 			infile.close();
 			gzFile tmp_gz_file = (gzFile) gzopen(file_name.c_str(), "r");
@@ -243,14 +252,30 @@ public:
 	}
 	
 	void save_bv (const std::string & directory, const std::string & suffix) {
+		save_bv(directory, suffix, file_bvs);
+	};
+	
+	// Save the given boolean vectors of the files (one per file), ie
+	// the reads found in one of several indexes (see search_reads_colors)
+	void save_bv (const std::string & directory, const std::string & suffix, std::vector<BooleanVector> & bvs) {
 		for (int i = 0; i < (int) files.size(); i++) {
 			std::string current_fname = directory + "/" + files[i]->get_fname().substr(files[i]->get_fname().rfind("/") + 1)  + "_in_" + suffix+ ".bv";
 			std::string comment = files[i]->get_fname() + " in " + suffix;
-			file_bvs[i].set_comment(comment);
-			file_bvs[i].print(current_fname);
+			bvs[i].set_comment(comment);
+			bvs[i].print(current_fname);
 		}
 	};
 	
+	// Empty boolean vectors of the files, one per file
+	std::vector<BooleanVector> get_empty_bvs () const
+	{
+		std::vector<BooleanVector> bvs (file_bvs);
+		for (int i = 0; i < (int) bvs.size(); i++) {
+			bvs[i].set_all_false();
+		}
+		return bvs;
+	}
+	
 	void tag_current_read () {
 		nb_tagged_reads++;
 		file_bvs[current_file].set(files[current_file]->get_read_pos());
@@ -262,6 +287,13 @@ public:
 		return file_bvs[current_file].is_set(files[current_file]->get_read_pos());
 	}
 	
+	// Position of the current read, to tag it later with tag_read
+	int get_current_file () const {return current_file;}
+	const unsigned long & get_current_read_pos () const {return files[current_file]->get_read_pos();}
+	void tag_read (const int & file, const unsigned long & pos) {
+		file_bvs[file].set(pos);
+	}
+	
 	const std::string & get_sum_of_file_names () const {return sum_of_file_names;}
 	
 	unsigned long get_total_nb_reads () const {
@@ -118,6 +118,11 @@ public:
 			infile.close();
 			files.push_back(new FastqFile(file_name));
 		}
+		// Packed read file (see pack_reads)
+		else if (c == 'C' && PackedReadFile::is_packed(file_name)) {
+			infile.close();
+			files.push_back(new PackedReadFile(file_name));
+		}
 		// Gzip file
 		else {
 			infile.close();
@@ -175,6 +180,9 @@ public:
 		} else if (c == '@') {
 			infile.close();
 			files.push_back(new FastqFile(file_name, bv_file_name));
+		} else if (c == 'C' && PackedReadFile::is_packed(file_name)) {
+			infile.close();
+			files.push_back(new PackedReadFile(file_name, bv_file_name));
 		} else {
 			infile.close();
 			gzFile tmp_gz_file = (gzFile) gzopen(file_name.c_str(), "r");
@@ -0,0 +1,423 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GZIP_READER_H_
+#define GZIP_READER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Size of the decompressed chunks of a gzipped file
+#define GZIP_CHUNK_SIZE (4 << 20)
+// Number of chunks decompressed ahead of the reader
+#define GZIP_RING_SIZE 4
+// BGZF blocks (at most 64 kB each) are decompressed by batches of
+// BGZF_BATCH_BLOCKS blocks, one chunk each
+#define BGZF_BATCH_BLOCKS 64
+#define BGZF_MAX_BLOCK_SIZE 65536
+// Maximal number of threads decompressing a BGZF file
+#define BGZF_MAX_THREADS 4
+
+// A chunk of decompressed data, and for BGZF its compressed blocks
+struct GzipChunk
+{
+	enum State {FREE, FILLING, READY};
+	State state;
+	// The last chunk of the file, which may be empty
+	bool last;
+	std::vector<char> data;
+	size_t size;
+	std::vector<unsigned char> compressed;
+	std::vector<size_t> blocks;
+};
+
+/*
+ * GzipReader decompresses a gzipped file in other threads, ahead of the
+ * thread reading it with read() (see LineReader in line_reader.h), so
+ * that the decompression and the use of the reads overlap.
+ *
+ * The decompressed data are given by chunks, through a ring of chunks:
+ * chunk i is in ring[i % size of the ring], and is filled once the
+ * reader has released chunk i - size of the ring.
+ * - A gzipped file is decompressed by one thread, with gzread.
+ * - A BGZF file (block gzip, as written by bgzip) is a series of gzip
+ *   members of at most 64 kB. Its blocks are read by batches, in turn,
+ *   by several threads, which decompress them in parallel, each batch in
+ *   its own chunk.
+ * The threads are started by the first read and stopped at the end of
+ * the file, which frees the chunks, or by rewind.
+ */
+class GzipReader
+{
+private:
+	std::string file_name;
+	bool bgzf;
+	int nb_threads;
+	std::vector<pthread_t> threads;
+	bool started;
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	std::vector<GzipChunk> ring;
+	// Next chunk to fill and chunk being read
+	unsigned long next_chunk, current_chunk;
+	size_t current_pos;
+	bool stop, end_of_input, end_of_file;
+	FILE * input;
+	
+	// True if the file starts with a gzip header holding the BC field of
+	// BGZF
+	static bool is_bgzf (const std::string & name)
+	{
+		FILE * file = fopen(name.c_str(), "rb");
+		if (file == NULL) {
+			return false;
+		}
+		unsigned char header[12];
+		bool found = false;
+		if (fread(header, 1, 12, file) == 12 && header[0] == 31 && header[1] == 139 && header[2] == 8 && (header[3] & 4)) {
+			std::vector<unsigned char> extra (header[10] | (header[11] << 8));
+			if (fread(&extra[0], 1, extra.size(), file) == extra.size()) {
+				for (size_t i = 0; i + 4 <= extra.size(); i += 4 + (extra[i + 2] | (extra[i + 3] << 8))) {
+					found |= extra[i] == 'B' && extra[i + 1] == 'C';
+				}
+			}
+		}
+		fclose(file);
+		return found;
+	}
+	
+	// Wait until the chunk after the last filled one is free, then take
+	// it. Return NULL if the threads are stopped or at the end of the
+	// input. Under the mutex.
+	GzipChunk * take_chunk ()
+	{
+		while (!stop && !end_of_input && ring[next_chunk % ring.size()].state != GzipChunk::FREE) {
+			pthread_cond_wait(&changed, &mutex);
+		}
+		if (stop || end_of_input) {
+			return NULL;
+		}
+		GzipChunk * chunk = &ring[next_chunk % ring.size()];
+		next_chunk++;
+		chunk->state = GzipChunk::FILLING;
+		chunk->last = false;
+		chunk->size = 0;
+		return chunk;
+	}
+	
+	void set_ready (GzipChunk * chunk)
+	{
+		pthread_mutex_lock(&mutex);
+		chunk->state = GzipChunk::READY;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&mutex);
+	}
+	
+	// Decompress the file with gzread, chunk by chunk
+	static void * gzip_thread (void * arg)
+	{
+		GzipReader * reader = (GzipReader *) arg;
+		gzFile file = gzopen(reader->file_name.c_str(), "r");
+		if (file == NULL) {
+			std::cerr << "Error: Cannot open gzip file " << reader->file_name << " -> exit\n";
+			exit(1);
+		}
+		gzbuffer(file, 1 << 17);
+		while (true) {
+			pthread_mutex_lock(&reader->mutex);
+			GzipChunk * chunk = reader->take_chunk();
+			pthread_mutex_unlock(&reader->mutex);
+			if (chunk == NULL) {
+				break;
+			}
+			chunk->data.resize(GZIP_CHUNK_SIZE);
+			int nb_read;
+			while (chunk->size < GZIP_CHUNK_SIZE && (nb_read = gzread(file, &chunk->data[chunk->size], GZIP_CHUNK_SIZE - chunk->size)) > 0) {
+				chunk->size += nb_read;
+			}
+			if (nb_read < 0) {
+				int error;
+				std::cerr << "Error: Cannot decompress " << reader->file_name << ": " << gzerror(file, &error) << " -> exit\n";
+				exit(1);
+			}
+			if (chunk->size < GZIP_CHUNK_SIZE) {
+				pthread_mutex_lock(&reader->mutex);
+				reader->end_of_input = true;
+				pthread_mutex_unlock(&reader->mutex);
+				chunk->last = true;
+			}
+			reader->set_ready(chunk);
+		}
+		gzclose(file);
+		return NULL;
+	}
+	
+	// Read the next BGZF block of the input in the chunk, return false at
+	// the end of the file. Under the mutex.
+	bool read_block (GzipChunk * chunk)
+	{
+		unsigned char header[12];
+		const size_t nb_read = fread(header, 1, 12, input);
+		if (nb_read == 0 && feof(input)) {
+			return false;
+		}
+		if (nb_read != 12 || header[0] != 31 || header[1] != 139 || header[2] != 8 || !(header[3] & 4)) {
+			std::cerr << "Error: " << file_name << " is not a BGZF file -> exit\n";
+			exit(1);
+		}
+		const size_t extra_size = header[10] | (header[11] << 8);
+		unsigned char extra[BGZF_MAX_BLOCK_SIZE];
+		long block_size = -1;
+		if (fread(extra, 1, extra_size, input) == extra_size) {
+			for (size_t i = 0; i + 4 <= extra_size; i += 4 + (extra[i + 2] | (extra[i + 3] << 8))) {
+				if (extra[i] == 'B' && extra[i + 1] == 'C' && i + 6 <= extra_size) {
+					block_size = (extra[i + 4] | (extra[i + 5] << 8)) + 1;
+				}
+			}
+		}
+		// The deflated data, its CRC32 and its size follow the header
+		const long data_size = block_size - 12 - (long) extra_size;
+		if (data_size < 8) {
+			std::cerr << "Error: " << file_name << " is not a BGZF file -> exit\n";
+			exit(1);
+		}
+		const size_t start = chunk->compressed.size();
+		chunk->compressed.resize(start + data_size);
+		if (fread(&chunk->compressed[start], 1, data_size, input) != (size_t) data_size) {
+			std::cerr << "Error: Truncated BGZF file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		chunk->blocks.push_back(start);
+		return true;
+	}
+	
+	// Take the next batch of BGZF blocks, in turn with the other threads,
+	// and decompress it
+	static void * bgzf_thread (void * arg)
+	{
+		GzipReader * reader = (GzipReader *) arg;
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		if (inflateInit2(&stream, -15) != Z_OK) {
+			std::cerr << "Error: Cannot initialize zlib -> exit\n";
+			exit(1);
+		}
+		while (true) {
+			pthread_mutex_lock(&reader->mutex);
+			GzipChunk * chunk = reader->take_chunk();
+			if (chunk == NULL) {
+				pthread_mutex_unlock(&reader->mutex);
+				break;
+			}
+			chunk->compressed.clear();
+			chunk->blocks.clear();
+			while (chunk->blocks.size() < BGZF_BATCH_BLOCKS && reader->read_block(chunk)) {
+			}
+			if (chunk->blocks.size() < BGZF_BATCH_BLOCKS) {
+				reader->end_of_input = true;
+				chunk->last = true;
+			}
+			pthread_mutex_unlock(&reader->mutex);
+			chunk->blocks.push_back(chunk->compressed.size());
+			chunk->data.resize(BGZF_BATCH_BLOCKS * BGZF_MAX_BLOCK_SIZE);
+			for (size_t block = 0; block + 1 < chunk->blocks.size(); block++) {
+				reader->inflate_block(stream, &chunk->compressed[chunk->blocks[block]], chunk->blocks[block + 1] - chunk->blocks[block], chunk);
+			}
+			reader->set_ready(chunk);
+		}
+		inflateEnd(&stream);
+		return NULL;
+	}
+	
+	// Decompress a BGZF block (deflated data, CRC32, size) at the end of
+	// the data of the chunk
+	void inflate_block (z_stream & stream, unsigned char * block, const size_t & block_size, GzipChunk * chunk)
+	{
+		const unsigned char * footer = block + block_size - 8;
+		const unsigned long crc = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((unsigned long) footer[3] << 24);
+		const size_t size = footer[4] | (footer[5] << 8) | (footer[6] << 16) | ((unsigned long) footer[7] << 24);
+		unsigned char * data = (unsigned char *) &chunk->data[chunk->size];
+		inflateReset(&stream);
+		stream.next_in = block;
+		stream.avail_in = block_size - 8;
+		stream.next_out = data;
+		stream.avail_out = std::min(size, chunk->data.size() - chunk->size);
+		if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.total_out != size || crc32(crc32(0L, Z_NULL, 0), data, size) != crc) {
+			std::cerr << "Error: Cannot decompress " << file_name << ": corrupted BGZF block -> exit\n";
+			exit(1);
+		}
+		chunk->size += size;
+	}
+	
+	void start ()
+	{
+		ring.assign(bgzf ? 2 * nb_threads : GZIP_RING_SIZE, GzipChunk ());
+		for (size_t i = 0; i < ring.size(); i++) {
+			ring[i].state = GzipChunk::FREE;
+		}
+		next_chunk = current_chunk = 0;
+		current_pos = 0;
+		stop = end_of_input = end_of_file = false;
+		if (bgzf) {
+			input = fopen(file_name.c_str(), "rb");
+			if (input == NULL) {
+				std::cerr << "Error: Cannot open gzip file " << file_name << " -> exit\n";
+				exit(1);
+			}
+		}
+		threads.resize(bgzf ? nb_threads : 1);
+		for (size_t i = 0; i < threads.size(); i++) {
+			if (pthread_create(&threads[i], NULL, bgzf ? bgzf_thread : gzip_thread, this) != 0) {
+				std::cerr << "Cannot create decompression thread -> exit\n";
+				exit(1);
+			}
+		}
+		started = true;
+	}
+	
+	// Stop and join the threads, and free the chunks
+	void finish ()
+	{
+		if (!started) {
+			return;
+		}
+		pthread_mutex_lock(&mutex);
+		stop = true;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&mutex);
+		for (size_t i = 0; i < threads.size(); i++) {
+			pthread_join(threads[i], NULL);
+		}
+		if (input != NULL) {
+			fclose(input);
+			input = NULL;
+		}
+		std::vector<GzipChunk> ().swap(ring);
+		started = false;
+	}
+	
+public:
+	GzipReader ()
+	{
+		bgzf = false;
+		nb_threads = 1;
+		started = false;
+		end_of_file = false;
+		input = NULL;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&changed, NULL);
+	}
+	
+	~GzipReader ()
+	{
+		finish();
+		pthread_mutex_destroy(&mutex);
+		pthread_cond_destroy(&changed);
+	}
+	
+	// Open the file, return false if it cannot be read
+	bool open (const std::string & name)
+	{
+		file_name = name;
+		gzFile file = gzopen(name.c_str(), "r");
+		if (file == NULL) {
+			return false;
+		}
+		gzclose(file);
+		bgzf = is_bgzf(name);
+		nb_threads = std::max(1L, std::min((long) BGZF_MAX_THREADS, sysconf(_SC_NPROCESSORS_ONLN)));
+		rewind();
+		return true;
+	}
+	
+	// Go back to the beginning of the file
+	void rewind ()
+	{
+		finish();
+		end_of_file = false;
+	}
+	
+	// Copy at most size decompressed chars to data, as read(2) does, or
+	// only skip them if data is NULL. Return 0 at the end of the file.
+	size_t read (char * data, const size_t & size)
+	{
+		if (end_of_file) {
+			return 0;
+		}
+		if (!started) {
+			start();
+		}
+		while (true) {
+			GzipChunk & chunk = ring[current_chunk % ring.size()];
+			pthread_mutex_lock(&mutex);
+			while (chunk.state != GzipChunk::READY) {
+				pthread_cond_wait(&changed, &mutex);
+			}
+			pthread_mutex_unlock(&mutex);
+			if (current_pos < chunk.size) {
+				const size_t nb_read = std::min(size, chunk.size - current_pos);
+				if (data != NULL) {
+					memcpy(data, &chunk.data[current_pos], nb_read);
+				}
+				current_pos += nb_read;
+				return nb_read;
+			}
+			if (chunk.last) {
+				// The threads are done, their chunks are freed
+				finish();
+				end_of_file = true;
+				return 0;
+			}
+			// Release the chunk to the threads
+			pthread_mutex_lock(&mutex);
+			chunk.state = GzipChunk::FREE;
+			pthread_cond_broadcast(&changed);
+			pthread_mutex_unlock(&mutex);
+			current_chunk++;
+			current_pos = 0;
+		}
+	}
+	
+	// Skip size decompressed chars, return the number of chars skipped
+	size_t skip (const size_t & size)
+	{
+		size_t skipped = 0, nb_read;
+		while (skipped < size && (nb_read = read(NULL, size - skipped)) > 0) {
+			skipped += nb_read;
+		}
+		return skipped;
+	}
+};
+
+#endif
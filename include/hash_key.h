@@ -27,107 +27,196 @@
 #ifndef HASH_KEY_H_
 #define HASH_KEY_H_
 
-#include <math.h>
+#include "alphabet.h"
 
+/*
+ * HashKey is the rolling 2-bit encoding of a k-mer.
+ *
+ * The 2 bits of each nucleotide (A -> 00, C -> 01, G -> 10, T -> 11) are
+ * packed in two words of k bits, one for the high bit and one for the low
+ * bit of each nucleotide, so that a k-mer of up to 63 nucleotides is
+ * updated with one shift per word. The 4 keys used by the Bloom filters
+ * are derived from these words:
+ * keya : A/C -> 0, G/T -> 1 (high bits)
+ * keyb : A/G -> 0, C/T -> 1 (low bits)
+ * keyc : A/T -> 0, C/G -> 1 (keya ^ keyb)
+ * keyd : A -> 0, C/G/T -> 1 (keya | keyb)
+ */
 class HashKey
 {
 private:
-	unsigned long _keya, _keyb, _keyc, _keyd;
+	unsigned long _keya, _keyb;
 	unsigned long mask_size_kmer;
-	unsigned long rv_mask_size_kmer;
-	unsigned long bloom_size;
+	int rv_shift;
 	int hash_size;
+	const unsigned char * codes;
 public:
 	
 	HashKey (const int & kmer_size)
 	{
-		// Set bloom filter size 1000...0
-		bloom_size = (unsigned long) pow (2, kmer_size - 1);
-		// mask_size_kmer = 1111...1
-		mask_size_kmer = (2 * bloom_size) - 1;
-		// rv_mask_size_kmer = 0111...1
-		rv_mask_size_kmer = bloom_size - 1;
+		// mask_size_kmer = 1111...1 (k bits)
+		mask_size_kmer = (1UL << kmer_size) - 1;
+		// position of the first nucleotide of the k-mer
+		rv_shift = kmer_size - 1;
+		codes = Alphabet::getInstance()->get_codes();
 		clear();
 	}
 	
-	// Clear the 4 keys
+	// Clear the keys
 	void clear()
 	{
 		hash_size = 0;
-		_keya = _keyb = _keyc = _keyd = 0;
+		_keya = _keyb = 0;
 	}
 	
-	// Add an amino acid to the 4 keys and return the hash_size
+	// Add a nucleotide to the keys and return the hash_size
 	//
-	// This is supposed to add amino acids from the beginning of the read to the end
-	// When an amino acid is added, all bits are pushed to the left
-	// then the last bit is set to 1
+	// This is supposed to add nucleotides from the beginning of the read to the end
+	// When a nucleotide is added, all bits are pushed to the left
+	// then its 2 bits are set as the last bits of the keys
+	// Any other char clears the keys
+	//
+	// With K > 0, the k-mers are of size K, known at compile time: the mask
+	// is a constant (see the kernels for K in hash_key.h)
+	template <int K>
 	const int & add (const char & aa)
 	{
-		hash_size++;
-		_keya = (_keya << 1) & mask_size_kmer;
-		_keyb = (_keyb << 1) & mask_size_kmer;
-		_keyc = (_keyc << 1) & mask_size_kmer;
-		_keyd = (_keyd << 1) & mask_size_kmer;
-		if(aa == 'C' || aa == 'c')
-		{
-			_keyb |= 1;
-			_keyc |= 1;
-			_keyd |= 1;
-		}
-		else if(aa == 'G' || aa == 'g')
-		{
-			_keya |= 1;
-			_keyc |= 1;
-			_keyd |= 1;
-		}
-		else if(aa == 'T' || aa == 't')
-		{
-			_keya |= 1;
-			_keyb |= 1;
-			_keyd |= 1;
+		const unsigned long code = codes[(unsigned char) aa];
+		if (code == NOT_NUCLEOTIDE) {
+			clear();
+			return hash_size;
 		}
+		const unsigned long mask = K > 0 ? (1UL << K) - 1 : mask_size_kmer;
+		hash_size++;
+		_keya = ((_keya << 1) | (code >> 1)) & mask;
+		_keyb = ((_keyb << 1) | (code & 1)) & mask;
 		return hash_size;
 	}
 	
-	// Add the reverse complement amino acid to the 4 keys and return the hash_size
+	const int & add (const char & aa) {return add<0>(aa);}
+	
+	// Add the reverse complement nucleotide to the keys and return the hash_size
 	// This method is designed to be used as the add() method
 	// But the produced hash correspond to the reverse complement
 	//
-	// When an amino acid is added, all bits are pushed to the right
-	// then the first bit is set to 1
-	const int & rv_add (char & aa)
+	// When a nucleotide is added, all bits are pushed to the right
+	// then the 2 bits of its complement (code ^ 3) are set as the first bits
+	// With K > 0, the shift is a constant, as the mask of add
+	template <int K>
+	const int & rv_add (const char & aa)
 	{
-		hash_size++;
-		_keya = (_keya >> 1) & rv_mask_size_kmer;
-		_keyb = (_keyb >> 1) & rv_mask_size_kmer;
-		_keyc = (_keyc >> 1) & rv_mask_size_kmer;
-		_keyd = (_keyd >> 1) & rv_mask_size_kmer;
-		if(aa=='A' || aa=='a')
-		{
-			_keya |= bloom_size;
-			_keyb |= bloom_size;
-			_keyd |= bloom_size;
-		}
-		else if(aa == 'C' || aa == 'c')
-		{
-			_keya |= bloom_size;
-			_keyc |= bloom_size;
-			_keyd |= bloom_size;
-		}
-		else if(aa=='G' || aa == 'g')
-		{
-			_keyb |= bloom_size;
-			_keyc |= bloom_size;
-			_keyd |= bloom_size;
+		const unsigned long code = codes[(unsigned char) aa];
+		if (code == NOT_NUCLEOTIDE) {
+			clear();
+			return hash_size;
 		}
+		const int shift = K > 0 ? K - 1 : rv_shift;
+		hash_size++;
+		_keya = (_keya >> 1) | ((~code >> 1 & 1) << shift);
+		_keyb = (_keyb >> 1) | ((~code & 1) << shift);
 		return hash_size;
 	}
 	
+	const int & rv_add (const char & aa) {return rv_add<0>(aa);}
+	
+	// Set the keys of a k-mer, ie read back from a file (see partitioned_index.h)
+	void set (const unsigned long & keya, const unsigned long & keyb)
+	{
+		_keya = keya & mask_size_kmer;
+		_keyb = keyb & mask_size_kmer;
+	}
+	
+	// 64 bits hash of the k-mer
+	// keya and keyb together are the 2-bit encoding of the k-mer
+	// so the mixed key depends on every nucleotide of the k-mer
+	unsigned long mixed_key () const {return mix(mix(_keya) ^ _keyb);}
+	
+	// Finalizer of MurmurHash3, spreads every bit of x over the 64 bits
+	static unsigned long mix (unsigned long x)
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdUL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53UL;
+		x ^= x >> 33;
+		return x;
+	}
+	
+	// Order of the k-mers given by their 2-bit encoding (keya, keyb)
+	// Bitwise operators: the order of a k-mer and of its reverse complement
+	// is random, a branch on it would be mispredicted half of the time
+	bool operator< (const HashKey & other) const
+	{
+		return (_keya < other._keya) | ((_keya == other._keya) & (_keyb < other._keyb));
+	}
+	
 	const unsigned long & keya () const {return _keya;}
 	const unsigned long & keyb () const {return _keyb;}
-	const unsigned long & keyc () const {return _keyc;}
-	const unsigned long & keyd () const {return _keyd;}
+	unsigned long keyc () const {return _keya ^ _keyb;}
+	unsigned long keyd () const {return _keya | _keyb;}
+};
+
+/*
+ * Keys of the k-mers of a read, used by the k-mer loops of index_reads.h
+ * and search_reads.h. Each one reads the nucleotides from the beginning
+ * of the read to the end, with clear(), add() and key():
+ *   ForwardKey   : key of the k-mer
+ *   ReverseKey   : key of the reverse complement of the k-mer
+ *   CanonicalKey : smallest of both, so that a k-mer and its reverse
+ *                  complement have the same key
+ *
+ * K is the size of the k-mers when it is known at compile time, 0 when it
+ * is only known at run time. size(kmer_size) gives it to the loops, so
+ * that their comparisons use a constant too. The loops are compiled for
+ * the sizes used in production (21, 25, 27, 31 and 33) and dispatched on
+ * the size given by -k, the other sizes use K = 0 (see feed_read in
+ * index_reads.h and search_read_in in search_reads.h). The loops that
+ * buffer the keys of a read, and the ones of the canonical k-mers, compute
+ * them at once (see kmer_keys.h).
+ */
+template <int K = 0>
+class ForwardKey
+{
+private:
+	HashKey & hash;
+public:
+	explicit ForwardKey (HashKey & forward_hash) : hash (forward_hash) {}
+	static int size (const int & kmer_size) {return K > 0 ? K : kmer_size;}
+	void clear () {hash.clear();}
+	const int & add (const char & aa) {return hash.add<K>(aa);}
+	const HashKey & key () const {return hash;}
+};
+
+template <int K = 0>
+class ReverseKey
+{
+private:
+	HashKey & hash;
+public:
+	explicit ReverseKey (HashKey & reverse_hash) : hash (reverse_hash) {}
+	static int size (const int & kmer_size) {return K > 0 ? K : kmer_size;}
+	void clear () {hash.clear();}
+	const int & add (const char & aa) {return hash.rv_add<K>(aa);}
+	const HashKey & key () const {return hash;}
+};
+
+template <int K = 0>
+class CanonicalKey
+{
+private:
+	HashKey & forward;
+	HashKey & reverse;
+public:
+	CanonicalKey (HashKey & forward_hash, HashKey & reverse_hash) : forward (forward_hash), reverse (reverse_hash) {}
+	static int size (const int & kmer_size) {return K > 0 ? K : kmer_size;}
+	void clear () {forward.clear(); reverse.clear();}
+	const int & add (const char & aa) {reverse.rv_add<K>(aa); return forward.add<K>(aa);}
+	// Chosen by indexing, without a branch (see operator<)
+	const HashKey & key () const
+	{
+		const HashKey * keys[2] = {&forward, &reverse};
+		return *keys[reverse < forward];
+	}
 };
 
 #endif
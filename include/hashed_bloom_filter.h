@@ -0,0 +1,122 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASHED_BLOOM_FILTER_H_
+#define HASHED_BLOOM_FILTER_H_
+
+#include "bloom_filter.h"
+
+// Number of bits set for each k-mer
+#define HASHED_NB_BITS 4
+
+/*
+ * Hashed Bloom filter
+ *
+ * The size of the filter is a memory budget in bytes, independent of k.
+ * The 4 bits of a k-mer are given by its mixed key (double hashing) and
+ * mapped on the whole filter by a multiplication instead of a modulo, so
+ * the size does not need to be a power of 2.
+ */
+class HashedBloomFilter : public BloomFilter
+{
+private:
+	unsigned long nb_bits;
+	
+	// Position of the i-th bit of the key in the filter
+	unsigned long bit_pos (const unsigned long & key, const int & i) const
+	{
+		const unsigned long step = ((key << 32) | (key >> 32)) | 1;
+		return (unsigned long) (((unsigned __int128) (key + i * step) * nb_bits) >> 64);
+	}
+	
+	static char bit_mask (const unsigned long & pos)
+	{
+		return (char) (1 << (pos % 8));
+	}
+	
+public:
+	HashedBloomFilter (const int & kmer_size, const unsigned long & size, const char * vector = NULL)
+	{
+		init(size, vector);
+		index_type = HASHED_INDEX;
+		nb_bits = 8 * size;
+	}
+	
+	void feed (const HashKey & hash_key)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		for (int i = 0; i < HASHED_NB_BITS; i++) {
+			const unsigned long pos = bit_pos(key, i);
+			bloom_vector[pos / 8] |= bit_mask(pos);
+		}
+	}
+	
+	void feed_atomic (const HashKey & hash_key)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		for (int i = 0; i < HASHED_NB_BITS; i++) {
+			const unsigned long pos = bit_pos(key, i);
+			feed_atomic_bit(pos / 8, bit_mask(pos));
+		}
+	}
+	
+	bool feed_new (const HashKey & hash_key, const bool & atomic)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		bool is_new = false;
+		for (int i = 0; i < HASHED_NB_BITS; i++) {
+			const unsigned long pos = bit_pos(key, i);
+			is_new |= set_new_bit(pos / 8, bit_mask(pos), atomic);
+		}
+		return is_new;
+	}
+	
+	// The HASHED_NB_BITS bits of a k-mer are anywhere in the filter
+	double get_fpr (const unsigned long & step = 0) const
+	{
+		return pow(get_occupancy(step), HASHED_NB_BITS);
+	}
+	
+	// Only the first bit is prefetched, as for the classic filter
+	void prefetch (const HashKey & hash_key) const
+	{
+		__builtin_prefetch(&bloom_vector[bit_pos(hash_key.mixed_key(), 0) / 8]);
+	}
+	
+	bool is_found (const HashKey & hash_key) const
+	{
+		const unsigned long key = hash_key.mixed_key();
+		for (int i = 0; i < HASHED_NB_BITS; i++) {
+			const unsigned long pos = bit_pos(key, i);
+			if (!(bloom_vector[pos / 8] & bit_mask(pos))) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+#endif
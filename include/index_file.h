@@ -0,0 +1,352 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDEX_FILE_H_
+#define INDEX_FILE_H_
+
+#include "bloom_filter.h"
+#include "index_type.h"
+#include "kmer_sampler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// First bytes of an index file
+#define INDEX_FILE_MAGIC "COMMETBF"
+// Version of the index file format (version 1 files, without sampling,
+// and version 2 files, without min_count and max_fpr, are still read)
+#define INDEX_FILE_VERSION 3
+// Version of the k-mer keys and of the hash functions of the filters,
+// to increase whenever HashKey or a filter changes the bits of a k-mer
+#define INDEX_HASH_VERSION 1
+// Alignment of the filters in the file, so that they can be mapped
+#define INDEX_FILE_ALIGN 4096
+
+/*
+ * Index file (.cbf), written by build_index and read by index_and_search
+ * and compare_reads (option -I)
+ *
+ * header:
+ *   char[8]  INDEX_FILE_MAGIC
+ *   uint32   INDEX_FILE_VERSION
+ *   uint32   INDEX_HASH_VERSION
+ *   int32    kmer_size
+ *   int32    index_type (see bloom_filter.h)
+ *   int32    canonical (0 or 1)
+ *   int32    minimizer size of a partitioned index, 0 for chunks
+ *   int32    window of the sampling minimizers, 0 without (version 2)
+ *   int32    size of the sampling syncmers, 0 without (version 2)
+ *   int32    minimal count of the indexed k-mers (-a), 1 without, 0 if
+ *            unknown (version 3)
+ *   float64  target false positive rate of the chunks (-e), 0 without,
+ *            -1 if unknown (version 3)
+ *   uint64   number of chunks
+ *   uint64   size of the manifest
+ *   char[]   manifest: nickname of the indexed set, then one indexed
+ *            file per line (with its boolean vector after a comma)
+ * then for each chunk (one Bloom filter, as given by index_reads):
+ *   uint64   size of the filter in bytes
+ *   uint64   number of indexed reads
+ *   char[]   filter, aligned on INDEX_FILE_ALIGN bytes
+ *
+ * The chunks of a partitioned index are its partitions (see
+ * partitioned_index.h): every read is indexed in all of them, so the
+ * number of indexed reads is only given by the first one.
+ *
+ * Numbers are written in the byte order of the machine.
+ */
+
+// Return pos rounded up to a multiple of INDEX_FILE_ALIGN
+unsigned long index_file_align (const unsigned long & pos)
+{
+	return (pos + INDEX_FILE_ALIGN - 1) / INDEX_FILE_ALIGN * INDEX_FILE_ALIGN;
+}
+
+/*
+ * IndexFileWriter writes the chunks of an index in a file, one by one.
+ */
+class IndexFileWriter
+{
+private:
+	FILE * file;
+	std::string file_name;
+	unsigned long nb_chunks;
+	long nb_chunks_pos;
+	
+	void write (const void * data, const unsigned long & size)
+	{
+		if (size > 0 && fwrite(data, 1, size, file) != size) {
+			std::cerr << "Cannot write index file " << file_name << " -> exit\n";
+			exit(1);
+		}
+	}
+	
+	// Write zeros up to the next multiple of INDEX_FILE_ALIGN
+	void pad ()
+	{
+		std::vector<char> zeros (INDEX_FILE_ALIGN, 0);
+		const unsigned long pos = ftell(file);
+		write(&zeros[0], index_file_align(pos) - pos);
+	}
+	
+public:
+	// minimizer_size is given for a partitioned index only, min_count and
+	// max_fpr as given to index_reads
+	IndexFileWriter (const std::string & index_file_name, const int & kmer_size, const int & index_type, const bool & canonical, const std::string & nickname, const std::vector<std::string> & sources, const int & minimizer_size = 0, const KmerSampling & sampling = KmerSampling (), const int & min_count = 1, const double & max_fpr = 0)
+	{
+		file_name = index_file_name;
+		file = fopen(file_name.c_str(), "wb");
+		if (file == NULL) {
+			std::cerr << "Cannot open index file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		nb_chunks = 0;
+		
+		std::string manifest = nickname + "\n";
+		for (size_t i = 0; i < sources.size(); i++) {
+			manifest += sources[i] + "\n";
+		}
+		const unsigned int version = INDEX_FILE_VERSION;
+		const unsigned int hash_version = INDEX_HASH_VERSION;
+		const int flags[7] = {kmer_size, index_type, canonical ? 1 : 0, minimizer_size, sampling.window, sampling.syncmer_size, min_count};
+		const unsigned long manifest_size = manifest.size();
+		write(INDEX_FILE_MAGIC, 8);
+		write(&version, sizeof(version));
+		write(&hash_version, sizeof(hash_version));
+		write(flags, sizeof(flags));
+		write(&max_fpr, sizeof(max_fpr));
+		nb_chunks_pos = ftell(file);
+		write(&nb_chunks, sizeof(nb_chunks));
+		write(&manifest_size, sizeof(manifest_size));
+		write(manifest.c_str(), manifest_size);
+	}
+	
+	~IndexFileWriter ()
+	{
+		if (file != NULL) {
+			close();
+		}
+	}
+	
+	// Append a chunk of nb_indexed_reads reads
+	void add_chunk (const BloomFilter * index, const unsigned long & nb_indexed_reads)
+	{
+		const unsigned long size = index->get_size();
+		write(&size, sizeof(size));
+		write(&nb_indexed_reads, sizeof(nb_indexed_reads));
+		pad();
+		write(index->get_vector(), size);
+		nb_chunks++;
+	}
+	
+	// Write the number of chunks in the header and close the file
+	void close ()
+	{
+		fseek(file, nb_chunks_pos, SEEK_SET);
+		write(&nb_chunks, sizeof(nb_chunks));
+		if (fclose(file) != 0) {
+			std::cerr << "Cannot write index file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		file = NULL;
+	}
+};
+
+/*
+ * IndexFile maps an index file in memory. The filters of its chunks are
+ * used in place, without copy: they are valid while the IndexFile exists.
+ */
+class IndexFile
+{
+private:
+	std::string file_name;
+	const char * mapping;
+	unsigned long mapping_size;
+	int kmer_size;
+	int index_type;
+	bool canonical;
+	int minimizer_size;
+	KmerSampling sampling;
+	unsigned int version;
+	int min_count;
+	double max_fpr;
+	std::string nickname;
+	std::vector<std::string> sources;
+	std::vector<unsigned long> chunk_pos;
+	std::vector<unsigned long> chunk_sizes;
+	std::vector<unsigned long> chunk_nb_reads;
+	unsigned long nb_indexed_reads;
+	
+	void error (const std::string & message) const
+	{
+		std::cerr << "Invalid index file " << file_name << ": " << message << " -> exit\n";
+		exit(1);
+	}
+	
+	// Read size bytes at pos and move pos after them
+	void read (void * data, unsigned long & pos, const unsigned long & size) const
+	{
+		if (pos + size > mapping_size) {
+			error("truncated file");
+		}
+		memcpy(data, mapping + pos, size);
+		pos += size;
+	}
+	
+public:
+	explicit IndexFile (const std::string & index_file_name)
+	{
+		file_name = index_file_name;
+		int fd = open(file_name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			std::cerr << "Cannot open index file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			std::cerr << "Cannot open index file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		mapping_size = info.st_size;
+		if (mapping_size == 0) {
+			error("empty file");
+		}
+		// Read-only mapping: the pages are those of the page cache and are
+		// not charged to the process, so an index larger than the memory
+		// can be opened and its chunks loaded one at a time (see get_chunk)
+		mapping = (const char *) mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			std::cerr << "Cannot map index file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		
+		// Header
+		unsigned long pos = 0;
+		char magic[8];
+		unsigned int hash_version;
+		int flags[7] = {0, 0, 0, 0, 0, 0, 1};
+		unsigned long nb_chunks, manifest_size;
+		read(magic, pos, 8);
+		if (memcmp(magic, INDEX_FILE_MAGIC, 8) != 0) {
+			error("not an index file");
+		}
+		read(&version, pos, sizeof(version));
+		read(&hash_version, pos, sizeof(hash_version));
+		if (version < 1 || version > INDEX_FILE_VERSION || hash_version != INDEX_HASH_VERSION) {
+			error("built by another version of build_index");
+		}
+		read(flags, pos, (version == 1 ? 4 : version == 2 ? 6 : 7) * sizeof(int));
+		max_fpr = 0;
+		if (version >= 3) {
+			read(&max_fpr, pos, sizeof(max_fpr));
+		}
+		kmer_size = flags[0];
+		index_type = flags[1];
+		canonical = flags[2] != 0;
+		minimizer_size = flags[3];
+		sampling.window = flags[4];
+		sampling.syncmer_size = flags[5];
+		min_count = flags[6];
+		if (kmer_size < 1 || kmer_size > MAX_KMER_SIZE || index_type < CLASSIC_INDEX || index_type > EXACT_INDEX || minimizer_size < 0 || minimizer_size > kmer_size || sampling.window < 0 || sampling.syncmer_size < 0 || sampling.syncmer_size >= kmer_size || min_count < 0) {
+			error("unknown index parameters");
+		}
+		read(&nb_chunks, pos, sizeof(nb_chunks));
+		read(&manifest_size, pos, sizeof(manifest_size));
+		if (pos + manifest_size > mapping_size) {
+			error("truncated file");
+		}
+		std::string manifest (mapping + pos, manifest_size);
+		pos += manifest_size;
+		size_t line_end = manifest.find('\n');
+		nickname = manifest.substr(0, line_end);
+		while (line_end != std::string::npos && line_end + 1 < manifest.size()) {
+			const size_t line_start = line_end + 1;
+			line_end = manifest.find('\n', line_start);
+			sources.push_back(manifest.substr(line_start, line_end - line_start));
+		}
+		
+		// Chunks
+		nb_indexed_reads = 0;
+		for (unsigned long chunk = 0; chunk < nb_chunks; chunk++) {
+			unsigned long size, nb_reads;
+			read(&size, pos, sizeof(size));
+			read(&nb_reads, pos, sizeof(nb_reads));
+			pos = index_file_align(pos);
+			if (size != index_size(index_type, kmer_size, size) || pos + size > mapping_size) {
+				error("invalid chunk");
+			}
+			chunk_pos.push_back(pos);
+			chunk_sizes.push_back(size);
+			chunk_nb_reads.push_back(nb_reads);
+			nb_indexed_reads += nb_reads;
+			pos += size;
+		}
+	}
+	
+	~IndexFile ()
+	{
+		munmap((void *) mapping, mapping_size);
+	}
+	
+	const int & get_kmer_size () const {return kmer_size;}
+	const int & get_index_type () const {return index_type;}
+	const bool & is_canonical () const {return canonical;}
+	const int & get_minimizer_size () const {return minimizer_size;}
+	bool is_partitioned () const {return minimizer_size > 0;}
+	const KmerSampling & get_sampling () const {return sampling;}
+	// Version of the file format, the files of older versions do not give
+	// min_count and max_fpr (read as 1 and 0)
+	const unsigned int & get_version () const {return version;}
+	const int & get_min_count () const {return min_count;}
+	const double & get_max_fpr () const {return max_fpr;}
+	const std::string & get_nickname () const {return nickname;}
+	const std::vector<std::string> & get_sources () const {return sources;}
+	unsigned long get_nb_chunks () const {return chunk_pos.size();}
+	const unsigned long & get_nb_indexed_reads () const {return nb_indexed_reads;}
+	const unsigned long & get_chunk_size (const unsigned long & chunk) const {return chunk_sizes[chunk];}
+	
+	// Return the index of the given chunk and add its number of reads to
+	// nb_indexed_reads, as index_reads does
+	BloomFilter * get_chunk (const unsigned long & chunk, unsigned long & nb_reads) const
+	{
+		// Read ahead the chunk only, which starts on a page (INDEX_FILE_ALIGN)
+		madvise((void *) (mapping + chunk_pos[chunk]), chunk_sizes[chunk], MADV_WILLNEED);
+		BloomFilter * index = new_index(index_type, kmer_size, chunk_sizes[chunk], mapping + chunk_pos[chunk]);
+		index->set_canonical(canonical);
+		nb_reads += chunk_nb_reads[chunk];
+		return index;
+	}
+};
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDEX_MEMORY_H_
+#define INDEX_MEMORY_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Filters of at least this size are mapped in huge pages (2 MB)
+#define HUGE_PAGE_SIZE (1UL << 21)
+// Filters of at least this size may use 1 GB pages
+#define GIGA_PAGE_SIZE (1UL << 30)
+// Alignment of the filters smaller than a huge page (a cache line)
+#define SMALL_PAGE_ALIGN 64
+// Policy of mbind (see numaif.h), given here to avoid a dependency on libnuma
+#define INDEX_MPOL_INTERLEAVE 3
+// Maximal number of NUMA nodes interleaved
+#define INDEX_MAX_NODES 64
+
+/*
+ * Kinds of memory given to the filters, from the best to the worst for
+ * random probes (see IndexMemory)
+ */
+enum IndexMemoryPath
+{
+	GIGA_PAGES,        // 1 GB pages reserved by the system (MAP_HUGETLB)
+	HUGE_PAGES,        // 2 MB pages reserved by the system (MAP_HUGETLB)
+	TRANSPARENT_PAGES, // mapping advised as huge (transparent huge pages)
+	MAPPED_PAGES,      // mapping of 4 KB pages (transparent huge pages disabled)
+	SMALL_MEMORY,      // aligned malloc, for filters smaller than a huge page
+	NB_MEMORY_PATHS
+};
+
+/*
+ * IndexMemory is a singleton class (see alphabet.h) allocating the memory
+ * of the filters.
+ *
+ * A filter of several GB probed at random misses the TLB on nearly every
+ * probe with 4 KB pages: its pages are asked, in order, as 1 GB pages
+ * (filters of 1 GB or more), 2 MB pages reserved by the system, then as
+ * an aligned mapping advised for transparent huge pages. Each path falls
+ * back on the next one when the system refuses it. The memory is zeroed.
+ *
+ * With several threads on a machine with several NUMA nodes, the pages of
+ * the filters are interleaved over the nodes before they are touched, so
+ * that the threads of every node share the memory bandwidth of all the
+ * nodes, instead of all probing the node of the thread that fed the page.
+ * With one thread, pages stay on the node of their first touch.
+ *
+ * The statistics give the number of filters and of bytes of each path.
+ */
+class IndexMemory
+{
+public:
+	static IndexMemory * getInstance()
+	{
+		static IndexMemory theOnlyInstance;
+		return &theOnlyInstance;
+	}
+	
+	// Interleave the filters over the NUMA nodes if several threads use them
+	void set_nb_threads (const int & nb_threads) {interleave = nb_threads > 1 && nb_nodes > 1;}
+	
+	// Return size zeroed bytes aligned on a cache line,
+	// path is the kind of memory to give back to release
+	char * allocate (const unsigned long & size, int & path)
+	{
+		char * memory = NULL;
+		if (size >= GIGA_PAGE_SIZE) {
+			memory = map_huge(size, GIGA_PAGE_SIZE, 30);
+			path = GIGA_PAGES;
+		}
+		if (memory == NULL && size >= HUGE_PAGE_SIZE) {
+			memory = map_huge(size, HUGE_PAGE_SIZE, 21);
+			path = HUGE_PAGES;
+		}
+		if (memory == NULL && size >= HUGE_PAGE_SIZE) {
+			memory = map_transparent(size, path);
+		}
+		if (memory == NULL) {
+			path = SMALL_MEMORY;
+			if (posix_memalign((void **) &memory, SMALL_PAGE_ALIGN, size > 0 ? size : 1) != 0) {
+				return NULL;
+			}
+			memset(memory, 0, size);
+		}
+		nb_allocated[path]++;
+		allocated_size[path] += size;
+		return memory;
+	}
+	
+	// Free the memory given by allocate
+	void release (char * memory, const unsigned long & size, const int & path)
+	{
+		if (memory == NULL) {
+			return;
+		}
+		switch (path) {
+			case GIGA_PAGES:
+				munmap(memory, round_up(size, GIGA_PAGE_SIZE));
+				break;
+			case HUGE_PAGES:
+			case TRANSPARENT_PAGES:
+			case MAPPED_PAGES:
+				munmap(memory, round_up(size, HUGE_PAGE_SIZE));
+				break;
+			default:
+				free(memory);
+		}
+	}
+	
+	// One line of statistics, ie "64 MB in 2 MB pages (1 filter), 1 MB in small pages (3 filters)"
+	std::string get_stats () const
+	{
+		const char * names[NB_MEMORY_PATHS] = {"1 GB pages", "2 MB pages", "transparent huge pages", "4 KB pages", "small pages"};
+		std::ostringstream stats;
+		for (int path = 0; path < NB_MEMORY_PATHS; path++) {
+			if (nb_allocated[path] > 0) {
+				if (!stats.str().empty()) {
+					stats << ", ";
+				}
+				stats << float (allocated_size[path]) / (1024 * 1024) << " MB in " << names[path] << " (" << nb_allocated[path] << (nb_allocated[path] > 1 ? " filters)" : " filter)");
+			}
+		}
+		if (stats.str().empty()) {
+			stats << "none";
+		}
+		if (interleave) {
+			stats << ", interleaved over " << nb_nodes << " NUMA nodes";
+		}
+		return stats.str();
+	}
+	
+private:
+	int nb_nodes;
+	unsigned long node_mask[INDEX_MAX_NODES / 64];
+	bool interleave;
+	unsigned long nb_allocated[NB_MEMORY_PATHS];
+	unsigned long allocated_size[NB_MEMORY_PATHS];
+	
+	IndexMemory()
+	{
+		interleave = false;
+		for (int path = 0; path < NB_MEMORY_PATHS; path++) {
+			nb_allocated[path] = 0;
+			allocated_size[path] = 0;
+		}
+		read_nodes();
+	}
+	~IndexMemory() {};
+	
+	static unsigned long round_up (const unsigned long & size, const unsigned long & page_size)
+	{
+		return (size + page_size - 1) / page_size * page_size;
+	}
+	
+	// Read the online NUMA nodes, ie "0-1" or "0,2-3"
+	void read_nodes ()
+	{
+		nb_nodes = 0;
+		memset(node_mask, 0, sizeof(node_mask));
+		std::ifstream online ("/sys/devices/system/node/online");
+		std::string range;
+		while (online.good() && getline(online, range, ',')) {
+			int first = 0, last = -1;
+			if (sscanf(range.c_str(), "%d-%d", &first, &last) < 2) {
+				last = first;
+			}
+			for (int node = first; node <= last && node < INDEX_MAX_NODES; node++) {
+				node_mask[node / 64] |= 1UL << (node % 64);
+				nb_nodes++;
+			}
+		}
+	}
+	
+	// Ask the kernel to interleave the pages of the mapping over the nodes
+	// (before the first touch, so that no page is moved)
+	void interleave_pages (char * memory, const unsigned long & size) const
+	{
+#ifdef SYS_mbind
+		if (interleave) {
+			syscall(SYS_mbind, memory, size, INDEX_MPOL_INTERLEAVE, node_mask, INDEX_MAX_NODES + 1, 0);
+		}
+#endif
+	}
+	
+	// Mapping of pages reserved by the system (page_size = 1 << page_shift)
+	// NULL if none is available
+	char * map_huge (const unsigned long & size, const unsigned long & page_size, const int & page_shift) const
+	{
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+		const unsigned long mapped_size = round_up(size, page_size);
+		void * memory = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (page_shift << MAP_HUGE_SHIFT), -1, 0);
+		if (memory == MAP_FAILED) {
+			return NULL;
+		}
+		interleave_pages((char *) memory, mapped_size);
+		return (char *) memory;
+#else
+		return NULL;
+#endif
+	}
+	
+	// Mapping aligned on HUGE_PAGE_SIZE, so that the kernel can back it
+	// with transparent huge pages. path is MAPPED_PAGES if it refuses them
+	char * map_transparent (const unsigned long & size, int & path) const
+	{
+		const unsigned long mapped_size = round_up(size, HUGE_PAGE_SIZE);
+		char * memory = (char *) mmap(NULL, mapped_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) {
+			return NULL;
+		}
+		// Unmap the pages before and after the aligned mapping
+		const unsigned long head = (HUGE_PAGE_SIZE - (unsigned long) memory % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+		if (head > 0) {
+			munmap(memory, head);
+		}
+		munmap(memory + head + mapped_size, HUGE_PAGE_SIZE - head);
+		memory += head;
+		path = MAPPED_PAGES;
+#ifdef MADV_HUGEPAGE
+		if (madvise(memory, mapped_size, MADV_HUGEPAGE) == 0) {
+			path = TRANSPARENT_PAGES;
+		}
+#endif
+		interleave_pages(memory, mapped_size);
+		return memory;
+	}
+};
+
+#endif
@@ -28,37 +28,360 @@
 #define INDEX_READS_H_
 
 #include "bloom_filter.h"
+#include "index_type.h"
+#include "kmer_counter.h"
+#include "kmer_sampler.h"
+#include "kmer_keys.h"
 #include "file_manager.h"
 #include "alphabet.h"
 
-/* index_reads returns a bloom filter of indexed reads from the given file_manager.
+#include <pthread.h>
+#include <climits>
+#include <vector>
+
+// Number of reads given at once to an indexing thread
+#define INDEX_BATCH_SIZE 4096
+// With a target false positive rate, number of estimations of the rate
+// while max_kmer k-mers are fed, minimal number of k-mers fed between two
+// of them, and number of lines of 64 bytes of the filter read by each
+#define INDEX_FPR_CHECKS 64
+#define INDEX_FPR_MIN_INTERVAL (1UL << 14)
+#define INDEX_FPR_SAMPLE_LINES (1UL << 14)
+
+/* ChunkLimit tells when a chunk of the index is full: once max_kmer k-mers
+ * are fed, or with a target false positive rate (option -e), once the
+ * estimated rate of the filter reaches it. The rate is then estimated every
+ * max_kmer / INDEX_FPR_CHECKS fed k-mers, on INDEX_FPR_SAMPLE_LINES lines of
+ * the filter or on a sample of random k-mers for the classic filter (see
+ * BloomFilter::get_fpr), and max_kmer does not stop the chunk. The other
+ * indexing threads may be feeding the filter meanwhile: given a step, the
+ * filter reads its bits with atomic loads. The exact index has no false
+ * positive and always stops at max_kmer.
+ */
+class ChunkLimit
+{
+private:
+	const BloomFilter * bloom_filter;
+	unsigned long max_kmer;
+	double max_fpr;
+	unsigned long step;
+	unsigned long check_interval;
+	unsigned long next_check;
+	bool full;
+	
+public:
+	ChunkLimit (const BloomFilter * bloom_filter, const unsigned long & max_kmer, const double & max_fpr)
+	{
+		this->bloom_filter = bloom_filter;
+		this->max_kmer = max_kmer;
+		this->max_fpr = bloom_filter->get_type() == EXACT_INDEX ? 0 : max_fpr;
+		step = std::max(1UL, bloom_filter->get_size() / 64 / INDEX_FPR_SAMPLE_LINES);
+		check_interval = std::max(max_kmer / INDEX_FPR_CHECKS, INDEX_FPR_MIN_INTERVAL);
+		next_check = check_interval;
+		full = false;
+	}
+	
+	bool is_full (const unsigned long & nb_indexed_kmers)
+	{
+		if (max_fpr <= 0) {
+			return nb_indexed_kmers >= max_kmer;
+		}
+		if (!full && nb_indexed_kmers >= next_check) {
+			full = bloom_filter->get_fpr(step) >= max_fpr;
+			next_check = nb_indexed_kmers + check_interval;
+		}
+		return full;
+	}
+	
+	// Number of k-mers of a batch of reads taken by one of nb_threads
+	// indexing threads: the k-mers taken but not yet fed are not seen by
+	// the estimated false positive rate, so they are kept to about one
+	// check interval in all
+	unsigned long get_batch_kmers (const int & nb_threads) const
+	{
+		if (max_fpr <= 0) {
+			return ULONG_MAX;
+		}
+		return std::max(check_interval / nb_threads, 1UL);
+	}
+};
+
+/* count_kmers returns the number of k-mers of a read that are fed in the
+ * bloom filter, ie the number of positions preceded by kmer_size - 1
+ * valid nucleotides.
+ */
+unsigned long count_kmers (const std::string & read, const int & kmer_size)
+{
+	const unsigned char * codes = Alphabet::getInstance()->get_codes();
+	unsigned long nb_kmers = 0;
+	int nb_valid = 0;
+	for (int i = 0; i < (int) read.size(); i++) {
+		nb_valid = (nb_valid + 1) & (int) Alphabet::valid_mask(codes[(unsigned char) read[i]]);
+		nb_kmers += nb_valid >= kmer_size;
+	}
+	return nb_kmers;
+}
+
+/* feed_kmer feeds the bloom filter with a k-mer of a read and returns 1
+ * if it counts as fed, 0 if not.
+ * With a counter, only the solid k-mers are fed (see kmer_counter.h), and
+ * only the ones new to the filter are counted (all of them in the exact
+ * index, see feed_new).
  *
- * it also update the number of indexed reads because it may stop if the number of kmer is too high
+ * Filter is the real class of the bloom filter: the qualified calls
+ * bloom_filter->Filter::feed are not virtual and can be inlined.
+ */
+template <class Filter>
+unsigned long feed_kmer (Filter * bloom_filter, const HashKey & key, const bool & atomic, KmerCounter * counter)
+{
+	if (counter == NULL) {
+		if (atomic) {
+			bloom_filter->Filter::feed_atomic(key);
+		} else {
+			bloom_filter->Filter::feed(key);
+		}
+		return 1;
+	}
+	if (counter->add(key, atomic) < counter->get_min_count()) {
+		return 0;
+	}
+	// A solid k-mer is fed at each occurrence, but a bloom filter
+	// only grows once: its count may already be above min_count the
+	// first time, so the filter tells if the k-mer is new
+	return bloom_filter->Filter::feed_new(key, atomic) ? 1 : 0;
+}
+
+/* feed_read feeds the bloom filter with the k-mers of a read
+ * and returns the number of fed k-mers (see feed_kmer).
+ * With sampled positions (see kmer_sampler.h), only the sampled k-mers are
+ * fed.
+ * Key gives the key of each k-mer (see hash_key.h).
+ */
+template <class Filter, class Key>
+unsigned long feed_read (Filter * bloom_filter, Key hash, const std::string & read, const int & kmer_size, const bool & atomic, KmerCounter * counter, const char * sampled)
+{
+	const int size = Key::size(kmer_size);
+	unsigned long nb_kmers = 0;
+	hash.clear();
+	for (int i = 0; i < (int) read.size(); i++) {
+		// add() clears the key on a char that is not a nucleotide
+		if (hash.add(read[i]) >= size && (sampled == NULL || sampled[i])) {
+			nb_kmers += feed_kmer(bloom_filter, hash.key(), atomic, counter);
+		}
+	}
+	return nb_kmers;
+}
+
+/* feed_read_keys is feed_read with the keys of the whole read computed at
+ * once in read_keys, used for the canonical k-mers (see KmerKeys).
+ */
+template <class Filter>
+unsigned long feed_read_keys (Filter * bloom_filter, HashKey & hash, ReadKeys & read_keys, const std::string & read, const bool & atomic, KmerCounter * counter, const char * sampled)
+{
+	get_read_keys(read_keys, read, true, sampled);
+	const std::vector<unsigned long> & keys = read_keys.forward;
+	unsigned long nb_kmers = 0;
+	for (size_t j = 0; j < read_keys.forward_pos.size(); j++) {
+		hash.set(keys[2 * j], keys[2 * j + 1]);
+		nb_kmers += feed_kmer(bloom_filter, hash, atomic, counter);
+	}
+	return nb_kmers;
+}
+
+// The loops compiled for the usual sizes of k-mers (see ForwardKey)
+// A canonical bloom filter is fed with the keys of the whole read
+template <class Filter>
+unsigned long feed_read (Filter * bloom_filter, HashKey & hash, ReadKeys & read_keys, const std::string & read, const int & kmer_size, const bool & atomic, KmerCounter * counter, const char * sampled)
+{
+	if (bloom_filter->is_canonical()) {
+		return feed_read_keys(bloom_filter, hash, read_keys, read, atomic, counter, sampled);
+	}
+	switch (kmer_size) {
+		case 21: return feed_read(bloom_filter, ForwardKey<21>(hash), read, kmer_size, atomic, counter, sampled);
+		case 25: return feed_read(bloom_filter, ForwardKey<25>(hash), read, kmer_size, atomic, counter, sampled);
+		case 27: return feed_read(bloom_filter, ForwardKey<27>(hash), read, kmer_size, atomic, counter, sampled);
+		case 31: return feed_read(bloom_filter, ForwardKey<31>(hash), read, kmer_size, atomic, counter, sampled);
+		case 33: return feed_read(bloom_filter, ForwardKey<33>(hash), read, kmer_size, atomic, counter, sampled);
+	}
+	return feed_read(bloom_filter, ForwardKey<>(hash), read, kmer_size, atomic, counter, sampled);
+}
+
+// read_keys is only used by a canonical bloom filter
+// sampler, if given, chooses the k-mers to feed
+unsigned long feed_read (BloomFilter * bloom_filter, HashKey & hash, ReadKeys & read_keys, const std::string & read, const int & kmer_size, const bool & atomic, KmerCounter * counter = NULL, KmerSampler * sampler = NULL)
+{
+	const char * sampled = sampler != NULL ? sampler->sample(read) : NULL;
+	if (bloom_filter->get_type() == BLOCKED_INDEX) {
+		return feed_read((BlockedBloomFilter *) bloom_filter, hash, read_keys, read, kmer_size, atomic, counter, sampled);
+	} else if (bloom_filter->get_type() == HASHED_INDEX) {
+		return feed_read((HashedBloomFilter *) bloom_filter, hash, read_keys, read, kmer_size, atomic, counter, sampled);
+	} else if (bloom_filter->get_type() == EXACT_INDEX) {
+		return feed_read((ExactIndex *) bloom_filter, hash, read_keys, read, kmer_size, atomic, counter, sampled);
+	} else if (bloom_filter->get_type() == SLICED_INDEX) {
+		return feed_read((SlicedBloomFilter *) bloom_filter, hash, read_keys, read, kmer_size, atomic, counter, sampled);
+	}
+	return feed_read<BloomFilter>(bloom_filter, hash, read_keys, read, kmer_size, atomic, counter, sampled);
+}
+
+/* Data shared by the indexing threads.
+ * Everything but the bloom filter is protected by the mutex.
+ */
+struct IndexThreadData
+{
+	FileManager * file_manager;
+	BloomFilter * bloom_filter;
+	int kmer_size;
+	ChunkLimit * limit;
+	unsigned long batch_kmers;
+	KmerCounter * counter;
+	KmerSampling sampling;
+	pthread_mutex_t mutex;
+	std::string * current_read;
+	unsigned long nb_indexed_kmers;
+	unsigned long * nb_indexed_reads;
+};
+
+/* index_reads_thread is run by each indexing thread.
+ *
+ * Under the mutex, the thread takes a batch of reads from the file manager,
+ * counting their k-mers so that the chunk stops on exactly the same read as
+ * the sequential version. Then it feeds the bloom filter with atomic 'or'.
+ *
+ * With a counter or a sampling, the number of fed k-mers is only known once
+ * a batch is fed: it is added to the total when the thread takes its next
+ * batch.
+ *
+ * With a target false positive rate, a batch also stops after
+ * data->batch_kmers k-mers (see ChunkLimit::get_batch_kmers).
+ */
+void * index_reads_thread (void * arg)
+{
+	IndexThreadData * data = (IndexThreadData *) arg;
+	HashKey hash (data->kmer_size);
+	ReadKeys read_keys (data->kmer_size);
+	KmerSampler sampler (data->kmer_size, data->sampling);
+	const bool count_fed_kmers = data->counter != NULL || data->sampling.is_active();
+	std::vector<std::string> batch (INDEX_BATCH_SIZE);
+	unsigned long nb_fed_kmers = 0;
+	while (true) {
+		int batch_size = 0;
+		unsigned long batch_kmers = 0;
+		pthread_mutex_lock(&data->mutex);
+		data->nb_indexed_kmers += nb_fed_kmers;
+		while (batch_size < INDEX_BATCH_SIZE && batch_kmers < data->batch_kmers && !data->current_read->empty() && !data->limit->is_full(data->nb_indexed_kmers)) {
+			(*data->nb_indexed_reads)++;
+			if (!count_fed_kmers || data->batch_kmers < ULONG_MAX) {
+				const unsigned long nb_kmers = count_kmers(*data->current_read, data->kmer_size);
+				batch_kmers += nb_kmers;
+				if (!count_fed_kmers) {
+					data->nb_indexed_kmers += nb_kmers;
+				}
+			}
+			batch[batch_size].swap(*data->current_read);
+			batch_size++;
+			*data->current_read = data->file_manager->get_next_read_to_compare();
+		}
+		pthread_mutex_unlock(&data->mutex);
+		if (batch_size == 0) {
+			break;
+		}
+		nb_fed_kmers = 0;
+		for (int read_pos = 0; read_pos < batch_size; read_pos++) {
+			const unsigned long nb_kmers = feed_read(data->bloom_filter, hash, read_keys, batch[read_pos], data->kmer_size, true, data->counter, &sampler);
+			if (count_fed_kmers) {
+				nb_fed_kmers += nb_kmers;
+			}
+		}
+	}
+	return NULL;
+}
+
+/* index_reads_into feeds the given bloom filter with reads from the given
+ * file_manager, until max_kmer k-mers are fed, and updates the number of
+ * indexed reads. The bloom filter is not finalized.
  *
  * For each read, calculate the hash for each k-mer and feed the bloom filter
  * If an N is found, then reinit hash and continue.
+ *
+ * With nb_threads > 1, reads are indexed by batches in several threads.
+ * The resulting bloom filter is the same as with a single thread.
+ *
+ * With min_count > 1, only the k-mers seen at least min_count times in the
+ * chunk are indexed, and only them count in max_kmer, once each. The k-mers
+ * are then counted in a count-min sketch of 4 bytes per k-mer of max_kmer.
+ * With several threads, the chunk may then stop a few reads further than
+ * with one thread.
+ *
+ * With a sampling, only the sampled k-mers are indexed, and only them
+ * count in max_kmer (see kmer_sampler.h).
+ *
+ * With max_fpr > 0, the chunk stops once the estimated false positive rate
+ * of the filter reaches max_fpr instead of after max_kmer k-mers (see
+ * ChunkLimit). With several threads, it may then stop a few batches of
+ * reads further than with one thread.
  */
-BloomFilter * index_reads (FileManager * index_file_manager, const int & kmer_size, const int & min_hits, const unsigned long & max_kmer, unsigned long & nb_indexed_reads)
+void index_reads_into (BloomFilter * bloom_filter, FileManager * index_file_manager, const int & kmer_size, const unsigned long & max_kmer, unsigned long & nb_indexed_reads, const int & nb_threads = 1, const int & min_count = 1, const KmerSampling & sampling = KmerSampling (), const double & max_fpr = 0)
 {
 	unsigned long nb_indexed_kmers = 0;
-	BloomFilter * bloom_filter = new BloomFilter (kmer_size);
+	ChunkLimit limit (bloom_filter, max_kmer, max_fpr);
 	HashKey hash (kmer_size);
-	Alphabet * alphabet = Alphabet::getInstance();
+	ReadKeys read_keys (kmer_size);
+	KmerCounter * counter = NULL;
+	if (min_count > 1) {
+		counter = new KmerCounter (max_kmer, min_count);
+	}
+	KmerSampler sampler (kmer_size, sampling);
 	
 	std::string & current_read_to_index = index_file_manager->get_next_read_to_compare();
-	while (!current_read_to_index.empty() && nb_indexed_kmers < max_kmer) {
-		nb_indexed_reads++;
-		hash.clear();
-		for (int i = 0; i < (int) current_read_to_index.size(); i++) {
-			if (!alphabet->is_in(current_read_to_index[i])) {
-				hash.clear();
-			} else if (hash.add(current_read_to_index[i]) >= kmer_size) {
-				bloom_filter->feed(hash);
-				nb_indexed_kmers++;
+	if (nb_threads > 1) {
+		IndexThreadData data;
+		data.file_manager = index_file_manager;
+		data.bloom_filter = bloom_filter;
+		data.kmer_size = kmer_size;
+		data.limit = &limit;
+		data.batch_kmers = limit.get_batch_kmers(nb_threads);
+		data.counter = counter;
+		data.sampling = sampling;
+		pthread_mutex_init(&data.mutex, NULL);
+		data.current_read = &current_read_to_index;
+		data.nb_indexed_kmers = 0;
+		data.nb_indexed_reads = &nb_indexed_reads;
+		std::vector<pthread_t> threads (nb_threads);
+		for (int i = 0; i < nb_threads; i++) {
+			if (pthread_create(&threads[i], NULL, index_reads_thread, &data) != 0) {
+				std::cerr << "Cannot create indexing thread -> exit\n";
+				exit(1);
 			}
 		}
-		current_read_to_index = index_file_manager->get_next_read_to_compare();
+		for (int i = 0; i < nb_threads; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		pthread_mutex_destroy(&data.mutex);
+	} else {
+		while (!current_read_to_index.empty() && !limit.is_full(nb_indexed_kmers)) {
+			nb_indexed_reads++;
+			nb_indexed_kmers += feed_read(bloom_filter, hash, read_keys, current_read_to_index, kmer_size, false, counter, &sampler);
+			current_read_to_index = index_file_manager->get_next_read_to_compare();
+		}
 	}
+	delete counter;
+}
+
+/* index_reads returns a bloom filter of indexed reads from the given file_manager.
+ *
+ * it also update the number of indexed reads because it may stop if the number of kmer is too high
+ * (see index_reads_into).
+ *
+ * index_type gives the kind of bloom filter to build and index_memory its
+ * memory budget in bytes, 0 for the default size (see index_type.h).
+ * A canonical bloom filter contains the canonical k-mers of the reads.
+ */
+BloomFilter * index_reads (FileManager * index_file_manager, const int & kmer_size, const int & min_hits, const unsigned long & max_kmer, unsigned long & nb_indexed_reads, const int & nb_threads = 1, const int & index_type = CLASSIC_INDEX, const unsigned long & index_memory = 0, const bool & canonical = false, const int & min_count = 1, const KmerSampling & sampling = KmerSampling (), const double & max_fpr = 0)
+{
+	BloomFilter * bloom_filter = new_index (index_type, kmer_size, index_memory);
+	bloom_filter->set_canonical(canonical);
+	index_reads_into(bloom_filter, index_file_manager, kmer_size, max_kmer, nb_indexed_reads, nb_threads, min_count, sampling, max_fpr);
+	bloom_filter->finalize();
 	return bloom_filter;
 }
 
@@ -0,0 +1,201 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INDEX_TYPE_H_
+#define INDEX_TYPE_H_
+
+#include "bloom_filter.h"
+#include "blocked_bloom_filter.h"
+#include "hashed_bloom_filter.h"
+#include "exact_index.h"
+#include "sliced_bloom_filter.h"
+
+#include <string>
+#include <sstream>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ * Types of index that can be built from the reads (option -x)
+ *   classic : the 4 keys of a k-mer address 4 bits anywhere in the filter
+ *   blocked : the 4 bits of a k-mer are in the same 64 bytes block
+ *   hashed  : the 4 bits of a k-mer are hashed anywhere in the filter
+ *   exact   : sorted and compressed set of the k-mers, no false positive
+ *   sliced  : one hashed filter per indexed set, interleaved bit by bit,
+ *             only for several indexed sets at once (colored search)
+ *
+ * The classic filter has 2^(k-1) bytes. The blocked and hashed filters may
+ * be given a memory budget (option -m) so that k is chosen independently
+ * of the memory. For the exact index, the budget (2^(k-1) bytes by
+ * default) bounds the memory used while its k-mers are fed.
+ */
+
+// Maximal size of k-mers: the 2 bits of each nucleotide are stored in
+// keya and keyb, which hold at most 63 nucleotides
+#define MAX_KMER_SIZE 63
+
+// Return the index type of the given name, or -1 if unknown
+int parse_index_type (const std::string & name)
+{
+	if (name.compare("classic") == 0) {
+		return CLASSIC_INDEX;
+	} else if (name.compare("blocked") == 0) {
+		return BLOCKED_INDEX;
+	} else if (name.compare("hashed") == 0) {
+		return HASHED_INDEX;
+	} else if (name.compare("exact") == 0) {
+		return EXACT_INDEX;
+	} else if (name.compare("sliced") == 0) {
+		return SLICED_INDEX;
+	}
+	return -1;
+}
+
+// Return the number of bytes of a memory size, given as a number of bytes
+// optionally followed by K, M or G (ie 512M, 2G), or 0 if not valid
+unsigned long parse_memory (const std::string & memory)
+{
+	char * end;
+	double size = strtod(memory.c_str(), &end);
+	std::string unit (end);
+	if (unit.compare("K") == 0 || unit.compare("k") == 0) {
+		size *= 1024.0;
+	} else if (unit.compare("M") == 0 || unit.compare("m") == 0) {
+		size *= 1024.0 * 1024.0;
+	} else if (unit.compare("G") == 0 || unit.compare("g") == 0) {
+		size *= 1024.0 * 1024.0 * 1024.0;
+	} else if (!unit.empty()) {
+		return 0;
+	}
+	if (size < BLOOM_BLOCK_SIZE) {
+		return 0;
+	}
+	return (unsigned long) size;
+}
+
+// Return the size in bytes of the index of the given type
+// memory is the budget given with -m, or 0 for the default size
+unsigned long index_size (const int & index_type, const int & kmer_size, const unsigned long & memory)
+{
+	if (memory == 0 || index_type == CLASSIC_INDEX) {
+		return (unsigned long) pow (2, kmer_size - 1);
+	}
+	if (index_type == BLOCKED_INDEX) {
+		unsigned long size = BLOOM_BLOCK_SIZE;
+		while (size * 2 <= memory) {
+			size *= 2;
+		}
+		return size;
+	}
+	return memory;
+}
+
+// Return the maximal number of k-mers indexed at once in an index of
+// the given size in bytes, ie 1e9 k-mers for 4 GB as with k = 33
+// The exact index stores each fed k-mer on 16 bytes before compressing
+unsigned long index_max_kmer (const int & index_type, const unsigned long & size)
+{
+	if (index_type == EXACT_INDEX) {
+		return size / 16;
+	}
+	return (unsigned long) (size * (1000000000.0 / pow (2, 32)));
+}
+
+// Return a new empty index of the given type
+// memory is the budget given with -m, or 0 for the default size
+// vector, if given, is the content of the index (see index_file.h)
+BloomFilter * new_index (const int & index_type, const int & kmer_size, const unsigned long & memory = 0, const char * vector = NULL)
+{
+	if (index_type == BLOCKED_INDEX) {
+		return new BlockedBloomFilter (kmer_size, index_size(index_type, kmer_size, memory), vector);
+	} else if (index_type == HASHED_INDEX) {
+		return new HashedBloomFilter (kmer_size, index_size(index_type, kmer_size, memory), vector);
+	} else if (index_type == EXACT_INDEX) {
+		return new ExactIndex (kmer_size, index_size(index_type, kmer_size, memory), vector);
+	}
+	return new BloomFilter (kmer_size, vector);
+}
+
+// Return a new empty bit-sliced index of nb_colors colors
+// memory is the budget of the whole index, or 0 for the memory of one
+// classic index per color (2^(k-1) bytes per color)
+SlicedBloomFilter * new_sliced_index (const int & kmer_size, const int & nb_colors, const unsigned long & memory = 0)
+{
+	if (memory == 0) {
+		return new SlicedBloomFilter (nb_colors, (unsigned long) pow (2, kmer_size - 1) * nb_colors);
+	}
+	return new SlicedBloomFilter (nb_colors, memory);
+}
+
+/*
+ * IndexFill keeps the fill of the fullest chunk of an index: the fraction
+ * of its bits that are set and its estimated false positive rate (see
+ * BloomFilter::get_fpr), written with the index timings
+ */
+class IndexFill
+{
+private:
+	double occupancy;
+	double fpr;
+	unsigned long nb_chunks;
+	bool exact;
+	
+public:
+	IndexFill () : occupancy (0), fpr (0), nb_chunks (0), exact (false) {}
+	
+	// Read the bits of a chunk of the index
+	void add (const BloomFilter * index)
+	{
+		exact = index->get_type() == EXACT_INDEX;
+		const double chunk_fpr = index->get_fpr();
+		if (nb_chunks == 0 || chunk_fpr > fpr) {
+			fpr = chunk_fpr;
+			occupancy = exact ? 0 : index->get_occupancy();
+		}
+		nb_chunks++;
+	}
+	
+	const double & get_fpr () const {return fpr;}
+	
+	// ie "12.5% of the bits set, estimated FPR 0.00024 (fullest of 3 chunks)"
+	std::string get_stats () const
+	{
+		std::ostringstream stats;
+		if (nb_chunks == 0) {
+			stats << "no index";
+		} else if (exact) {
+			stats << "exact index, no false positive";
+		} else {
+			stats << 100 * occupancy << "% of the bits set, estimated FPR " << fpr;
+			if (nb_chunks > 1) {
+				stats << " (fullest of " << nb_chunks << " chunks)";
+			}
+		}
+		return stats.str();
+	}
+};
+
+#endif
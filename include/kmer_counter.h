@@ -0,0 +1,147 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KMER_COUNTER_H_
+#define KMER_COUNTER_H_
+
+#include "hash_key.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Number of counters of a k-mer
+#define COUNTER_NB_HASHES 4
+// Number of counters per k-mer that can be indexed in a chunk
+#define COUNTER_PER_KMER 4
+// Maximal count of a k-mer (counters of 8 bits)
+#define COUNTER_MAX 255
+
+/*
+ * Count-min sketch of the k-mers fed in an index (option -a)
+ *
+ * Each k-mer has 4 counters of 8 bits, given by its mixed key as the bits
+ * of a hashed bloom filter. Its count is the minimum of its counters: it
+ * may be overestimated, never underestimated. Only the smallest counters
+ * are incremented (conservative update), which keeps the overestimation
+ * of rare k-mers low.
+ *
+ * A k-mer is solid once it has been seen min_count times. Sequencing
+ * errors create k-mers seen once or twice: they are not fed in the index.
+ */
+class KmerCounter
+{
+private:
+	unsigned char * counters;
+	unsigned long nb_counters;
+	int min_count;
+	
+	unsigned long counter_pos (const unsigned long & key, const int & i) const
+	{
+		const unsigned long step = ((key << 32) | (key >> 32)) | 1;
+		return (unsigned long) (((unsigned __int128) (key + i * step) * nb_counters) >> 64);
+	}
+	
+public:
+	// max_kmer is the number of k-mers indexed at once (see index_type.h)
+	KmerCounter (const unsigned long & max_kmer, const int & min_count)
+	{
+		nb_counters = COUNTER_PER_KMER * max_kmer + 1;
+		this->min_count = min_count;
+		counters = (unsigned char *) calloc(nb_counters, sizeof(unsigned char));
+		if (counters == NULL) {
+			fprintf(stderr, "K-mer counter allocation impossible, try with a lower memory budget (-m) or with more RAM memory\n");
+			exit(1);
+		}
+	}
+	
+	~KmerCounter ()
+	{
+		free(counters);
+	}
+	
+	// Size in bytes of the counters
+	unsigned long get_size () const {return nb_counters;}
+	
+	const int & get_min_count () const {return min_count;}
+	
+	/* add counts one more occurrence of the k-mer and returns its count,
+	 * the k-mer is solid if the count is at least min_count.
+	 *
+	 * With atomic, the counters at the minimum are incremented rather than
+	 * set to the minimum plus one, so that concurrent occurrences of a
+	 * k-mer are all counted, and the other counters are then raised to the
+	 * count. Concurrent occurrences may return the same count, and the
+	 * last one returns at least the count of all of them.
+	 */
+	int add (const HashKey & hash_key, const bool & atomic)
+	{
+		const unsigned long key = hash_key.mixed_key();
+		unsigned long pos[COUNTER_NB_HASHES];
+		unsigned char current[COUNTER_NB_HASHES];
+		unsigned char count = COUNTER_MAX;
+		for (int i = 0; i < COUNTER_NB_HASHES; i++) {
+			pos[i] = counter_pos(key, i);
+			current[i] = atomic ? __atomic_load_n(&counters[pos[i]], __ATOMIC_RELAXED) : counters[pos[i]];
+			if (current[i] < count) {
+				count = current[i];
+			}
+		}
+		if (count == COUNTER_MAX) {
+			return count;
+		}
+		if (!atomic) {
+			for (int i = 0; i < COUNTER_NB_HASHES; i++) {
+				if (current[i] == count) {
+					counters[pos[i]]++;
+				}
+			}
+			return count + 1;
+		}
+		// Increment the counters at the minimum, up to COUNTER_MAX: the
+		// count is the largest of their new values
+		unsigned char new_count = count + 1;
+		for (int i = 0; i < COUNTER_NB_HASHES; i++) {
+			if (current[i] != count) {
+				continue;
+			}
+			unsigned char value = current[i];
+			while (value < COUNTER_MAX && !__atomic_compare_exchange_n(&counters[pos[i]], &value, value + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+			if (value == COUNTER_MAX) {
+				new_count = COUNTER_MAX;
+			} else if (value + 1 > new_count) {
+				new_count = value + 1;
+			}
+		}
+		// Raise the other counters to the count
+		for (int i = 0; i < COUNTER_NB_HASHES; i++) {
+			unsigned char value = __atomic_load_n(&counters[pos[i]], __ATOMIC_RELAXED);
+			while (value < new_count && !__atomic_compare_exchange_n(&counters[pos[i]], &value, new_count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+		}
+		return new_count;
+	}
+};
+
+#endif
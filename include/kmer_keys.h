@@ -0,0 +1,293 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KMER_KEYS_H_
+#define KMER_KEYS_H_
+
+#include "hash_key.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// 4 keys computed at once, a shift count per key
+typedef unsigned long key_vector_t __attribute__ ((vector_size (32)));
+
+// The key loops are compiled for AVX2 (4 keys per instruction, with its
+// shifts of a count per key) and for the default target, where the
+// vectors are split in scalar operations. The version of the processor is
+// chosen when the program starts (GCC function multiversioning). Other
+// processors only get the default version.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define KMER_KEYS_TARGETS __attribute__ ((target_clones ("avx2", "default")))
+#else
+#define KMER_KEYS_TARGETS
+#endif
+
+// For the 8 bytes of x holding 0 or 1, the top byte of x * PACK_MSB_FIRST
+// holds the byte j of x in its bit 7 - j, and the top byte of
+// x * PACK_LSB_FIRST in its bit j: 8 nucleotides are packed at once
+#define PACK_MSB_FIRST 0x8040201008040201UL
+#define PACK_LSB_FIRST 0x0102040810204080UL
+#define PACK_BYTE_BITS 0x0101010101010101UL
+#define PACK_LOW_7_BITS 0x7f7f7f7f7f7f7f7fUL
+#define PACK_LOWER_CASE 0x2020202020202020UL
+
+/*
+ * Keys of the k-mers ending at the 64 positions of a word of nucleotides,
+ * for the forward strand (see HashKey::add).
+ *
+ * Each bit of the codes of the read is packed in words of 64 nucleotides,
+ * the first nucleotide of a word in its highest bit, after a first word
+ * that pads the beginning of the read. The k bits of the k-mer ending at
+ * position r of word w are then the bits ending at r of the words w - 1
+ * and w: every key is computed on its own, without the dependency from
+ * one nucleotide to the next of the rolling keys. The same for the word
+ * of the non nucleotides gives 0 for a k-mer of k nucleotides.
+ */
+KMER_KEYS_TARGETS
+void get_forward_keys (const unsigned long * high, const unsigned long * low, const unsigned long * invalid, const long nb_words, const unsigned long mask, unsigned long * __restrict__ keya, unsigned long * __restrict__ keyb, unsigned long * __restrict__ keyn)
+{
+	for (long w = 1; w <= nb_words; w++) {
+		const unsigned long high_0 = high[w - 1], high_1 = high[w];
+		const unsigned long low_0 = low[w - 1], low_1 = low[w];
+		const unsigned long invalid_0 = invalid[w - 1], invalid_1 = invalid[w];
+		key_vector_t r = {0, 1, 2, 3};
+		for (long pos = 64 * (w - 1); pos < 64 * w; pos += 4) {
+			const key_vector_t a = (((high_0 << r) << 1) | (high_1 >> (63 - r))) & mask;
+			const key_vector_t b = (((low_0 << r) << 1) | (low_1 >> (63 - r))) & mask;
+			const key_vector_t n = (((invalid_0 << r) << 1) | (invalid_1 >> (63 - r))) & mask;
+			memcpy(keya + pos, &a, sizeof(a));
+			memcpy(keyb + pos, &b, sizeof(b));
+			memcpy(keyn + pos, &n, sizeof(n));
+			r += 4;
+		}
+	}
+}
+
+/*
+ * Keys of the reverse complement of the k-mers starting at the 64
+ * positions of a word (see HashKey::rv_add), from the complemented bits
+ * packed the first nucleotide of a word in its lowest bit: the k bits of
+ * the k-mer starting at position s of word w are the bits starting at s
+ * of the words w and w + 1. The key of the k-mer starting at i is at
+ * i + 64 in keya and keyb (the first word pads the beginning of the read).
+ */
+KMER_KEYS_TARGETS
+void get_reverse_keys (const unsigned long * high, const unsigned long * low, const long nb_words, const unsigned long mask, unsigned long * __restrict__ keya, unsigned long * __restrict__ keyb)
+{
+	for (long w = 0; w < nb_words; w++) {
+		const unsigned long high_0 = high[w], high_1 = high[w + 1];
+		const unsigned long low_0 = low[w], low_1 = low[w + 1];
+		key_vector_t s = {0, 1, 2, 3};
+		for (long pos = 64 * w; pos < 64 * (w + 1); pos += 4) {
+			const key_vector_t a = ((high_0 >> s) | ((high_1 << 1) << (63 - s))) & mask;
+			const key_vector_t b = ((low_0 >> s) | ((low_1 << 1) << (63 - s))) & mask;
+			memcpy(keya + pos, &a, sizeof(a));
+			memcpy(keyb + pos, &b, sizeof(b));
+			s += 4;
+		}
+	}
+}
+
+/*
+ * KmerKeys computes the keys of all the k-mers of a read at once, as
+ * ForwardKey, ReverseKey and CanonicalKey give them one by one (see
+ * hash_key.h), for the loops that buffer the keys of a read before
+ * searching the indexes (see get_read_keys) or routing them to the
+ * partitions of a partitioned index (partitioned_index.h). The canonical
+ * k-mers of a read are also fed and searched this way (see feed_read and
+ * search_read): the keys alone are not computed faster than the rolling
+ * ones (see bench_kmers), but the probes of a filter larger than the
+ * cache then follow each other without waiting for the choice of the
+ * strand of each k-mer, and overlap more.
+ * A k-mer holding a char that is not a nucleotide has no key, as the
+ * rolling keys are cleared by such a char. Each thread has its own, as
+ * it keeps the keys of the read.
+ */
+class KmerKeys
+{
+private:
+	int kmer_size;
+	unsigned long mask;
+	long nb_words;
+	std::vector<char> chars;
+	std::vector<unsigned long> forward_high, forward_low, invalid;
+	std::vector<unsigned long> reverse_high, reverse_low;
+	std::vector<unsigned long> keya, keyb, keyn;
+	std::vector<unsigned long> rv_keya, rv_keyb;
+	
+	// 1 in each byte of x equal to c (SWAR: a byte is 0 after the xor
+	// only if adding 0x7f to its 7 low bits does not set its high bit)
+	static unsigned long equal_bytes (const unsigned long & x, const unsigned char & c)
+	{
+		const unsigned long y = x ^ (c * PACK_BYTE_BITS);
+		return (~(((y & PACK_LOW_7_BITS) + PACK_LOW_7_BITS) | y) >> 7) & PACK_BYTE_BITS;
+	}
+	
+	// Pack bytes of 0 or 1, the first byte in the highest bit (msb_first)
+	// or in the lowest one
+	static unsigned long pack (const unsigned long & x, const bool & msb_first)
+	{
+		return msb_first ? x * PACK_MSB_FIRST >> 56 : x * PACK_LSB_FIRST >> 56;
+	}
+	
+public:
+	KmerKeys (const int & kmer_size)
+	{
+		this->kmer_size = kmer_size;
+		mask = (1UL << kmer_size) - 1;
+		nb_words = 0;
+	}
+	
+	// Compute the keys of the k-mers of the read, of the forward strand
+	// and of the reverse one if reverse (or canonical) keys are needed
+	void set_read (const std::string & read, const bool & reverse)
+	{
+		nb_words = (read.size() + 63) / 64;
+		if (nb_words == 0) {
+			return;
+		}
+		chars.assign(64 * nb_words, 'N');
+		memcpy(&chars[0], read.data(), read.size());
+		// A padding word before the read: its beginning is not a k-mer,
+		// and one after it for the reverse keys
+		forward_high.assign(nb_words + 1, 0);
+		forward_low.assign(nb_words + 1, 0);
+		invalid.assign(nb_words + 1, 0);
+		reverse_high.assign(nb_words + 2, 0);
+		reverse_low.assign(nb_words + 2, 0);
+		invalid[0] = ~0UL;
+		// The 2 bits of a nucleotide are given by the bits 1 and 2 of its
+		// char, upper or lower case: A -> 00, C -> 01, G -> 10, T -> 11 (see
+		// Alphabet), 8 chars at a time
+		for (long w = 0; w < nb_words; w++) {
+			for (int byte = 0; byte < 8; byte++) {
+				unsigned long x;
+				memcpy(&x, &chars[64 * w + 8 * byte], 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				x = __builtin_bswap64(x);
+#endif
+				const unsigned long high = (x >> 2) & PACK_BYTE_BITS;
+				const unsigned long low = ((x >> 1) ^ (x >> 2)) & PACK_BYTE_BITS;
+				const unsigned long lower = x | PACK_LOWER_CASE;
+				const unsigned long nucleotide = equal_bytes(lower, 'a') | equal_bytes(lower, 'c') | equal_bytes(lower, 'g') | equal_bytes(lower, 't');
+				forward_high[w + 1] |= pack(high, true) << (56 - 8 * byte);
+				forward_low[w + 1] |= pack(low, true) << (56 - 8 * byte);
+				invalid[w + 1] |= pack(nucleotide ^ PACK_BYTE_BITS, true) << (56 - 8 * byte);
+				reverse_high[w + 1] |= pack(high ^ PACK_BYTE_BITS, false) << (8 * byte);
+				reverse_low[w + 1] |= pack(low ^ PACK_BYTE_BITS, false) << (8 * byte);
+			}
+		}
+		keya.resize(64 * nb_words);
+		keyb.resize(64 * nb_words);
+		keyn.resize(64 * nb_words);
+		get_forward_keys(&forward_high[0], &forward_low[0], &invalid[0], nb_words, mask, &keya[0], &keyb[0], &keyn[0]);
+		if (!reverse) {
+			return;
+		}
+		// No k-mer starts in the padding word
+		rv_keya.resize(64 * (nb_words + 1));
+		rv_keyb.resize(64 * (nb_words + 1));
+		get_reverse_keys(&reverse_high[1], &reverse_low[1], nb_words, mask, &rv_keya[64], &rv_keyb[64]);
+	}
+	
+	/* get_keys sets the keys of the k-mers of the read given to set_read,
+	 * with the positions of their last nucleotide, in the order in which
+	 * ForwardKey, ReverseKey (reverse) or CanonicalKey (canonical) give
+	 * them. Only keya and keyb are kept, one after the other in keys (16
+	 * bytes per k-mer, see HashKey::set). sampled, if not NULL, gives the
+	 * k-mers to keep (see kmer_sampler.h).
+	 */
+	void get_keys (const long & read_size, const bool & reverse, const bool & canonical, std::vector<unsigned long> & keys, std::vector<long> & keys_pos, const char * sampled = NULL)
+	{
+		// The buffers are sized once for all the k-mers, then cut. Each key
+		// is written at the end of the kept ones and kept or not without a
+		// branch: the non nucleotides and the sampling are not predictable
+		keys.resize(2 * std::max(read_size, 0L));
+		keys_pos.resize(std::max(read_size, 0L));
+		long nb_keys = 0;
+		// The reverse key of the k-mer ending at i starts at i - k + 1
+		const long shift = 65 - kmer_size;
+		for (long i = kmer_size - 1; i < read_size; i++) {
+			unsigned long a = keya[i], b = keyb[i];
+			if (canonical || reverse) {
+				const unsigned long rv_a = rv_keya[i + shift], rv_b = rv_keyb[i + shift];
+				const unsigned long rv_first = reverse | (rv_a < a) | ((rv_a == a) & (rv_b < b));
+				a ^= (a ^ rv_a) & -rv_first;
+				b ^= (b ^ rv_b) & -rv_first;
+			}
+			keys[2 * nb_keys] = a;
+			keys[2 * nb_keys + 1] = b;
+			keys_pos[nb_keys] = i;
+			nb_keys += (keyn[i] == 0) & (sampled == NULL || sampled[i]);
+		}
+		keys.resize(2 * nb_keys);
+		keys_pos.resize(nb_keys);
+	}
+};
+
+/* ReadKeys are the keys of the k-mers of a read, with their positions in
+ * the read, computed once to search the read in several indexes (colored
+ * search), or to feed or search a canonical index (see feed_read and
+ * search_read). Each k-mer takes its keya and keyb (see get_keys).
+ * With canonical keys, both strands are in forward.
+ * The other vectors are the buffers of a search in a bit-sliced index.
+ */
+struct ReadKeys
+{
+	KmerKeys kmer_keys;
+	std::vector<unsigned long> forward;
+	std::vector<long> forward_pos;
+	std::vector<unsigned long> reverse;
+	std::vector<long> reverse_pos;
+	std::vector<unsigned long> searched;
+	std::vector<unsigned long> found;
+	std::vector<unsigned long> row;
+	std::vector<int> seen;
+	std::vector<long> next_pos;
+	
+	ReadKeys (const int & kmer_size) : kmer_keys (kmer_size) {}
+};
+
+// Keys of the forward and reverse strands of the read, or its canonical
+// keys, computed for the whole read at once (see KmerKeys)
+// sampled, if not NULL, gives the k-mers to keep (see kmer_sampler.h)
+void get_read_keys (ReadKeys & read_keys, const std::string & read, const bool & canonical, const char * sampled = NULL)
+{
+	KmerKeys & kmer_keys = read_keys.kmer_keys;
+	kmer_keys.set_read(read, true);
+	if (canonical) {
+		kmer_keys.get_keys(read.size(), false, true, read_keys.forward, read_keys.forward_pos, sampled);
+		read_keys.reverse.clear();
+		read_keys.reverse_pos.clear();
+	} else {
+		kmer_keys.get_keys(read.size(), false, false, read_keys.forward, read_keys.forward_pos, sampled);
+		kmer_keys.get_keys(read.size(), true, false, read_keys.reverse, read_keys.reverse_pos, sampled);
+	}
+}
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KMER_SAMPLER_H_
+#define KMER_SAMPLER_H_
+
+#include "hash_key.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Sampling of the k-mers of the reads (options -w and -y)
+ *
+ * By default every k-mer of a read is indexed and searched. With a
+ * sampling, only some k-mers are, chosen from their own content so that
+ * two reads sharing a region sample the same k-mers in it:
+ *   (w,k)-minimizers : in each window of w consecutive k-mers, the k-mer
+ *                      of smallest hash
+ *   open syncmers    : the k-mers whose s-mer of smallest hash is in
+ *                      their middle, at offset (k - s) / 2
+ * The hashes are those of the canonical k-mers (or s-mers), and a window
+ * read backward holds the same k-mers, so a k-mer and its reverse
+ * complement are sampled alike: the sampled k-mers of a read are found on
+ * either strand. The minimum number of hits (-t) then counts sampled
+ * k-mers. About 2 / (w + 1) of the k-mers are sampled with minimizers,
+ * 1 / (k - s + 1) with syncmers.
+ */
+struct KmerSampling
+{
+	int window;        // w of the minimizers, 0 without
+	int syncmer_size;  // s of the syncmers, 0 without
+	
+	KmerSampling () : window (0), syncmer_size (0) {}
+	
+	bool is_active () const {return window > 1 || syncmer_size > 0;}
+};
+
+/*
+ * KmerSampler gives the sampled k-mers of a read. Each thread has its own,
+ * as it keeps the hashes of the read.
+ */
+class KmerSampler
+{
+private:
+	KmerSampling sampling;
+	int kmer_size;
+	// Length of the hashed units (k for minimizers, s for syncmers) and
+	// number of consecutive units compared together
+	int unit_size;
+	long window;
+	HashKey forward;
+	HashKey reverse;
+	std::vector<unsigned long> hashes;
+	std::vector<char> sampled;
+	
+	// Sample the minimizer of a run of fewer than w k-mers, ending at end
+	void sample_short_run (const long & end, const long & run)
+	{
+		if (run == 0 || run >= window || sampling.syncmer_size > 0) {
+			return;
+		}
+		long min_pos = end;
+		for (long j = end - run + 1; j < end; j++) {
+			if (hashes[j] < hashes[min_pos]) {
+				min_pos = j;
+			}
+		}
+		sampled[min_pos] = 1;
+	}
+	
+public:
+	KmerSampler (const int & kmer_size, const KmerSampling & sampling) : forward (sampling.syncmer_size > 0 ? sampling.syncmer_size : kmer_size), reverse (sampling.syncmer_size > 0 ? sampling.syncmer_size : kmer_size)
+	{
+		this->sampling = sampling;
+		this->kmer_size = kmer_size;
+		if (sampling.syncmer_size > 0) {
+			unit_size = sampling.syncmer_size;
+			window = kmer_size - sampling.syncmer_size + 1;
+		} else {
+			unit_size = kmer_size;
+			window = sampling.window;
+		}
+	}
+	
+	/* sample returns, for each position i of the read, whether the k-mer
+	 * ending at i is sampled, or NULL if all the k-mers are.
+	 */
+	const char * sample (const std::string & read)
+	{
+		if (!sampling.is_active() || read.empty()) {
+			return NULL;
+		}
+		sampled.assign(read.size(), 0);
+		hashes.resize(read.size());
+		CanonicalKey<> key (forward, reverse);
+		key.clear();
+		// Number of consecutive units ending at i, smallest of the window
+		long run = 0;
+		long min_pos = -1;
+		for (long i = 0; i < (long) read.size(); i++) {
+			const int size = key.add(read[i]);
+			if (size == 0) {
+				sample_short_run(i - 1, run);
+				run = 0;
+				min_pos = -1;
+			}
+			if (size < unit_size) {
+				continue;
+			}
+			hashes[i] = key.key().mixed_key();
+			run++;
+			if (run < window) {
+				continue;
+			}
+			const long first = i - window + 1;
+			if (min_pos < first) {
+				min_pos = first;
+				for (long j = first + 1; j <= i; j++) {
+					if (hashes[j] < hashes[min_pos]) {
+						min_pos = j;
+					}
+				}
+			} else if (hashes[i] < hashes[min_pos]) {
+				min_pos = i;
+			}
+			if (sampling.syncmer_size > 0) {
+				sampled[i] = hashes[first + (window - 1) / 2] == hashes[min_pos];
+			} else {
+				sampled[min_pos] = 1;
+			}
+		}
+		sample_short_run(read.size() - 1, run);
+		return &sampled[0];
+	}
+};
+
+#endif
@@ -0,0 +1,292 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINE_READER_H_
+#define LINE_READER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "gzip_reader.h"
+
+// Size of the blocks read at once from a file
+#define LINE_READER_BLOCK (1 << 20)
+// Size of the first block read after a seek, doubled by each next read up
+// to LINE_READER_BLOCK: when most reads of a file are skipped, only the
+// neighbourhood of the selected ones is read
+#define LINE_READER_SEEK_BLOCK (1 << 14)
+
+// A line of the current record: its first char, from the beginning of the
+// record, and its size without the '\n'
+struct Line
+{
+	size_t start;
+	size_t size;
+};
+
+/*
+ * LineReader reads a file by blocks of LINE_READER_BLOCK bytes with read()
+ * and cuts them into lines with memchr, without copying them: the readers
+ * of FASTA and FASTQ files (see fasta_file.h and fastq_file.h) only copy
+ * the sequences of the reads.
+ *
+ * The lines are grouped in records (a read of the file): when the buffer
+ * is refilled, the lines of the current record are moved to its
+ * beginning, and only those of the previous records are overwritten. The
+ * lines are thus given from the beginning of their record, so that they
+ * stay valid until the next record.
+ *
+ * seek jumps forward to a line given by its position (see skip_to in
+ * fasta_file.h and fastq_file.h): the blocks read after it are small at
+ * first, so that the reads far from each other are read alone.
+ *
+ * A gzipped file is decompressed by other threads (see gzip_reader.h),
+ * its positions are those of the decompressed file.
+ */
+class LineReader
+{
+private:
+	int fd;
+	bool gzipped;
+	GzipReader gzip;
+	std::string file_name;
+	std::vector<char> buffer;
+	// Beginning of the current record, next char to read and end of the
+	// chars read in the buffer
+	size_t record, pos, end;
+	// Position in the file of the first char of the buffer
+	unsigned long offset;
+	// Size of the next block to read
+	size_t block;
+	bool eof;
+	
+	// Read the next block after the current record, return false at the end
+	// of the file
+	bool fill ()
+	{
+		if (eof) {
+			return false;
+		}
+		if (record > 0) {
+			memmove(&buffer[0], &buffer[record], end - record);
+			offset += record;
+			pos -= record;
+			end -= record;
+			record = 0;
+		}
+		// A record longer than the buffer
+		if (buffer.size() - end < LINE_READER_BLOCK / 2) {
+			buffer.resize(2 * buffer.size());
+		}
+		ssize_t nb_read;
+		const size_t size = std::min(block, buffer.size() - end);
+		block = std::min(2 * block, (size_t) LINE_READER_BLOCK);
+		if (gzipped) {
+			nb_read = gzip.read(&buffer[end], size);
+		} else {
+			do {
+				nb_read = read(fd, &buffer[end], size);
+			} while (nb_read < 0 && errno == EINTR);
+		}
+		if (nb_read < 0) {
+			std::cerr << "Cannot read file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		if (nb_read == 0) {
+			eof = true;
+			return false;
+		}
+		end += nb_read;
+		return true;
+	}
+	
+public:
+	LineReader ()
+	{
+		fd = -1;
+		gzipped = false;
+		record = pos = end = 0;
+		offset = 0;
+		block = LINE_READER_BLOCK;
+		eof = true;
+	}
+	
+	~LineReader ()
+	{
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+	
+	// Open the file, return false if it cannot be read
+	bool open (const std::string & name, const bool & gzip_file = false)
+	{
+		file_name = name;
+		gzipped = gzip_file;
+		if (gzipped) {
+			if (!gzip.open(name)) {
+				return false;
+			}
+			buffer.resize(LINE_READER_BLOCK);
+			rewind();
+			return true;
+		}
+		fd = ::open(name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+#ifdef POSIX_FADV_SEQUENTIAL
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		buffer.resize(LINE_READER_BLOCK);
+		rewind();
+		return true;
+	}
+	
+	// Go back to the beginning of the file
+	void rewind ()
+	{
+		if (gzipped) {
+			gzip.rewind();
+		} else if (lseek(fd, 0, SEEK_SET) < 0) {
+			std::cerr << "Cannot rewind file " << file_name << " -> exit\n";
+			exit(1);
+		}
+		record = pos = end = 0;
+		offset = 0;
+		block = LINE_READER_BLOCK;
+		eof = false;
+	}
+	
+	// Go forward to the given position of the file, the beginning of a
+	// line, without reading the lines before it. Return false, and stay
+	// at the current position, if it is before it or cannot be reached
+	// (a plain file that is not seekable).
+	bool seek (const unsigned long & position)
+	{
+		if (position < tell()) {
+			return false;
+		}
+		// Still in the buffer
+		if (position <= offset + end) {
+			pos = position - offset;
+			return true;
+		}
+		if (gzipped) {
+			// The chars before it are decompressed but not copied
+			gzip.skip(position - (offset + end));
+		} else if (lseek(fd, position, SEEK_SET) < 0) {
+			return false;
+		}
+		record = pos = end = 0;
+		offset = position;
+		block = LINE_READER_SEEK_BLOCK;
+		return true;
+	}
+	
+	// Start a new record at the next line: the lines of the previous
+	// records may now be overwritten
+	void begin_record ()
+	{
+		record = pos;
+	}
+	
+	// Read the next line, without its '\n'. Return false at the end of
+	// the file. The last line may have no '\n', as with getline.
+	bool next_line (Line & line)
+	{
+		size_t scanned = pos;
+		while (true) {
+			const char * found = (const char *) memchr(buffer.data() + scanned, '\n', end - scanned);
+			if (found != NULL) {
+				line.start = pos - record;
+				line.size = found - (buffer.data() + pos);
+				pos += line.size + 1;
+				return true;
+			}
+			// Only the new chars are scanned after a refill, which may move
+			// the record to the beginning of the buffer
+			const size_t scanned_in_record = end - record;
+			if (!fill()) {
+				if (pos == end) {
+					return false;
+				}
+				line.start = pos - record;
+				line.size = end - pos;
+				pos = end;
+				return true;
+			}
+			scanned = record + scanned_in_record;
+		}
+	}
+	
+	// Next char of the file, without reading it, or EOF
+	int peek ()
+	{
+		if (pos == end && !fill()) {
+			return EOF;
+		}
+		return (unsigned char) buffer[pos];
+	}
+	
+	// Chars of a line of the current record
+	const char * get (const Line & line) const
+	{
+		return buffer.data() + record + line.start;
+	}
+	
+	// Append the lines of the current record read so far to data, each
+	// one ended by '\n', without the empty ones
+	void get_record (std::string & data) const
+	{
+		const char * line = buffer.data() + record;
+		const char * record_end = buffer.data() + pos;
+		while (line < record_end) {
+			const char * found = (const char *) memchr(line, '\n', record_end - line);
+			const char * line_end = found != NULL ? found : record_end;
+			if (line_end > line) {
+				data.append(line, line_end - line);
+				data += '\n';
+			}
+			line = line_end + 1;
+		}
+	}
+	
+	// Position in the file of the next char to read
+	unsigned long tell () const
+	{
+		return offset + pos;
+	}
+};
+
+#endif
@@ -0,0 +1,703 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PACKED_READ_FILE_H__
+#define __PACKED_READ_FILE_H__
+
+#include "read_file.h"
+#include "line_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// First bytes of a packed read file
+#define PACKED_READ_MAGIC "COMMETPK"
+// Version of the packed read file format: 2 stamps the read file with a
+// FileStamp (see read_index.h), 3 packs the lowercase nucleotides
+#define PACKED_READ_VERSION 3
+
+/*
+ * Packed read file, written by pack_reads: the sequences of the reads of
+ * a FASTA or FASTQ file (gzipped or not), without their headers and
+ * qualities, with 2 bits per nucleotide. The tools read it as they read
+ * its read file: same reads in the same order, so the boolean vectors of
+ * both are the same. It is about 4 times smaller than a FASTA file, 7
+ * times than a FASTQ file, and its reads are not parsed.
+ *
+ *   char[8]  PACKED_READ_MAGIC
+ *   uint32   PACKED_READ_VERSION
+ *   uint32   size of the name of the read file
+ *   char[]   name of the read file (absolute path)
+ *   FileStamp of the read file (size, inode, times, see read_index.h)
+ *   uint64   number of reads
+ *   uint64   position of the read index in the packed file
+ *   for each read:
+ *     uint32   size of the read
+ *     uint32   number of runs of chars that are not A, C, G or T in
+ *              upper or lower case
+ *     uint32   number of lowercase intervals
+ *     runs     uint32 position in the read, uint32 size, char (N, n...)
+ *     lowercase intervals: uint32 position in the read, uint32 size
+ *     uint8[]  nucleotides, 4 per byte from the low bits (A -> 00,
+ *              C -> 01, G -> 10, T -> 11, the chars of the runs as A)
+ *
+ * The lowercase nucleotides (soft-masked repeats of an assembly) are
+ * packed as the uppercase ones and their intervals are lowercased back,
+ * so a masked region costs one interval instead of one run per char.
+ *   uint64[] read index: position in the packed file of the reads 0,
+ *            READ_INDEX_STEP, 2 * READ_INDEX_STEP... (see read_index.h)
+ *   uint64[] offset of the first line of each read in the read file
+ *            (in the uncompressed data for a gzipped file)
+ *
+ * The offsets link each read to its full entry in the read file, which
+ * is only read by get_data (extract_reads). The read file must not have
+ * changed since it was packed.
+ *
+ * Numbers are written in the byte order of the machine.
+ */
+class PackedReadFile : public ReadFile
+{
+private:
+	int fd;
+	// Position in the packed file of the first read, of the read index
+	// and of the offsets
+	unsigned long reads_start, index_start, offsets_start;
+	std::vector<unsigned long> positions;
+	// Buffer of the packed file: position in the file of its first char,
+	// next char to read, end of the chars read and size of the next block
+	// to read (see LineReader::seek)
+	std::vector<char> buffer;
+	unsigned long buffer_offset;
+	size_t pos, end, block;
+	// The 4 nucleotides of each byte
+	char nucleotides[256][4];
+	// The read file, only read by get_data
+	std::string original_name;
+	FileStamp original_stamp;
+	mutable LineReader original;
+	mutable bool original_open;
+	// current_read_data is only built when get_data asks for it
+	mutable bool has_data;
+	
+	////////////////////////////////////////////////////////////
+	// Read size chars at position in the packed file
+	//
+	bool read_at (const unsigned long & position, void * data, const size_t & size) const
+	{
+		return pread(fd, data, size, position) == (ssize_t) size;
+	}
+	
+	void corrupted () const
+	{
+		std::cerr << "Error: Corrupted packed read file " << fname << " -> exit\n";
+		exit(1);
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Read the header and the read index of the packed file
+	//
+	void read_header ()
+	{
+		char magic[8];
+		unsigned int version, name_size;
+		if (!read_at(0, magic, 8) || memcmp(magic, PACKED_READ_MAGIC, 8) != 0) {
+			std::cerr << "Error: " << fname << " is not a packed read file -> exit\n";
+			exit(1);
+		}
+		if (!read_at(8, &version, 4) || version != PACKED_READ_VERSION) {
+			std::cerr << "Error: Packed read file " << fname << " was written by another version of pack_reads -> exit\n";
+			exit(1);
+		}
+		if (!read_at(12, &name_size, 4)) {
+			corrupted();
+		}
+		// The name and the stamp of the read file
+		std::vector<char> original (name_size + sizeof(FileStamp));
+		const unsigned long position = 16 + original.size();
+		if (!read_at(16, &original[0], original.size())
+			|| !read_at(position, &nb_reads, 8)
+			|| !read_at(position + 8, &index_start, 8)) {
+			corrupted();
+		}
+		original_name.assign(&original[0], name_size);
+		memcpy(&original_stamp, &original[name_size], sizeof(FileStamp));
+		reads_start = position + 16;
+		positions.resize((nb_reads + READ_INDEX_STEP - 1) / READ_INDEX_STEP);
+		offsets_start = index_start + positions.size() * sizeof(unsigned long);
+		if (!positions.empty() && !read_at(index_start, &positions[0], positions.size() * sizeof(unsigned long))) {
+			corrupted();
+		}
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Make size chars of the packed file available from pos.
+	// Return false at the end of the file.
+	//
+	bool need (const size_t & size)
+	{
+		if (end - pos >= size) {
+			return true;
+		}
+		memmove(&buffer[0], &buffer[pos], end - pos);
+		buffer_offset += pos;
+		end -= pos;
+		pos = 0;
+		if (buffer.size() < size + LINE_READER_BLOCK) {
+			buffer.resize(size + LINE_READER_BLOCK);
+		}
+		while (end < size) {
+			const ssize_t nb_read = read(fd, &buffer[end], std::min(block, buffer.size() - end));
+			if (nb_read < 0 && errno == EINTR) {
+				continue;
+			}
+			if (nb_read < 0) {
+				std::cerr << "Cannot read file " << fname << " -> exit\n";
+				exit(1);
+			}
+			if (nb_read == 0) {
+				return false;
+			}
+			end += nb_read;
+			block = std::min(2 * block, (size_t) LINE_READER_BLOCK);
+		}
+		return true;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Go forward to the given position of the packed file
+	//
+	void seek (const unsigned long & position)
+	{
+		if (position <= buffer_offset + end) {
+			pos = position - buffer_offset;
+			return;
+		}
+		if (lseek(fd, position, SEEK_SET) < 0) {
+			std::cerr << "Cannot read file " << fname << " -> exit\n";
+			exit(1);
+		}
+		buffer_offset = position;
+		pos = end = 0;
+		block = LINE_READER_SEEK_BLOCK;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Read the size, the number of runs and of lowercase intervals
+	// of the next read, and make its whole record available. Return
+	// the size of the record.
+	//
+	size_t read_record (unsigned int & size, unsigned int & nb_runs, unsigned int & nb_lowercase)
+	{
+		if (!need(12)) {
+			corrupted();
+		}
+		memcpy(&size, &buffer[pos], 4);
+		memcpy(&nb_runs, &buffer[pos + 4], 4);
+		memcpy(&nb_lowercase, &buffer[pos + 8], 4);
+		const size_t record_size = 12 + 9 * (size_t) nb_runs + 8 * (size_t) nb_lowercase + ((size_t) size + 3) / 4;
+		if (!need(record_size)) {
+			corrupted();
+		}
+		return record_size;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Unpack the nucleotides of the next read, lowercase its
+	// intervals then copy its runs
+	//
+	void read_sequence (std::string & sequence)
+	{
+		unsigned int size, nb_runs, nb_lowercase;
+		const size_t record_size = read_record(size, nb_runs, nb_lowercase);
+		const char * runs = &buffer[pos + 12];
+		const char * lowercase = runs + 9 * (size_t) nb_runs;
+		const unsigned char * packed = (const unsigned char *) lowercase + 8 * (size_t) nb_lowercase;
+		sequence.resize(size);
+		char * chars = &sequence[0];
+		for (size_t i = 0; i < size / 4; i++) {
+			memcpy(chars + 4 * i, nucleotides[packed[i]], 4);
+		}
+		for (size_t i = size & ~3U; i < size; i++) {
+			chars[i] = nucleotides[packed[i / 4]][i % 4];
+		}
+		for (unsigned int interval = 0; interval < nb_lowercase; interval++) {
+			unsigned int start, length;
+			memcpy(&start, lowercase + 8 * interval, 4);
+			memcpy(&length, lowercase + 8 * interval + 4, 4);
+			if (start > size || length > size - start) {
+				corrupted();
+			}
+			for (unsigned int i = start; i < start + length; i++) {
+				chars[i] |= 'a' - 'A';
+			}
+		}
+		for (unsigned int run = 0; run < nb_runs; run++) {
+			unsigned int start, length;
+			memcpy(&start, runs + 9 * run, 4);
+			memcpy(&length, runs + 9 * run + 4, 4);
+			if (start > size || length > size - start) {
+				corrupted();
+			}
+			memset(chars + start, runs[9 * run + 8], length);
+		}
+		pos += record_size;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Go straight to the last read of the read index before the
+	// read at read_pos, if it is after the current read
+	//
+	void skip_to (const unsigned long & read_pos)
+	{
+		const unsigned long indexed = read_pos / READ_INDEX_STEP;
+		if (indexed < positions.size() && indexed * READ_INDEX_STEP > current_read_pos) {
+			seek(positions[indexed]);
+			current_read_pos = indexed * READ_INDEX_STEP;
+		}
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Open the read file for get_data, exit if it changed since
+	// it was packed
+	//
+	void open_original () const
+	{
+		struct stat info;
+		if (stat(original_name.c_str(), &info) != 0 || FileStamp (info) != original_stamp) {
+			std::cerr << "Error: " << original_name << ", the read file of " << fname << ", is missing or changed since it was packed -> exit\n";
+			exit(1);
+		}
+		unsigned char magic[2] = {0, 0};
+		std::ifstream infile (original_name.c_str());
+		infile.read((char *) magic, 2);
+		infile.close();
+		if (!original.open(original_name, magic[0] == 31 && magic[1] == 139)) {
+			std::cerr << "Error: Cannot open read file " << original_name << "\n";
+			exit(1);
+		}
+		original_open = true;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Append the entry of the current read in the read file to
+	// data, without its empty lines: its lines up to the offset of
+	// the next read
+	//
+	void read_original (std::string & data) const
+	{
+		if (!original_open) {
+			open_original();
+		}
+		unsigned long offsets[2] = {0, ULONG_MAX};
+		const size_t nb_offsets = current_read_pos + 1 < nb_reads ? 2 : 1;
+		if (!read_at(offsets_start + current_read_pos * sizeof(unsigned long), offsets, nb_offsets * sizeof(unsigned long))) {
+			corrupted();
+		}
+		if (!original.seek(offsets[0])) {
+			original.rewind();
+			original.seek(offsets[0]);
+		}
+		original.begin_record();
+		Line line;
+		while (original.tell() < offsets[1] && original.next_line(line)) {
+		}
+		original.get_record(data);
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Open the packed file. Set the boolean vector to 1, or read
+	// it in bv file if one is given
+	// + check boolean vector size and nb_reads are equal
+	//
+	void open_file (const std::string & file_name, const std::string * bv_file_name)
+	{
+		fname = file_name;
+		for (int byte = 0; byte < 256; byte++) {
+			for (int i = 0; i < 4; i++) {
+				nucleotides[byte][i] = "ACGT"[(byte >> (2 * i)) & 3];
+			}
+		}
+		original_open = false;
+		// Open the file
+		fd = ::open(file_name.c_str(), O_RDONLY);
+		if (fd < 0) {
+			std::cerr << "Error: Cannot open packed read file " << file_name << "\n";
+			exit(1);
+		}
+		read_header();
+		buffer.resize(LINE_READER_BLOCK);
+		if (bv_file_name == NULL) {
+			// Set boolean vector to 1
+			bv.init_true(nb_reads);
+		} else {
+			// Read the boolean vector in bv file
+			bv.read(*bv_file_name);
+			// Check boolean vector size and nb_reads are equal
+			if (nb_reads != bv.size()) {
+				std::cerr << "Number of reads in " << file_name << " and boolean vector size are not equal -> quit\n";
+				exit(1);
+			}
+		}
+		_nb_valid_reads = bv.nb_one();
+		rewind();
+	}
+	
+public:
+	
+	////////////////////////////////////////////////////////////
+	// Open the file and set boolean vector to 1
+	//
+	explicit PackedReadFile (const std::string & file_name)
+	{
+		open_file(file_name, NULL);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Open the file and read boolean vector in bv file
+	// + check boolean vector size and nb_reads are equal
+	//
+	PackedReadFile (const std::string & file_name, const std::string & bv_file_name)
+	{
+		open_file(file_name, &bv_file_name);
+	}
+	
+	~PackedReadFile ()
+	{
+		close(fd);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// True if the file is a packed read file
+	//
+	static bool is_packed (const std::string & file_name)
+	{
+		char magic[8];
+		std::ifstream infile (file_name.c_str(), std::ios::binary);
+		return infile.read(magic, 8) && memcmp(magic, PACKED_READ_MAGIC, 8) == 0;
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Write the reads of read_file in a packed read file
+	//
+	static void pack (ReadFile & read_file, const std::string & output_file_name)
+	{
+		FILE * file = fopen(output_file_name.c_str(), "wb");
+		// The offsets are written after the reads
+		FILE * offsets = tmpfile();
+		if (file == NULL || offsets == NULL) {
+			std::cerr << "Cannot write on file " << output_file_name << " -> exit\n";
+			exit(1);
+		}
+		char path[PATH_MAX];
+		const std::string name = realpath(read_file.get_fname().c_str(), path) != NULL ? path : read_file.get_fname();
+		struct stat info;
+		if (stat(name.c_str(), &info) != 0) {
+			std::cerr << "Cannot read file " << name << " -> exit\n";
+			exit(1);
+		}
+		const unsigned int version = PACKED_READ_VERSION;
+		const unsigned int name_size = name.size();
+		const FileStamp stamp (info);
+		const unsigned long nb_reads = read_file.get_nb_reads();
+		unsigned long index = 0;
+		fwrite(PACKED_READ_MAGIC, 8, 1, file);
+		fwrite(&version, 4, 1, file);
+		fwrite(&name_size, 4, 1, file);
+		fwrite(name.data(), 1, name_size, file);
+		fwrite(&stamp, sizeof(stamp), 1, file);
+		fwrite(&nb_reads, 8, 1, file);
+		fwrite(&index, 8, 1, file);
+		unsigned long position = 32 + name_size + sizeof(stamp);
+		// Codes of A, C, G and T in upper or lower case, 4 for the chars
+		// of the runs
+		unsigned char codes[256];
+		memset(codes, 4, 256);
+		codes[(unsigned char) 'A'] = codes[(unsigned char) 'a'] = 0;
+		codes[(unsigned char) 'C'] = codes[(unsigned char) 'c'] = 1;
+		codes[(unsigned char) 'G'] = codes[(unsigned char) 'g'] = 2;
+		codes[(unsigned char) 'T'] = codes[(unsigned char) 't'] = 3;
+		std::vector<unsigned long> positions;
+		std::vector<char> record, lowercase;
+		read_file.rewind();
+		for (unsigned long read = 0; read < nb_reads; read++) {
+			const std::string & sequence = read_file.get_next_read();
+			const unsigned long offset = read_file.get_read_offset();
+			fwrite(&offset, 8, 1, offsets);
+			if (read % READ_INDEX_STEP == 0) {
+				positions.push_back(position);
+			}
+			const unsigned int read_size = sequence.size();
+			record.assign(12, 0);
+			memcpy(&record[0], &read_size, 4);
+			unsigned int nb_runs = 0, nb_lowercase = 0;
+			lowercase.clear();
+			for (unsigned int i = 0; i < read_size; i++) {
+				if (sequence[i] >= 'a' && sequence[i] <= 'z') {
+					unsigned int length = 1;
+					while (i + length < read_size && sequence[i + length] >= 'a' && sequence[i + length] <= 'z') {
+						length++;
+					}
+					lowercase.insert(lowercase.end(), (char *) &i, (char *) &i + 4);
+					lowercase.insert(lowercase.end(), (char *) &length, (char *) &length + 4);
+					nb_lowercase++;
+					i += length - 1;
+				}
+			}
+			for (unsigned int i = 0; i < read_size; i++) {
+				if (codes[(unsigned char) sequence[i]] == 4) {
+					unsigned int length = 1;
+					while (i + length < read_size && sequence[i + length] == sequence[i]) {
+						length++;
+					}
+					record.insert(record.end(), (char *) &i, (char *) &i + 4);
+					record.insert(record.end(), (char *) &length, (char *) &length + 4);
+					record.push_back(sequence[i]);
+					nb_runs++;
+					i += length - 1;
+				}
+			}
+			memcpy(&record[4], &nb_runs, 4);
+			memcpy(&record[8], &nb_lowercase, 4);
+			record.insert(record.end(), lowercase.begin(), lowercase.end());
+			const size_t packed = record.size();
+			record.resize(packed + (read_size + 3) / 4, 0);
+			for (unsigned int i = 0; i < read_size; i++) {
+				record[packed + i / 4] |= (codes[(unsigned char) sequence[i]] & 3) << (2 * (i % 4));
+			}
+			fwrite(&record[0], 1, record.size(), file);
+			position += record.size();
+		}
+		// The read index, then the offsets
+		if (!positions.empty()) {
+			fwrite(&positions[0], sizeof(unsigned long), positions.size(), file);
+		}
+		char data[1 << 16];
+		size_t nb_read;
+		::rewind(offsets);
+		while ((nb_read = fread(data, 1, sizeof(data), offsets)) > 0) {
+			fwrite(data, 1, nb_read, file);
+		}
+		fclose(offsets);
+		fseek(file, 24 + name_size + sizeof(stamp), SEEK_SET);
+		fwrite(&position, 8, 1, file);
+		if (ferror(file) != 0 || fclose(file) != 0) {
+			std::cerr << "Cannot write on file " << output_file_name << " -> exit\n";
+			exit(1);
+		}
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// get_next_read returns the next read in the file
+	// OR an empty string if no more read is available
+	//
+	std::string & get_next_read ()
+	{
+		// clear data and increment the position
+		if (first_read) {
+			first_read = false;
+		} else {
+			current_read_pos++;
+		}
+		has_data = false;
+		current_read_seq.clear();
+		
+		if (_cnt_valid_reads < _nb_valid_reads) {
+			// Jump to the indexed read before the next valid read
+			if (current_read_pos < nb_reads && !bv.is_set(current_read_pos)) {
+				skip_to(bv.next_set(current_read_pos));
+			}
+			// While reads are not valid in the boolean vector, flush them
+			while (current_read_pos < nb_reads && !bv.is_set(current_read_pos)) {
+				flush_next_read ();
+				current_read_pos++;
+			}
+			// The current read is 1 in the boolean vector
+			// Or current_read_pos >= nb_reads -> end of file
+			if (current_read_pos < nb_reads) {
+				read_sequence(current_read_seq);
+			}
+			if (!current_read_seq.empty()) {
+				_cnt_valid_reads++;
+			}
+		}
+		return current_read_seq;
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Just read the next read without storing it
+	//
+	void flush_next_read () {
+		has_data = false;
+		current_read_seq.clear();
+		unsigned int size, nb_runs, nb_lowercase;
+		const size_t record_size = read_record(size, nb_runs, nb_lowercase);
+		pos += record_size;
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Return the full entry of the current read in the read file,
+	// without its empty lines
+	//
+	const std::string & get_data() const
+	{
+		if (!has_data) {
+			current_read_data.clear();
+			if (!current_read_seq.empty()) {
+				read_original(current_read_data);
+			}
+			has_data = true;
+		}
+		return current_read_data;
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Return the sequence of the current read
+	//
+	const std::string & get_read() const
+	{
+		return current_read_seq;
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Set the bit of the current read to 1 in the boolean vector
+	//
+	void tag_current_read ()
+	{
+		bv.set(current_read_pos);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Set the bit of the current read to 0 in the boolean vector
+	//
+	void untag_current_read ()
+	{
+		bv.unset(current_read_pos);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Set the bit of the read at pos to 1 in the boolean vector
+	//
+	void tag (const unsigned long & pos)
+	{
+		bv.set(pos);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Set the bit of the read at pos to 0 in the boolean vector
+	//
+	void untag (const unsigned long & pos)
+	{
+		bv.unset(pos);
+	}
+	
+	
+	////////////////////////////////////////////////////////////
+	// Go to the beginning of the file -> current_read_pos = -1
+	// because no read has been read
+	//
+	void rewind () {
+		if (lseek(fd, reads_start, SEEK_SET) < 0) {
+			std::cerr << "Cannot rewind file " << fname << " -> exit\n";
+			exit(1);
+		}
+		buffer_offset = reads_start;
+		pos = end = 0;
+		block = LINE_READER_BLOCK;
+		has_data = false;
+		current_read_seq.clear();
+		_cnt_valid_reads = 0;
+		current_read_pos = 0;
+		first_read = true;
+	};
+	
+	////////////////////////////////////////////////////////////
+	// Set the comment of the boolean vector
+	//
+	void set_bv_comment (const std::string & str)
+	{
+		bv.set_comment(str);
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Save the boolean vector in the given file name
+	//
+	void save_bv (const std::string & file_name)
+	{
+		bv.print(file_name);
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Save the boolean vector in fname.bv
+	//
+	void save_bv ()
+	{
+		bv.print(fname + ".bv");
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Save the entries of the selected reads, taken from the read
+	// file, in a given file name
+	//
+	void save (const std::string & directory, const std::string & suffix) {
+		std::string output_file_name = directory + "/" + original_name.substr(original_name.rfind("/") + 1)  + "_in_" + suffix;
+		rewind();
+		std::ofstream outfile;
+		outfile.open (output_file_name.c_str());
+		if (!outfile.good()) {
+			std::cerr << "Cannot write on file " << output_file_name << "\n";
+			exit(1);
+		}
+		std::string & current_read = get_next_read();
+		while (!current_read.empty()) {
+			outfile << get_data();
+			current_read = get_next_read();
+		}
+		outfile.close();
+	}
+};
+
+#endif
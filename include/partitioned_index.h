@@ -0,0 +1,608 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PARTITIONED_INDEX_H_
+#define PARTITIONED_INDEX_H_
+
+#include "bloom_filter.h"
+#include "index_type.h"
+#include "index_file.h"
+#include "kmer_counter.h"
+#include "kmer_sampler.h"
+#include "kmer_keys.h"
+#include "search_reads.h"
+#include "file_manager.h"
+#include "alphabet.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Size of the minimizers that route the k-mers to the partitions
+// (or k if smaller)
+#define PARTITION_MINIMIZER_SIZE 15
+// Maximal number of partitions, one temporary file is open per partition
+// while the index is built
+#define MAX_PARTITIONS 512
+// Number of k-mers written or read at once in a temporary file of the
+// partitions
+#define PARTITION_FILE_BUFFER (1 << 12)
+// Minimal number of k-mers searched at once in the partitions
+#define PARTITION_BATCH_SIZE (1 << 20)
+
+/*
+ * Partitioned index (option -P)
+ *
+ * A reference read set too large for one index is split in chunks of
+ * reads, and each chunk is searched with a full pass over the query
+ * reads. A partitioned index splits the k-mers instead of the reads: each
+ * k-mer goes in the partition given by its minimizer, the smallest hash of
+ * its canonical m-mers, so that a k-mer and its reverse complement are in
+ * the same partition, and so are most consecutive k-mers of a read.
+ *
+ * The partitions are built in one pass over the reference reads (see
+ * build_partitioned_index), and written as the chunks of an index file
+ * (see index_file.h). The query reads are then read once: their k-mers are
+ * gathered by batches, each partition is searched for the k-mers of the
+ * batch it holds, and then each read gets its hits back in order (see
+ * search_reads_partitioned). As the index file is mapped in memory, only
+ * the pages of the partitions touched by a batch are loaded.
+ */
+
+// Return the size of the minimizers of a partitioned index of k-mers of
+// kmer_size nucleotides
+int partition_minimizer_size (const int & kmer_size)
+{
+	return kmer_size < PARTITION_MINIMIZER_SIZE ? kmer_size : PARTITION_MINIMIZER_SIZE;
+}
+
+// Return the memory budget of each of the nb_partitions partitions of an
+// index of the given type and budget (0 for the default size): as the
+// partitions are searched together, they share the budget of one index
+// The type is not classic, which cannot be resized (see index_type.h)
+unsigned long partition_memory (const int & index_type, const int & kmer_size, const unsigned long & index_memory, const int & nb_partitions)
+{
+	const unsigned long memory = index_size(index_type, kmer_size, index_memory) / nb_partitions;
+	return memory < BLOOM_BLOCK_SIZE ? BLOOM_BLOCK_SIZE : memory;
+}
+
+/*
+ * MinimizerPartitioner gives the partition of each k-mer of a read.
+ *
+ * The m-mers are hashed with their canonical 2-bit encoding (the smallest
+ * of the m-mer and of its reverse complement), and the partition of a
+ * k-mer is given by the smallest hash of its k - m + 1 m-mers.
+ */
+class MinimizerPartitioner
+{
+private:
+	int kmer_size;
+	int minimizer_size;
+	unsigned long nb_partitions;
+	unsigned long mask;
+	int rv_shift;
+	const unsigned char * codes;
+	std::vector<unsigned long> hashes;
+public:
+	MinimizerPartitioner (const int & kmer_size, const int & minimizer_size, const int & nb_partitions)
+	{
+		this->kmer_size = kmer_size;
+		this->minimizer_size = minimizer_size;
+		this->nb_partitions = nb_partitions;
+		mask = (1UL << (2 * minimizer_size)) - 1;
+		rv_shift = 2 * (minimizer_size - 1);
+		codes = Alphabet::getInstance()->get_codes();
+	}
+	
+	// Set the partitions of the k-mers of the read, in the order of their
+	// keys (see KmerKeys::get_keys in kmer_keys.h), only for the sampled
+	// k-mers if sampled is given
+	void get_partitions (const std::string & read, std::vector<unsigned int> & partitions, const char * sampled = NULL)
+	{
+		partitions.clear();
+		hashes.resize(read.size());
+		unsigned long forward = 0;
+		unsigned long reverse = 0;
+		int nb_valid = 0;
+		long min_pos = -1;
+		for (long i = 0; i < (long) read.size(); i++) {
+			const unsigned long code = codes[(unsigned char) read[i]];
+			if (code == NOT_NUCLEOTIDE) {
+				nb_valid = 0;
+				forward = reverse = 0;
+				min_pos = -1;
+				continue;
+			}
+			nb_valid++;
+			forward = ((forward << 2) | code) & mask;
+			reverse = (reverse >> 2) | ((code ^ 3) << rv_shift);
+			if (nb_valid < minimizer_size) {
+				continue;
+			}
+			hashes[i] = HashKey::mix(forward < reverse ? forward : reverse);
+			if (nb_valid < kmer_size) {
+				continue;
+			}
+			// m-mers of the k-mer: the ones ending from first to i
+			const long first = i - (kmer_size - minimizer_size);
+			if (min_pos < first) {
+				min_pos = first;
+				for (long j = first + 1; j <= i; j++) {
+					if (hashes[j] < hashes[min_pos]) {
+						min_pos = j;
+					}
+				}
+			} else if (hashes[i] < hashes[min_pos]) {
+				min_pos = i;
+			}
+			if (sampled != NULL && !sampled[i]) {
+				continue;
+			}
+			// The minimizer is hashed again: the smallest hashes are biased
+			partitions.push_back(((HashKey::mix(hashes[min_pos]) >> 32) * nb_partitions) >> 32);
+		}
+	}
+};
+
+// Write the keys of buffer (keya, keyb) at the end of a temporary file of
+// the partitions, and clear buffer
+void write_partition_keys (FILE * file, const std::string & file_name, std::vector<unsigned long> & buffer)
+{
+	if (!buffer.empty() && fwrite(&buffer[0], sizeof(unsigned long), buffer.size(), file) != buffer.size()) {
+		std::cerr << "Cannot write temporary file " << file_name << " -> exit\n";
+		exit(1);
+	}
+	buffer.clear();
+}
+
+/* build_partitioned_index indexes the reads of index_file_manager in the
+ * nb_partitions partitions of index_file, and returns the number of
+ * indexed reads. index_file must be opened with the minimizer size given
+ * by partition_minimizer_size.
+ *
+ * The reads are read once: the keys of their k-mers are written in one
+ * temporary file per partition (16 bytes per k-mer, tmp_prefix.<partition>).
+ * Then each partition is indexed from its file, in an index of the given
+ * type and of 1/nb_partitions of the memory budget (see partition_memory),
+ * and written in index_file.
+ *
+ * With min_count > 1, the k-mers of each partition are counted as in
+ * index_reads, and as all the occurrences of a k-mer are in the same
+ * partition, the counts are those of the whole read set.
+ * With a sampling, only the sampled k-mers are indexed.
+ */
+unsigned long build_partitioned_index (IndexFileWriter & index_file, FileManager * index_file_manager, const int & kmer_size, const int & nb_partitions, const int & index_type, const unsigned long & index_memory, const bool & canonical, const int & min_count, const std::string & tmp_prefix, const KmerSampling & sampling = KmerSampling ())
+{
+	HashKey hash (kmer_size);
+	KmerKeys kmer_keys (kmer_size);
+	KmerSampler sampler (kmer_size, sampling);
+	MinimizerPartitioner partitioner (kmer_size, partition_minimizer_size(kmer_size), nb_partitions);
+	
+	// Route the k-mers of the reads to the files of their partitions
+	std::vector<FILE *> files (nb_partitions);
+	std::vector<std::string> file_names (nb_partitions);
+	for (int partition = 0; partition < nb_partitions; partition++) {
+		std::stringstream file_name;
+		file_name << tmp_prefix << "." << partition;
+		file_names[partition] = file_name.str();
+		files[partition] = fopen(file_names[partition].c_str(), "w+b");
+		if (files[partition] == NULL) {
+			std::cerr << "Cannot open temporary file " << file_names[partition] << " -> exit\n";
+			exit(1);
+		}
+	}
+	std::vector< std::vector<unsigned long> > buffers (nb_partitions);
+	unsigned long nb_indexed_reads = 0;
+	std::vector<unsigned long> keys;
+	std::vector<long> keys_pos;
+	std::vector<unsigned int> partitions;
+	std::string & current_read_to_index = index_file_manager->get_next_read_to_compare();
+	while (!current_read_to_index.empty()) {
+		nb_indexed_reads++;
+		const char * sampled = sampler.sample(current_read_to_index);
+		kmer_keys.set_read(current_read_to_index, canonical);
+		kmer_keys.get_keys(current_read_to_index.size(), false, canonical, keys, keys_pos, sampled);
+		partitioner.get_partitions(current_read_to_index, partitions, sampled);
+		for (size_t j = 0; j < partitions.size(); j++) {
+			std::vector<unsigned long> & buffer = buffers[partitions[j]];
+			buffer.push_back(keys[2 * j]);
+			buffer.push_back(keys[2 * j + 1]);
+			if (buffer.size() == 2 * PARTITION_FILE_BUFFER) {
+				write_partition_keys(files[partitions[j]], file_names[partitions[j]], buffer);
+			}
+		}
+		current_read_to_index = index_file_manager->get_next_read_to_compare();
+	}
+	for (int partition = 0; partition < nb_partitions; partition++) {
+		write_partition_keys(files[partition], file_names[partition], buffers[partition]);
+		std::vector<unsigned long> ().swap(buffers[partition]);
+		// fwrite may only fail when its buffer is written
+		if (fflush(files[partition]) != 0) {
+			std::cerr << "Cannot write temporary file " << file_names[partition] << " -> exit\n";
+			exit(1);
+		}
+	}
+	
+	// Index each partition
+	const unsigned long memory = partition_memory(index_type, kmer_size, index_memory, nb_partitions);
+	const unsigned long max_kmer = index_max_kmer(index_type, index_size(index_type, kmer_size, memory));
+	unsigned long max_partition_kmers = 0;
+	std::vector<unsigned long> buffer (2 * PARTITION_FILE_BUFFER);
+	for (int partition = 0; partition < nb_partitions; partition++) {
+		BloomFilter * index = new_index(index_type, kmer_size, memory);
+		index->set_canonical(canonical);
+		KmerCounter * counter = NULL;
+		if (min_count > 1) {
+			counter = new KmerCounter (max_kmer, min_count);
+		}
+		unsigned long nb_kmers = 0;
+		size_t nb_read;
+		rewind(files[partition]);
+		while ((nb_read = fread(&buffer[0], 2 * sizeof(unsigned long), PARTITION_FILE_BUFFER, files[partition])) > 0) {
+			for (size_t j = 0; j < nb_read; j++) {
+				hash.set(buffer[2 * j], buffer[2 * j + 1]);
+				// Same count as feed_read
+				if (counter != NULL && counter->add(hash, false) < min_count) {
+					continue;
+				}
+				if (counter == NULL) {
+					index->feed(hash);
+					nb_kmers++;
+				} else if (index->feed_new(hash, false)) {
+					nb_kmers++;
+				}
+			}
+		}
+		if (ferror(files[partition])) {
+			std::cerr << "Cannot read temporary file " << file_names[partition] << " -> exit\n";
+			exit(1);
+		}
+		fclose(files[partition]);
+		remove(file_names[partition].c_str());
+		index->finalize();
+		index_file.add_chunk(index, partition == 0 ? nb_indexed_reads : 0);
+		delete index;
+		delete counter;
+		if (nb_kmers > max_partition_kmers) {
+			max_partition_kmers = nb_kmers;
+		}
+	}
+	if (max_partition_kmers > max_kmer) {
+		std::cerr << "Warning, a partition holds " << max_partition_kmers << " k-mers, more than the " << max_kmer << " k-mers of its share of the memory budget:";
+		std::cerr << " use a budget (-m) of at least " << (unsigned long) ((double) index_size(index_type, kmer_size, index_memory) * max_partition_kmers / max_kmer) << " bytes\n";
+	}
+	return nb_indexed_reads;
+}
+
+/* PartitionBatch holds the k-mers of a batch of query reads: the keys of
+ * the reads one after the other (forward strand from keys_start[read],
+ * reverse strand from reverse_start[read]), keya and keyb of each k-mer
+ * as in KmerKeys::get_keys, their positions in the read and their
+ * partitions. order gives the k-mers sorted by partition, those
+ * of partition p from partition_start[p], and hits the result of each one.
+ */
+struct PartitionBatch
+{
+	std::vector<int> files;
+	std::vector<unsigned long> read_pos;
+	std::vector<unsigned long> keys_start;
+	std::vector<unsigned long> reverse_start;
+	std::vector<unsigned long> keys;
+	std::vector<long> keys_pos;
+	std::vector<unsigned int> partitions;
+	std::vector<unsigned long> order;
+	std::vector<unsigned long> partition_start;
+	std::vector<char> hits;
+	
+	void clear ()
+	{
+		files.clear();
+		read_pos.clear();
+		keys_start.clear();
+		reverse_start.clear();
+		keys.clear();
+		keys_pos.clear();
+		partitions.clear();
+	}
+	
+	// Number of k-mers of the batch
+	unsigned long size () const {return keys_pos.size();}
+	
+	// Append the keys of one strand of a read, with the partitions of
+	// its k-mers
+	void add_keys (const std::vector<unsigned long> & read_keys, const std::vector<long> & read_keys_pos, const std::vector<unsigned int> & read_partitions)
+	{
+		keys.insert(keys.end(), read_keys.begin(), read_keys.end());
+		keys_pos.insert(keys_pos.end(), read_keys_pos.begin(), read_keys_pos.end());
+		partitions.insert(partitions.end(), read_partitions.begin(), read_partitions.end());
+	}
+	
+	// Sort the k-mers by partition (counting sort)
+	void sort (const int & nb_partitions)
+	{
+		partition_start.assign(nb_partitions + 1, 0);
+		for (size_t j = 0; j < partitions.size(); j++) {
+			partition_start[partitions[j] + 1]++;
+		}
+		for (int partition = 0; partition < nb_partitions; partition++) {
+			partition_start[partition + 1] += partition_start[partition];
+		}
+		order.resize(partitions.size());
+		std::vector<unsigned long> next (partition_start.begin(), partition_start.end() - 1);
+		for (size_t j = 0; j < partitions.size(); j++) {
+			order[next[partitions[j]]++] = j;
+		}
+		hits.assign(size(), 0);
+	}
+};
+
+/* search_partition_in checks in the index of a partition the k-mers of
+ * the batch it holds, prefetching them SEARCH_WINDOW k-mers ahead if the
+ * index does not stay in the cache.
+ */
+template <class Filter>
+void search_partition_in (const Filter * index, PartitionBatch & batch, const unsigned long & begin, const unsigned long & end, const int & kmer_size)
+{
+	const bool prefetch = index->get_size() >= SEARCH_PREFETCH_MIN_SIZE;
+	HashKey hash (kmer_size);
+	HashKey ahead (kmer_size);
+	for (unsigned long j = begin; j < end; j++) {
+		if (prefetch && j + SEARCH_WINDOW < end) {
+			const unsigned long k = batch.order[j + SEARCH_WINDOW];
+			ahead.set(batch.keys[2 * k], batch.keys[2 * k + 1]);
+			index->Filter::prefetch(ahead);
+		}
+		const unsigned long k = batch.order[j];
+		hash.set(batch.keys[2 * k], batch.keys[2 * k + 1]);
+		batch.hits[k] = index->Filter::is_found(hash);
+	}
+}
+
+void search_partition (const BloomFilter * index, PartitionBatch & batch, const int & partition, const int & kmer_size)
+{
+	const unsigned long begin = batch.partition_start[partition];
+	const unsigned long end = batch.partition_start[partition + 1];
+	if (begin == end) {
+		return;
+	}
+	if (index->get_type() == BLOCKED_INDEX) {
+		search_partition_in((const BlockedBloomFilter *) index, batch, begin, end, kmer_size);
+	} else if (index->get_type() == HASHED_INDEX) {
+		search_partition_in((const HashedBloomFilter *) index, batch, begin, end, kmer_size);
+	} else if (index->get_type() == EXACT_INDEX) {
+		search_partition_in((const ExactIndex *) index, batch, begin, end, kmer_size);
+	} else {
+		search_partition_in(index, batch, begin, end, kmer_size);
+	}
+}
+
+/* Data shared by the threads searching the partitions of the batches.
+ * The threads are started once and wait for each batch: for each one,
+ * every thread takes the next partition to search until none is left,
+ * and the last one to finish wakes the thread that gathers the batches.
+ * Everything but next_partition is protected by the mutex.
+ */
+struct PartitionThreadData
+{
+	const std::vector<BloomFilter *> * partitions;
+	PartitionBatch * batch;
+	int kmer_size;
+	pthread_mutex_t mutex;
+	pthread_cond_t batch_ready;
+	pthread_cond_t batch_done;
+	unsigned long nb_batches;
+	int next_partition;
+	int nb_busy_threads;
+	bool done;
+};
+
+void * search_partitions_thread (void * arg)
+{
+	PartitionThreadData * data = (PartitionThreadData *) arg;
+	const int nb_partitions = data->partitions->size();
+	unsigned long nb_batches = 0;
+	pthread_mutex_lock(&data->mutex);
+	while (true) {
+		while (!data->done && data->nb_batches == nb_batches) {
+			pthread_cond_wait(&data->batch_ready, &data->mutex);
+		}
+		if (data->done) {
+			break;
+		}
+		nb_batches = data->nb_batches;
+		pthread_mutex_unlock(&data->mutex);
+		while (true) {
+			const int partition = __atomic_fetch_add(&data->next_partition, 1, __ATOMIC_RELAXED);
+			if (partition >= nb_partitions) {
+				break;
+			}
+			search_partition((*data->partitions)[partition], *data->batch, partition, data->kmer_size);
+		}
+		pthread_mutex_lock(&data->mutex);
+		if (--data->nb_busy_threads == 0) {
+			pthread_cond_signal(&data->batch_done);
+		}
+	}
+	pthread_mutex_unlock(&data->mutex);
+	return NULL;
+}
+
+// Start nb_threads threads searching the partitions of the batches given
+// by search_partitions_batch
+void start_partition_threads (PartitionThreadData & data, std::vector<pthread_t> & threads, const std::vector<BloomFilter *> & partitions, PartitionBatch & batch, const int & kmer_size, const int & nb_threads)
+{
+	data.partitions = &partitions;
+	data.batch = &batch;
+	data.kmer_size = kmer_size;
+	pthread_mutex_init(&data.mutex, NULL);
+	pthread_cond_init(&data.batch_ready, NULL);
+	pthread_cond_init(&data.batch_done, NULL);
+	data.nb_batches = 0;
+	data.next_partition = 0;
+	data.nb_busy_threads = 0;
+	data.done = false;
+	threads.resize(nb_threads);
+	for (int i = 0; i < nb_threads; i++) {
+		if (pthread_create(&threads[i], NULL, search_partitions_thread, &data) != 0) {
+			std::cerr << "Cannot create search thread -> exit\n";
+			exit(1);
+		}
+	}
+}
+
+// Hand the batch to the threads and wait until all its partitions are
+// searched
+void search_partitions_batch (PartitionThreadData & data, const int & nb_threads)
+{
+	pthread_mutex_lock(&data.mutex);
+	data.next_partition = 0;
+	data.nb_busy_threads = nb_threads;
+	data.nb_batches++;
+	pthread_cond_broadcast(&data.batch_ready);
+	while (data.nb_busy_threads > 0) {
+		pthread_cond_wait(&data.batch_done, &data.mutex);
+	}
+	pthread_mutex_unlock(&data.mutex);
+}
+
+// Stop the threads once there is no batch left
+void stop_partition_threads (PartitionThreadData & data, std::vector<pthread_t> & threads)
+{
+	pthread_mutex_lock(&data.mutex);
+	data.done = true;
+	pthread_cond_broadcast(&data.batch_ready);
+	pthread_mutex_unlock(&data.mutex);
+	for (size_t i = 0; i < threads.size(); i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_cond_destroy(&data.batch_ready);
+	pthread_cond_destroy(&data.batch_done);
+	pthread_mutex_destroy(&data.mutex);
+}
+
+/* search_hits applies the rule of search_keys to the hits of the k-mers
+ * of one strand, from begin to end in the batch.
+ */
+bool search_hits (const PartitionBatch & batch, const unsigned long & begin, const unsigned long & end, const int & kmer_size, const int & min_hits)
+{
+	int seen = 0;
+	long next_pos = 0;
+	for (unsigned long j = begin; j < end; j++) {
+		if (batch.hits[j] && batch.keys_pos[j] >= next_pos) {
+			seen++;
+			if (seen >= min_hits) {
+				return true;
+			}
+			next_pos = batch.keys_pos[j] + kmer_size;
+		}
+	}
+	return false;
+}
+
+/* search_reads_partitioned tags the reads of search_file_manager found in
+ * the partitioned index of index_file and returns the number of found
+ * reads, as search_reads does with an index of one chunk.
+ *
+ * The reads are read once, by batches of at least PARTITION_BATCH_SIZE
+ * k-mers. With nb_threads > 1, the partitions of each batch are searched
+ * by nb_threads threads started once (see PartitionThreadData). The k-mers
+ * are sampled as given by the index file.
+ */
+unsigned long search_reads_partitioned (const IndexFile * index_file, FileManager * search_file_manager, const int & kmer_size, const int & min_hits, unsigned long & nb_searched_reads, const int & nb_threads = 1)
+{
+	const int nb_partitions = index_file->get_nb_chunks();
+	const bool canonical = index_file->is_canonical();
+	std::vector<BloomFilter *> partitions (nb_partitions);
+	unsigned long nb_indexed_reads = 0;
+	for (int partition = 0; partition < nb_partitions; partition++) {
+		partitions[partition] = index_file->get_chunk(partition, nb_indexed_reads);
+	}
+	MinimizerPartitioner partitioner (kmer_size, index_file->get_minimizer_size(), nb_partitions);
+	KmerSampler sampler (kmer_size, index_file->get_sampling());
+	ReadKeys read_keys (kmer_size);
+	std::vector<unsigned int> read_partitions;
+	PartitionBatch batch;
+	PartitionThreadData data;
+	std::vector<pthread_t> threads;
+	if (nb_threads > 1) {
+		start_partition_threads(data, threads, partitions, batch, kmer_size, nb_threads);
+	}
+	
+	nb_searched_reads = 0;
+	unsigned long nb_found_reads = 0;
+	search_file_manager->rewind();
+	std::string & current_read_to_search = search_file_manager->get_next_read_to_compare();
+	while (!current_read_to_search.empty()) {
+		// Gather the k-mers of the next reads
+		batch.clear();
+		while (!current_read_to_search.empty() && batch.size() < PARTITION_BATCH_SIZE) {
+			nb_searched_reads++;
+			batch.files.push_back(search_file_manager->get_current_file());
+			batch.read_pos.push_back(search_file_manager->get_current_read_pos());
+			const char * sampled = sampler.sample(current_read_to_search);
+			get_read_keys(read_keys, current_read_to_search, canonical, sampled);
+			partitioner.get_partitions(current_read_to_search, read_partitions, sampled);
+			batch.keys_start.push_back(batch.size());
+			batch.add_keys(read_keys.forward, read_keys.forward_pos, read_partitions);
+			batch.reverse_start.push_back(batch.size());
+			if (!canonical) {
+				// The reverse complement of a k-mer is in the same partition
+				batch.add_keys(read_keys.reverse, read_keys.reverse_pos, read_partitions);
+			}
+			current_read_to_search = search_file_manager->get_next_read_to_compare();
+		}
+		batch.keys_start.push_back(batch.size());
+		
+		// Search each partition for its k-mers
+		batch.sort(nb_partitions);
+		if (nb_threads > 1) {
+			search_partitions_batch(data, nb_threads);
+		} else {
+			for (int partition = 0; partition < nb_partitions; partition++) {
+				search_partition(partitions[partition], batch, partition, kmer_size);
+			}
+		}
+		
+		// Count the hits of each read
+		for (size_t read = 0; read < batch.files.size(); read++) {
+			if (search_hits(batch, batch.keys_start[read], batch.reverse_start[read], kmer_size, min_hits)
+				|| search_hits(batch, batch.reverse_start[read], batch.keys_start[read + 1], kmer_size, min_hits)) {
+				search_file_manager->tag_read(batch.files[read], batch.read_pos[read]);
+				nb_found_reads++;
+			}
+		}
+	}
+	if (nb_threads > 1) {
+		stop_partition_threads(data, threads);
+	}
+	for (int partition = 0; partition < nb_partitions; partition++) {
+		delete partitions[partition];
+	}
+	return nb_found_reads;
+}
+
+#endif
@@ -28,6 +28,7 @@
 #define __READ_FILE_H__
 
 #include "boolean_vector.h"
+#include "read_index.h"
 
 //
 // Interface to files handling reads
@@ -36,14 +37,18 @@ class ReadFile
 {
 protected:
 	std::string fname;
-	std::string current_read_data;
+	mutable std::string current_read_data;
 	std::string current_read_seq;
 	unsigned long _nb_valid_reads;
 	unsigned long _cnt_valid_reads;
 	unsigned long current_read_pos;
+	// Position in the file (uncompressed) of the first line of the
+	// current read
+	unsigned long current_read_offset;
 	unsigned long nb_reads;
 	BooleanVector bv;
 	bool first_read;
+	ReadIndex read_index;
 public:
 	virtual ~ReadFile () {};
 	virtual std::string & get_next_read () = 0;
@@ -57,6 +62,7 @@ public:
 	virtual void save (const std::string & directory, const std::string & suffix) = 0;
 	virtual const unsigned long & get_nb_reads() const {return nb_reads;}
 	virtual const unsigned long & get_read_pos() const {return current_read_pos;}
+	virtual const unsigned long & get_read_offset() const {return current_read_offset;}
 	virtual void tag (const unsigned long & pos) = 0;
 	virtual void untag (const unsigned long & pos) = 0;
 	virtual void set_bv_comment (const std::string & str) = 0;
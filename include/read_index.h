@@ -0,0 +1,216 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef READ_INDEX_H_
+#define READ_INDEX_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// First bytes of a read index file
+#define READ_INDEX_MAGIC "COMMETRI"
+// Version of the read index file format, and of the way reads are
+// counted: 2 skips the empty lines of gzipped FASTQ files too, 3 stamps
+// the read file with a FileStamp
+#define READ_INDEX_VERSION 3
+// One offset is kept every READ_INDEX_STEP reads: the readers jump to
+// the indexed read before the next selected read, and parse at most
+// READ_INDEX_STEP - 1 unselected reads (2 bits per read in memory)
+#define READ_INDEX_STEP 32
+
+/*
+ * FileStamp identifies the content of a file by its size, its inode, and
+ * its modification and status change times to the nanosecond: a file
+ * rewritten within the same second with the same size, or replaced by
+ * another file, gets another stamp. It is written as is in the read index
+ * and packed read files (6 numbers of 8 bytes).
+ */
+struct FileStamp
+{
+	unsigned long size;
+	unsigned long inode;
+	long modification_sec;
+	long modification_nsec;
+	long change_sec;
+	long change_nsec;
+	
+	FileStamp ()
+	{
+		size = inode = 0;
+		modification_sec = modification_nsec = change_sec = change_nsec = 0;
+	}
+	
+	explicit FileStamp (const struct stat & info)
+	{
+		size = info.st_size;
+		inode = info.st_ino;
+		modification_sec = info.st_mtim.tv_sec;
+		modification_nsec = info.st_mtim.tv_nsec;
+		change_sec = info.st_ctim.tv_sec;
+		change_nsec = info.st_ctim.tv_nsec;
+	}
+	
+	bool operator== (const FileStamp & other) const
+	{
+		return size == other.size && inode == other.inode
+			&& modification_sec == other.modification_sec && modification_nsec == other.modification_nsec
+			&& change_sec == other.change_sec && change_nsec == other.change_nsec;
+	}
+	
+	bool operator!= (const FileStamp & other) const {return !(*this == other);}
+};
+
+/*
+ * Read index file (<read file>.cidx), written next to a read file the
+ * first time it is opened, so that the next openings do not read the
+ * whole file to count its reads (see FastaFile, FastqFile, GzFastaFile
+ * and GzFastqFile).
+ *
+ *   char[8]  READ_INDEX_MAGIC
+ *   uint32   READ_INDEX_VERSION
+ *   uint32   READ_INDEX_STEP
+ *   FileStamp of the read file (size, inode, times)
+ *   uint64   number of reads
+ *   uint64   number of offsets, one every READ_INDEX_STEP reads
+ *   uint64[] offset of the first line of reads 0, READ_INDEX_STEP, ...
+ *            (in the uncompressed data for a gzipped file)
+ *
+ * The index is only trusted if the stamp of the read file did not change
+ * since it was written. It is optional:
+ * when it cannot be written (read-only directory), the reads are counted
+ * at each opening as before.
+ *
+ * Numbers are written in the byte order of the machine.
+ */
+class ReadIndex
+{
+private:
+	std::string index_name;
+	// The read file is a regular file, of this stamp
+	bool regular;
+	FileStamp file_stamp;
+	std::vector<unsigned long> offsets;
+	
+	static bool read_value (FILE * file, void * value, const size_t & size)
+	{
+		return fread(value, size, 1, file) == 1;
+	}
+	
+public:
+	ReadIndex ()
+	{
+		regular = false;
+	}
+	
+	// Load the index of the read file and set nb_reads from it. Return
+	// false if there is no valid index: the reads must then be counted,
+	// giving their offsets to add_read, and the index saved
+	bool load (const std::string & file_name, unsigned long & nb_reads)
+	{
+		index_name = file_name + ".cidx";
+		offsets.clear();
+		struct stat info;
+		regular = stat(file_name.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+		if (!regular) {
+			return false;
+		}
+		file_stamp = FileStamp (info);
+		FILE * file = fopen(index_name.c_str(), "rb");
+		if (file == NULL) {
+			return false;
+		}
+		char magic[8];
+		unsigned int version, step;
+		unsigned long nb_offsets;
+		FileStamp stamp;
+		bool valid = read_value(file, magic, 8) && memcmp(magic, READ_INDEX_MAGIC, 8) == 0
+			&& read_value(file, &version, sizeof(version)) && version == READ_INDEX_VERSION
+			&& read_value(file, &step, sizeof(step)) && step == READ_INDEX_STEP
+			&& read_value(file, &stamp, sizeof(stamp)) && stamp == file_stamp
+			&& read_value(file, &nb_reads, sizeof(nb_reads))
+			&& read_value(file, &nb_offsets, sizeof(nb_offsets))
+			&& nb_offsets == (nb_reads + READ_INDEX_STEP - 1) / READ_INDEX_STEP;
+		if (valid && nb_offsets > 0) {
+			offsets.resize(nb_offsets);
+			valid = fread(&offsets[0], sizeof(unsigned long), nb_offsets, file) == nb_offsets;
+		}
+		fclose(file);
+		if (!valid) {
+			offsets.clear();
+		}
+		return valid;
+	}
+	
+	// Give the offset of the first line of a read while counting them
+	void add_read (const unsigned long & read, const unsigned long & offset)
+	{
+		if (read % READ_INDEX_STEP == 0 && read / READ_INDEX_STEP == offsets.size()) {
+			offsets.push_back(offset);
+		}
+	}
+	
+	// Write the index of the counted reads. It is written in a temporary
+	// file then renamed, so that a process opening the same read file
+	// never reads a partial index. Any failure only leaves no index.
+	void save (const unsigned long & nb_reads)
+	{
+		if (!regular) {
+			return;
+		}
+		offsets.resize(std::min(offsets.size(), (nb_reads + READ_INDEX_STEP - 1) / READ_INDEX_STEP));
+		std::stringstream tmp_name;
+		tmp_name << index_name << "." << getpid();
+		FILE * file = fopen(tmp_name.str().c_str(), "wb");
+		if (file == NULL) {
+			return;
+		}
+		const unsigned int version = READ_INDEX_VERSION;
+		const unsigned int step = READ_INDEX_STEP;
+		const unsigned long nb_offsets = offsets.size();
+		bool written = fwrite(READ_INDEX_MAGIC, 8, 1, file) == 1
+			&& fwrite(&version, sizeof(version), 1, file) == 1
+			&& fwrite(&step, sizeof(step), 1, file) == 1
+			&& fwrite(&file_stamp, sizeof(file_stamp), 1, file) == 1
+			&& fwrite(&nb_reads, sizeof(nb_reads), 1, file) == 1
+			&& fwrite(&nb_offsets, sizeof(nb_offsets), 1, file) == 1
+			&& (nb_offsets == 0 || fwrite(&offsets[0], sizeof(unsigned long), nb_offsets, file) == nb_offsets);
+		written = fclose(file) == 0 && written;
+		if (!written || rename(tmp_name.str().c_str(), index_name.c_str()) != 0) {
+			remove(tmp_name.str().c_str());
+		}
+	}
+	
+	// Offsets of the reads 0, READ_INDEX_STEP, 2 * READ_INDEX_STEP...
+	const std::vector<unsigned long> & get_offsets () const {return offsets;}
+};
+
+#endif
@@ -28,63 +28,555 @@
 #define SEARCH_READS_H_
 
 #include "bloom_filter.h"
+#include "blocked_bloom_filter.h"
+#include "hashed_bloom_filter.h"
+#include "exact_index.h"
+#include "sliced_bloom_filter.h"
+#include "kmer_sampler.h"
 #include "file_manager.h"
+#include "boolean_vector.h"
 #include "alphabet.h"
+#include "kmer_keys.h"
 
-unsigned long search_reads (const BloomFilter * index, FileManager * search_file_manager, const int & kmer_size, const int & min_hits, unsigned long & nb_searched_reads)
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+
+// Minimal number of reads given at once to a search thread
+#define SEARCH_BATCH_SIZE 4096
+
+// Number of k-mers hashed and prefetched before checking them in the index
+#define SEARCH_WINDOW 16
+
+// Minimal size of the index (in bytes) to search it by prefetched windows.
+// Smaller indexes mostly stay in the cache and are searched k-mer by k-mer.
+#define SEARCH_PREFETCH_MIN_SIZE (1L << 26)
+
+/* search_strand_direct searches the k-mers of one strand of the read,
+ * checking each k-mer in the index as soon as its hash key is computed.
+ * The hash key is cleared after a hit so that hits do not overlap.
+ *
+ * Key gives the key of each k-mer of the strand (see hash_key.h).
+ * sampled, if not NULL, gives the k-mers to check (see kmer_sampler.h).
+ */
+template <class Filter, class Key>
+bool search_strand_direct (const Filter * index, Key hash, std::string & read, const int & kmer_size, const int & min_hits, const char * sampled)
+{
+	const int size = Key::size(kmer_size);
+	int seen = 0;
+	hash.clear();
+	for (long i = 0; i < (long) read.size(); i++) {
+		// add() clears the key on a char that is not a nucleotide
+		if (hash.add(read[i]) >= size && (sampled == NULL || sampled[i]) && index->Filter::is_found(hash.key())) {
+			seen++;
+			if (seen >= min_hits) {
+				return true;
+			}
+			hash.clear();
+		}
+	}
+	return false;
+}
+
+/* search_strand searches the k-mers of one strand of the read, by windows
+ * of SEARCH_WINDOW k-mers: the hash keys of the window are computed and
+ * prefetched in the index, then they are checked in order. This way the
+ * memory accesses of the window overlap instead of waiting for each other.
+ *
+ * After a hit, the next k-mer to check must not overlap the found one,
+ * as when the hash key was cleared after a hit.
+ *
+ * Filter is the real class of the index: the qualified calls
+ * index->Filter::is_found are not virtual and can be inlined.
+ */
+template <class Filter, class Key>
+bool search_strand (const Filter * index, Key hash, HashKey * window, long * window_pos, std::string & read, const int & kmer_size, const int & min_hits, const char * sampled)
+{
+	const int size = Key::size(kmer_size);
+	int seen = 0;
+	long next_pos = 0;
+	long i = 0;
+	hash.clear();
+	while (i < (long) read.size()) {
+		// Compute and prefetch the keys of the window
+		int window_size = 0;
+		for (; i < (long) read.size() && window_size < SEARCH_WINDOW; i++) {
+			if (hash.add(read[i]) >= size && i >= next_pos && (sampled == NULL || sampled[i])) {
+				window[window_size] = hash.key();
+				window_pos[window_size] = i;
+				index->Filter::prefetch(hash.key());
+				window_size++;
+			}
+		}
+		// Check the keys of the window
+		for (int j = 0; j < window_size; j++) {
+			if (window_pos[j] >= next_pos && index->Filter::is_found(window[j])) {
+				seen++;
+				if (seen >= min_hits) {
+					return true;
+				}
+				next_pos = window_pos[j] + size;
+			}
+		}
+	}
+	return false;
+}
+
+/* search_read_in searches the read with the keys given by Key, directly or
+ * by windows if the index is too large to stay in the cache.
+ */
+template <class Filter, class Key>
+bool search_read_in (const Filter * index, Key hash, HashKey * window, long * window_pos, std::string & read, const int & kmer_size, const int & min_hits, const char * sampled)
+{
+	if (index->get_size() < SEARCH_PREFETCH_MIN_SIZE) {
+		return search_strand_direct(index, hash, read, kmer_size, min_hits, sampled);
+	}
+	return search_strand(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+}
+
+/* search_keys checks the keys of one strand in the index, as search_strand
+ * does: a hit at position i skips the k-mers overlapping it.
+ * With prefetch, the keys are prefetched SEARCH_WINDOW k-mers ahead.
+ */
+template <class Filter>
+bool search_keys (const Filter * index, const std::vector<unsigned long> & keys, const std::vector<long> & keys_pos, const int & kmer_size, const int & min_hits, const bool & prefetch)
+{
+	HashKey hash (kmer_size);
+	HashKey ahead (kmer_size);
+	int seen = 0;
+	long next_pos = 0;
+	for (size_t j = 0; j < keys_pos.size(); j++) {
+		if (prefetch && j + SEARCH_WINDOW < keys_pos.size()) {
+			ahead.set(keys[2 * (j + SEARCH_WINDOW)], keys[2 * (j + SEARCH_WINDOW) + 1]);
+			index->Filter::prefetch(ahead);
+		}
+		if (keys_pos[j] < next_pos) {
+			continue;
+		}
+		hash.set(keys[2 * j], keys[2 * j + 1]);
+		if (index->Filter::is_found(hash)) {
+			seen++;
+			if (seen >= min_hits) {
+				return true;
+			}
+			next_pos = keys_pos[j] + kmer_size;
+		}
+	}
+	return false;
+}
+
+/* search_read_in searches the forward strand of the read then, if not
+ * found, its reverse strand.
+ */
+template <class Filter, int K>
+bool search_read_in (const Filter * index, HashKey & hash, HashKey * window, long * window_pos, std::string & read, const int & kmer_size, const int & min_hits, const char * sampled)
+{
+	return search_read_in(index, ForwardKey<K>(hash), window, window_pos, read, kmer_size, min_hits, sampled)
+		|| search_read_in(index, ReverseKey<K>(hash), window, window_pos, read, kmer_size, min_hits, sampled);
+}
+
+// The loops compiled for the usual sizes of k-mers (see ForwardKey)
+// A canonical index is searched with the keys of the whole read, both
+// strands at once (see search_read_keys)
+template <class Filter>
+bool search_read_in (const Filter * index, HashKey & hash, ReadKeys & read_keys, HashKey * window, long * window_pos, std::string & read, const int & kmer_size, const int & min_hits, const char * sampled)
+{
+	if (index->is_canonical()) {
+		get_read_keys(read_keys, read, true, sampled);
+		return search_keys(index, read_keys.forward, read_keys.forward_pos, kmer_size, min_hits, index->get_size() >= SEARCH_PREFETCH_MIN_SIZE);
+	}
+	switch (kmer_size) {
+		case 21: return search_read_in<Filter, 21>(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+		case 25: return search_read_in<Filter, 25>(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+		case 27: return search_read_in<Filter, 27>(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+		case 31: return search_read_in<Filter, 31>(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+		case 33: return search_read_in<Filter, 33>(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+	}
+	return search_read_in<Filter, 0>(index, hash, window, window_pos, read, kmer_size, min_hits, sampled);
+}
+
+/* search_read returns true if the read shares at least min_hits non
+ * overlapping k-mers with the index, on the forward strand or, if not
+ * found, on the reverse strand.
+ * With a canonical index, the hits of both strands are counted together
+ * in a single pass over the keys of the read, computed in read_keys.
+ * window and window_pos are buffers of SEARCH_WINDOW elements.
+ * sampler, if given, chooses the k-mers to search (see kmer_sampler.h).
+ */
+bool search_read (const BloomFilter * index, HashKey & hash, ReadKeys & read_keys, HashKey * window, long * window_pos, std::string & read, const int & kmer_size, const int & min_hits, KmerSampler * sampler = NULL)
+{
+	const char * sampled = sampler != NULL ? sampler->sample(read) : NULL;
+	if (index->get_type() == BLOCKED_INDEX) {
+		return search_read_in((const BlockedBloomFilter *) index, hash, read_keys, window, window_pos, read, kmer_size, min_hits, sampled);
+	} else if (index->get_type() == HASHED_INDEX) {
+		return search_read_in((const HashedBloomFilter *) index, hash, read_keys, window, window_pos, read, kmer_size, min_hits, sampled);
+	} else if (index->get_type() == EXACT_INDEX) {
+		return search_read_in((const ExactIndex *) index, hash, read_keys, window, window_pos, read, kmer_size, min_hits, sampled);
+	}
+	return search_read_in(index, hash, read_keys, window, window_pos, read, kmer_size, min_hits, sampled);
+}
+
+template <class Filter>
+bool search_read_keys_in (const Filter * index, const ReadKeys & read_keys, const int & kmer_size, const int & min_hits, const bool & prefetch)
+{
+	return search_keys(index, read_keys.forward, read_keys.forward_pos, kmer_size, min_hits, prefetch)
+		|| (!index->is_canonical() && search_keys(index, read_keys.reverse, read_keys.reverse_pos, kmer_size, min_hits, prefetch));
+}
+
+// search_read_keys is search_read with the keys of the read already computed
+bool search_read_keys (const BloomFilter * index, const ReadKeys & read_keys, const int & kmer_size, const int & min_hits, const bool & prefetch)
+{
+	if (index->get_type() == BLOCKED_INDEX) {
+		return search_read_keys_in((const BlockedBloomFilter *) index, read_keys, kmer_size, min_hits, prefetch);
+	} else if (index->get_type() == HASHED_INDEX) {
+		return search_read_keys_in((const HashedBloomFilter *) index, read_keys, kmer_size, min_hits, prefetch);
+	} else if (index->get_type() == EXACT_INDEX) {
+		return search_read_keys_in((const ExactIndex *) index, read_keys, kmer_size, min_hits, prefetch);
+	}
+	return search_read_keys_in(index, read_keys, kmer_size, min_hits, prefetch);
+}
+
+/* Indexes of a colored search: one index per indexed set of reads, NULL
+ * for a set with no more chunk to search. The reads found in index i are
+ * tagged in colors[i], one boolean vector per searched file.
+ * The indexes are searched in turn for each read, so they are prefetched
+ * as soon as they do not fit together in the cache.
+ * With a bit-sliced index, all the indexes are the slices of sliced.
+ */
+struct ColoredIndexes
+{
+	std::vector<const BloomFilter *> indexes;
+	std::vector< std::vector<BooleanVector> > colors;
+	const SlicedBloomFilter * sliced;
+	bool prefetch;
+};
+
+/* search_keys_sliced checks the keys of one strand in the bit-sliced index
+ * for the colors of searched, with the rule of search_keys for each color.
+ * The colors found are removed from searched and added to found.
+ */
+void search_keys_sliced (const SlicedBloomFilter * index, const std::vector<unsigned long> & keys, const std::vector<long> & keys_pos, const int & kmer_size, const int & min_hits, const bool & prefetch, ReadKeys & read_keys)
+{
+	HashKey hash (kmer_size);
+	HashKey ahead (kmer_size);
+	const int row_words = index->get_row_words();
+	unsigned long * searched = &read_keys.searched[0];
+	unsigned long * row = &read_keys.row[0];
+	std::fill(read_keys.seen.begin(), read_keys.seen.end(), 0);
+	std::fill(read_keys.next_pos.begin(), read_keys.next_pos.end(), 0);
+	for (size_t j = 0; j < keys_pos.size(); j++) {
+		if (prefetch && j + SEARCH_WINDOW < keys_pos.size()) {
+			ahead.set(keys[2 * (j + SEARCH_WINDOW)], keys[2 * (j + SEARCH_WINDOW) + 1]);
+			index->prefetch(ahead);
+		}
+		hash.set(keys[2 * j], keys[2 * j + 1]);
+		if (!index->get_colors(hash, row)) {
+			continue;
+		}
+		unsigned long remaining = 0;
+		for (int word = 0; word < row_words; word++) {
+			unsigned long hits = row[word] & searched[word];
+			while (hits != 0) {
+				const unsigned long bit = hits & -hits;
+				const int color = 64 * word + __builtin_ctzl(hits);
+				hits ^= bit;
+				if (keys_pos[j] >= read_keys.next_pos[color]) {
+					read_keys.next_pos[color] = keys_pos[j] + kmer_size;
+					if (++read_keys.seen[color] >= min_hits) {
+						searched[word] ^= bit;
+						read_keys.found[word] |= bit;
+					}
+				}
+			}
+			remaining |= searched[word];
+		}
+		if (remaining == 0) {
+			return;
+		}
+	}
+}
+
+/* search_read_sliced is search_read_colors with a bit-sliced index: the
+ * read is searched in all its colors at once, one probe per k-mer.
+ */
+bool search_read_sliced (ColoredIndexes * colored, std::vector<unsigned long> & nb_searched_reads, std::vector<unsigned long> & nb_found_reads, ReadKeys & read_keys, KmerSampler * sampler, std::string & read, const int & file, const unsigned long & pos, const int & kmer_size, const int & min_hits)
+{
+	const SlicedBloomFilter * index = colored->sliced;
+	const int nb_colors = index->get_nb_colors();
+	read_keys.searched.assign(index->get_row_words(), 0);
+	read_keys.found.assign(index->get_row_words(), 0);
+	read_keys.row.resize(index->get_row_words());
+	read_keys.seen.resize(nb_colors);
+	read_keys.next_pos.resize(nb_colors);
+	bool empty = true;
+	for (int color = 0; color < nb_colors; color++) {
+		if (colored->indexes[color] != NULL && !colored->colors[color][file].is_set(pos)) {
+			read_keys.searched[color / 64] |= 1UL << (color % 64);
+			nb_searched_reads[color]++;
+			empty = false;
+		}
+	}
+	if (empty) {
+		return true;
+	}
+	get_read_keys(read_keys, read, index->is_canonical(), sampler->sample(read));
+	search_keys_sliced(index, read_keys.forward, read_keys.forward_pos, kmer_size, min_hits, colored->prefetch, read_keys);
+	if (!index->is_canonical()) {
+		search_keys_sliced(index, read_keys.reverse, read_keys.reverse_pos, kmer_size, min_hits, colored->prefetch, read_keys);
+	}
+	bool found_in_all = true;
+	for (int color = 0; color < nb_colors; color++) {
+		if (read_keys.found[color / 64] & (1UL << (color % 64))) {
+			colored->colors[color][file].set(pos);
+			nb_found_reads[color]++;
+		} else if (colored->indexes[color] != NULL && !colored->colors[color][file].is_set(pos)) {
+			found_in_all = false;
+		}
+	}
+	return found_in_all;
+}
+
+/* search_read_colors hashes the read once and searches it in each index
+ * in which it was not found yet. It counts the read in nb_searched_reads
+ * of these indexes, tags it in the colors of the indexes that find it,
+ * counts it in their nb_found_reads, and returns true if the read is now
+ * found in every index, so that it is not searched again.
+ * sampler chooses the k-mers to search (see kmer_sampler.h).
+ */
+bool search_read_colors (ColoredIndexes * colored, std::vector<unsigned long> & nb_searched_reads, std::vector<unsigned long> & nb_found_reads, ReadKeys & read_keys, KmerSampler * sampler, std::string & read, const int & file, const unsigned long & pos, const int & kmer_size, const int & min_hits)
+{
+	if (colored->sliced != NULL) {
+		return search_read_sliced(colored, nb_searched_reads, nb_found_reads, read_keys, sampler, read, file, pos, kmer_size, min_hits);
+	}
+	bool found_in_all = true;
+	bool hashed = false;
+	for (size_t color = 0; color < colored->indexes.size(); color++) {
+		const BloomFilter * index = colored->indexes[color];
+		if (index == NULL || colored->colors[color][file].is_set(pos)) {
+			continue;
+		}
+		if (!hashed) {
+			get_read_keys(read_keys, read, index->is_canonical(), sampler->sample(read));
+			hashed = true;
+		}
+		nb_searched_reads[color]++;
+		if (search_read_keys(index, read_keys, kmer_size, min_hits, colored->prefetch)) {
+			colored->colors[color][file].set(pos);
+			nb_found_reads[color]++;
+		} else {
+			found_in_all = false;
+		}
+	}
+	return found_in_all;
+}
+
+/* Data shared by the search threads.
+ * Everything but the index is protected by the mutex.
+ * With colored indexes, index is NULL.
+ */
+struct SearchThreadData
+{
+	const BloomFilter * index;
+	ColoredIndexes * colored;
+	FileManager * file_manager;
+	int kmer_size;
+	int min_hits;
+	KmerSampling sampling;
+	pthread_mutex_t mutex;
+	std::string * current_read;
+	unsigned long * nb_searched_reads;
+	unsigned long nb_found_reads;
+	std::vector<unsigned long> nb_colored_searched_reads;
+	std::vector<unsigned long> nb_colored_found_reads;
+};
+
+/* search_reads_thread is run by each search thread.
+ *
+ * Under the mutex, the thread takes a batch of reads with their file and
+ * position. A batch always ends on a byte boundary of the boolean vector
+ * (or on a file change), so that each thread tags its found reads in its
+ * own range of bytes of the per-file boolean vectors, without lock.
+ * This also holds for the boolean vectors of colored indexes.
+ */
+void * search_reads_thread (void * arg)
+{
+	SearchThreadData * data = (SearchThreadData *) arg;
+	FileManager * file_manager = data->file_manager;
+	HashKey hash (data->kmer_size);
+	KmerSampler sampler (data->kmer_size, data->sampling);
+	std::vector<HashKey> window (SEARCH_WINDOW, hash);
+	std::vector<long> window_pos (SEARCH_WINDOW);
+	std::vector<std::string> batch;
+	std::vector<int> batch_files;
+	std::vector<unsigned long> batch_pos;
+	unsigned long nb_found_reads = 0;
+	ReadKeys read_keys (data->kmer_size);
+	std::vector<unsigned long> nb_colored_searched_reads (data->nb_colored_searched_reads.size(), 0);
+	std::vector<unsigned long> nb_colored_found_reads (data->nb_colored_found_reads.size(), 0);
+	while (true) {
+		int batch_size = 0;
+		pthread_mutex_lock(&data->mutex);
+		while (!data->current_read->empty()) {
+			int file = file_manager->get_current_file();
+			unsigned long pos = file_manager->get_current_read_pos();
+			if (batch_size >= SEARCH_BATCH_SIZE && (file != batch_files[batch_size - 1] || pos / 8 != batch_pos[batch_size - 1] / 8)) {
+				break;
+			}
+			if (batch_size == (int) batch.size()) {
+				batch.push_back(std::string());
+				batch_files.push_back(0);
+				batch_pos.push_back(0);
+			}
+			batch[batch_size].swap(*data->current_read);
+			batch_files[batch_size] = file;
+			batch_pos[batch_size] = pos;
+			batch_size++;
+			(*data->nb_searched_reads)++;
+			*data->current_read = file_manager->get_next_read_to_compare();
+		}
+		pthread_mutex_unlock(&data->mutex);
+		if (batch_size == 0) {
+			break;
+		}
+		for (int read_pos = 0; read_pos < batch_size; read_pos++) {
+			if (data->colored != NULL) {
+				if (search_read_colors(data->colored, nb_colored_searched_reads, nb_colored_found_reads, read_keys, &sampler, batch[read_pos], batch_files[read_pos], batch_pos[read_pos], data->kmer_size, data->min_hits)) {
+					file_manager->tag_read(batch_files[read_pos], batch_pos[read_pos]);
+				}
+			} else if (search_read(data->index, hash, read_keys, &window[0], &window_pos[0], batch[read_pos], data->kmer_size, data->min_hits, &sampler)) {
+				file_manager->tag_read(batch_files[read_pos], batch_pos[read_pos]);
+				nb_found_reads++;
+			}
+		}
+	}
+	pthread_mutex_lock(&data->mutex);
+	data->nb_found_reads += nb_found_reads;
+	for (size_t color = 0; color < nb_colored_found_reads.size(); color++) {
+		data->nb_colored_searched_reads[color] += nb_colored_searched_reads[color];
+		data->nb_colored_found_reads[color] += nb_colored_found_reads[color];
+	}
+	pthread_mutex_unlock(&data->mutex);
+	return NULL;
+}
+
+// Run the search threads on the shared data
+void run_search_threads (SearchThreadData & data, const int & nb_threads)
+{
+	pthread_mutex_init(&data.mutex, NULL);
+	std::vector<pthread_t> threads (nb_threads);
+	for (int i = 0; i < nb_threads; i++) {
+		if (pthread_create(&threads[i], NULL, search_reads_thread, &data) != 0) {
+			std::cerr << "Cannot create search thread -> exit\n";
+			exit(1);
+		}
+	}
+	for (int i = 0; i < nb_threads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&data.mutex);
+}
+
+/* search_reads tags the reads of search_file_manager found in the index
+ * and returns the number of found reads.
+ *
+ * With nb_threads > 1, reads are searched by batches in several threads
+ * sharing the same read-only index.
+ *
+ * With a sampling, only the sampled k-mers are searched, as they are the
+ * only ones indexed (see kmer_sampler.h).
+ */
+unsigned long search_reads (const BloomFilter * index, FileManager * search_file_manager, const int & kmer_size, const int & min_hits, unsigned long & nb_searched_reads, const int & nb_threads = 1, const KmerSampling & sampling = KmerSampling ())
 {
 	// Search reads from search_file_manager in the indexed reads
 	HashKey hash (kmer_size);
-	Alphabet * alphabet = Alphabet::getInstance();
+	ReadKeys read_keys (kmer_size);
+	KmerSampler sampler (kmer_size, sampling);
+	std::vector<HashKey> window (SEARCH_WINDOW, hash);
+	std::vector<long> window_pos (SEARCH_WINDOW);
 	nb_searched_reads = 0;
 	unsigned long nb_found_reads = 0;
 	search_file_manager->rewind();
 	std::string & current_read_to_search = search_file_manager->get_next_read_to_compare();
+	if (nb_threads > 1) {
+		SearchThreadData data;
+		data.index = index;
+		data.colored = NULL;
+		data.file_manager = search_file_manager;
+		data.kmer_size = kmer_size;
+		data.min_hits = min_hits;
+		data.sampling = sampling;
+		data.current_read = &current_read_to_search;
+		data.nb_searched_reads = &nb_searched_reads;
+		data.nb_found_reads = 0;
+		run_search_threads(data, nb_threads);
+		return data.nb_found_reads;
+	}
 	while (!current_read_to_search.empty()) {
 		nb_searched_reads++;
-		// Search k-mers
-		int seen = 0;
-		bool found = false;
-		hash.clear();
-		for (long i = 0; i < (int) current_read_to_search.size() && !found; i++) {
-			if (!alphabet->is_in(current_read_to_search[i])) {
-				hash.clear();
-			} else if (hash.add(current_read_to_search[i]) >= kmer_size) {
-				if (index->is_found(hash)) {
-					seen++;
-					if (seen >= min_hits) {
-						search_file_manager->tag_current_read();
-						nb_found_reads++;
-						found = true;
-					}
-					hash.clear();
-				}
-			}
-		}
-		// Search the reverse strand if not found in the first step
-		if (!found) {
-			seen = 0;
-			hash.clear();
-			for (long i = 0; i < (int) current_read_to_search.size() && !found; i++) {
-				if (!alphabet->is_in(current_read_to_search[i])) {
-					hash.clear();
-				} else if (hash.rv_add(current_read_to_search[i]) >= kmer_size) {
-					if (index->is_found(hash)) {
-						seen++;
-						if (seen >= min_hits) {
-							search_file_manager->tag_current_read();
-							nb_found_reads++;
-							found = true;
-						}
-						hash.clear();
-					}
-				}
-			}
+		if (search_read(index, hash, read_keys, &window[0], &window_pos[0], current_read_to_search, kmer_size, min_hits, &sampler)) {
+			search_file_manager->tag_current_read();
+			nb_found_reads++;
 		}
 		current_read_to_search = search_file_manager->get_next_read_to_compare();
 	}
 	return nb_found_reads;
 }
 
+/* search_reads_colors searches the reads of search_file_manager in all the
+ * indexes of colored at once: each read is read and hashed once, then its
+ * keys are checked in each index. The reads found in index i are tagged in
+ * colored->colors[i] and counted in nb_found_reads[i]. The reads found in
+ * every index are tagged in search_file_manager, so that the next chunks
+ * skip them. As with search_reads, nb_searched_reads[i] is the number of
+ * reads searched in the current chunk of index i, and nb_read_reads the
+ * number of reads read from the files.
+ */
+void search_reads_colors (ColoredIndexes * colored, FileManager * search_file_manager, const int & kmer_size, const int & min_hits, std::vector<unsigned long> & nb_found_reads, std::vector<unsigned long> & nb_searched_reads, unsigned long & nb_read_reads, const int & nb_threads = 1, const KmerSampling & sampling = KmerSampling ())
+{
+	KmerSampler sampler (kmer_size, sampling);
+	ReadKeys read_keys (kmer_size);
+	unsigned long indexes_size = 0;
+	for (size_t color = 0; color < colored->indexes.size(); color++) {
+		if (colored->indexes[color] != NULL) {
+			nb_searched_reads[color] = 0;
+			indexes_size += colored->indexes[color]->get_size();
+		}
+	}
+	if (colored->sliced != NULL) {
+		indexes_size = colored->sliced->get_size();
+	}
+	colored->prefetch = indexes_size >= SEARCH_PREFETCH_MIN_SIZE;
+	nb_read_reads = 0;
+	search_file_manager->rewind();
+	std::string & current_read_to_search = search_file_manager->get_next_read_to_compare();
+	if (nb_threads > 1) {
+		SearchThreadData data;
+		data.index = NULL;
+		data.colored = colored;
+		data.file_manager = search_file_manager;
+		data.kmer_size = kmer_size;
+		data.min_hits = min_hits;
+		data.sampling = sampling;
+		data.current_read = &current_read_to_search;
+		data.nb_searched_reads = &nb_read_reads;
+		data.nb_found_reads = 0;
+		data.nb_colored_searched_reads.assign(colored->indexes.size(), 0);
+		data.nb_colored_found_reads.assign(colored->indexes.size(), 0);
+		run_search_threads(data, nb_threads);
+		for (size_t color = 0; color < nb_found_reads.size(); color++) {
+			nb_searched_reads[color] += data.nb_colored_searched_reads[color];
+			nb_found_reads[color] += data.nb_colored_found_reads[color];
+		}
+		return;
+	}
+	while (!current_read_to_search.empty()) {
+		nb_read_reads++;
+		if (search_read_colors(colored, nb_searched_reads, nb_found_reads, read_keys, &sampler, current_read_to_search, search_file_manager->get_current_file(), search_file_manager->get_current_read_pos(), kmer_size, min_hits)) {
+			search_file_manager->tag_current_read();
+		}
+		current_read_to_search = search_file_manager->get_next_read_to_compare();
+	}
+}
+
 
 #endif
@@ -29,14 +29,15 @@
 
 #include <map>
 
+// Trim the blanks (and the \r of DOS files) around a set or file name
 void remove_spaces (std::string & fname)
 {
-	while (fname[0] == ' ') {
-		fname = fname.substr(1);
-	}
-	while (fname[fname.size()-1] == ' ') {
-		fname = fname.substr(0, fname.size() - 1);
+	size_t start = fname.find_first_not_of(" \t\r");
+	if (start == std::string::npos) {
+		fname.clear();
+		return;
 	}
+	fname = fname.substr(start, fname.find_last_not_of(" \t\r") - start + 1);
 }
 
 
@@ -58,11 +59,18 @@ void read_sets (const std::string & file_name, std::map <std::string, std::vecto
 	while (infile.good()) {
 		std::string line;
 		getline(infile, line);
+		remove_spaces(line);
 		if (!line.empty()) {
 			nb_sets++;
 			std::stringstream current_tag;
 			if (line.find(":") < line.size()) {
-				current_tag << line.substr(0, line.find(":"));
+				std::string tag = line.substr(0, line.find(":"));
+				remove_spaces(tag);
+				if (tag.empty()) {
+					std::cerr << "Error, set " << nb_sets << " of " << file_name << " has an empty name -> exit\n";
+					exit(1);
+				}
+				current_tag << tag;
 				line = line.substr(line.find(":") + 1);
 			} else {
 				current_tag << "SET" << nb_sets;
@@ -0,0 +1,238 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SLICED_BLOOM_FILTER_H_
+#define SLICED_BLOOM_FILTER_H_
+
+#include "bloom_filter.h"
+#include "hashed_bloom_filter.h"
+
+// Rows of more than 64 colors are ANDed by vectors of 2 words (SSE2, NEON)
+typedef unsigned long slice_vector_t __attribute__ ((vector_size (16)));
+
+/*
+ * Bit-sliced Bloom filter
+ *
+ * Indexes several sets of reads (colors) at once: each position of the
+ * filter is a row of one bit per color. Slice c of the rows (the bit c of
+ * each row) is a hashed Bloom filter of nb_rows bits containing the
+ * k-mers of color c, with the same positions as HashedBloomFilter.
+ *
+ * A query reads the HASHED_NB_BITS rows of the k-mer and ANDs them: the
+ * result is the set of colors that may contain the k-mer, for the cost of
+ * one probe per row whatever the number of colors. A row is 8, 16, 32 or
+ * 64 bits up to 64 colors, so that few colors do not leave most bits of
+ * the rows unused, then an even number of 64 bits words ANDed 16 bytes at
+ * a time.
+ *
+ * The k-mers of a color are fed after set_color(color), so that the
+ * indexing functions of index_reads.h fill one slice at a time.
+ */
+class SlicedBloomFilter : public BloomFilter
+{
+private:
+	int nb_colors;
+	int row_words;
+	int row_bytes;
+	unsigned long nb_rows;
+	unsigned long * rows;
+	int color;
+	
+	unsigned long row_pos (const unsigned long & key, const int & i) const
+	{
+		const unsigned long step = ((key << 32) | (key >> 32)) | 1;
+		return (unsigned long) (((unsigned __int128) (key + i * step) * nb_rows) >> 64);
+	}
+	
+	// Set the bit of the current color in the rows of key, the rows being
+	// arrays of Row words; with check_new, return true if one of them was
+	// not set (see feed_new)
+	template <typename Row, bool check_new>
+	bool feed_row_words (const unsigned long & key, const bool & atomic)
+	{
+		const int row_size = row_bytes / sizeof(Row);
+		const int word_bits = 8 * sizeof(Row);
+		const Row mask = (Row) 1 << (color % word_bits);
+		bool is_new = false;
+		for (int i = 0; i < HASHED_NB_BITS; i++) {
+			Row * word = (Row *) bloom_vector + row_pos(key, i) * row_size + color / word_bits;
+			if (!atomic) {
+				if (check_new) {
+					is_new |= !(*word & mask);
+				}
+				*word |= mask;
+			} else if (!(__atomic_load_n(word, __ATOMIC_RELAXED) & mask)) {
+				if (check_new) {
+					is_new |= !(__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask);
+				} else {
+					__atomic_fetch_or(word, mask, __ATOMIC_RELAXED);
+				}
+			}
+		}
+		return is_new;
+	}
+	
+	template <bool check_new>
+	bool feed_rows (const unsigned long & key, const bool & atomic)
+	{
+		switch (row_bytes) {
+			case 1: return feed_row_words<unsigned char, check_new>(key, atomic);
+			case 2: return feed_row_words<unsigned short, check_new>(key, atomic);
+			case 4: return feed_row_words<unsigned int, check_new>(key, atomic);
+			default: return feed_row_words<unsigned long, check_new>(key, atomic);
+		}
+	}
+	
+	// Colors of a row of at most 64 colors
+	unsigned long get_row (const unsigned long & row) const
+	{
+		switch (row_bytes) {
+			case 1: return ((const unsigned char *) bloom_vector)[row];
+			case 2: return ((const unsigned short *) bloom_vector)[row];
+			case 4: return ((const unsigned int *) bloom_vector)[row];
+		}
+		return rows[row];
+	}
+	
+public:
+	// Number of 64 bits words of the colors of a row of nb_colors bits
+	// (see get_colors)
+	static int get_row_words (const int & nb_colors)
+	{
+		return nb_colors <= 64 ? 1 : 2 * ((nb_colors + 127) / 128);
+	}
+	
+	// Number of bytes of a row of nb_colors bits
+	static int get_row_bytes (const int & nb_colors)
+	{
+		if (nb_colors <= 64) {
+			int bytes = 1;
+			while (8 * bytes < nb_colors) {
+				bytes *= 2;
+			}
+			return bytes;
+		}
+		return 8 * get_row_words(nb_colors);
+	}
+	
+	// size is the memory budget in bytes, rounded down to a number of rows
+	SlicedBloomFilter (const int & nb_colors, const unsigned long & size)
+	{
+		this->nb_colors = nb_colors;
+		row_words = get_row_words(nb_colors);
+		row_bytes = get_row_bytes(nb_colors);
+		nb_rows = size / row_bytes;
+		if (nb_rows == 0) {
+			nb_rows = 1;
+		}
+		init(nb_rows * row_bytes);
+		index_type = SLICED_INDEX;
+		rows = (unsigned long *) bloom_vector;
+		color = 0;
+	}
+	
+	const int & get_nb_colors () const {return nb_colors;}
+	const int & get_row_words () const {return row_words;}
+	const int & get_row_bytes () const {return row_bytes;}
+	
+	// Number of bits of each slice
+	const unsigned long & get_nb_rows () const {return nb_rows;}
+	
+	void clear ()
+	{
+		BloomFilter::clear();
+		rows = (unsigned long *) bloom_vector;
+	}
+	
+	// Fraction of the bits of the slices that are set, the unused bits of
+	// the rows are not counted: the mean occupancy of the colors
+	double get_occupancy (const unsigned long & step = 0) const
+	{
+		unsigned long nb_bits = 0;
+		const unsigned long nb_bytes = count_line_bits(step, nb_bits);
+		return nb_bytes > 0 ? (double) nb_bits / ((double) nb_bytes / row_bytes * nb_colors) : 0;
+	}
+	
+	// Estimated false positive rate of a color of mean occupancy
+	double get_fpr (const unsigned long & step = 0) const
+	{
+		return pow(get_occupancy(step), HASHED_NB_BITS);
+	}
+	
+	// Color of the next fed k-mers
+	void set_color (const int & new_color) {color = new_color;}
+	
+	void feed (const HashKey & hash_key)
+	{
+		feed_rows<false>(hash_key.mixed_key(), false);
+	}
+	
+	void feed_atomic (const HashKey & hash_key)
+	{
+		feed_rows<false>(hash_key.mixed_key(), true);
+	}
+	
+	bool feed_new (const HashKey & hash_key, const bool & atomic)
+	{
+		return feed_rows<true>(hash_key.mixed_key(), atomic);
+	}
+	
+	void prefetch (const HashKey & hash_key) const
+	{
+		__builtin_prefetch(bloom_vector + row_pos(hash_key.mixed_key(), 0) * row_bytes);
+	}
+	
+	/* get_colors writes in colors (row_words words) the colors that may
+	 * contain the k-mer, and returns false if there is none.
+	 */
+	bool get_colors (const HashKey & hash_key, unsigned long * colors) const
+	{
+		const unsigned long key = hash_key.mixed_key();
+		if (row_words == 1) {
+			colors[0] = get_row(row_pos(key, 0));
+			for (int i = 1; i < HASHED_NB_BITS; i++) {
+				colors[0] &= get_row(row_pos(key, i));
+			}
+			return colors[0] != 0;
+		}
+		const unsigned long * row[HASHED_NB_BITS];
+		for (int i = 0; i < HASHED_NB_BITS; i++) {
+			row[i] = &rows[row_pos(key, i) * row_words];
+		}
+		slice_vector_t any = {0, 0};
+		for (int word = 0; word < row_words; word += 2) {
+			slice_vector_t vector = *(const slice_vector_t *) (row[0] + word);
+			for (int i = 1; i < HASHED_NB_BITS; i++) {
+				vector &= *(const slice_vector_t *) (row[i] + word);
+			}
+			memcpy(colors + word, &vector, sizeof(vector));
+			any |= vector;
+		}
+		return (any[0] | any[1]) != 0;
+	}
+};
+
+#endif
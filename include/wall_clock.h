@@ -0,0 +1,46 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WALL_CLOCK_H_
+#define WALL_CLOCK_H_
+
+#include <sys/time.h>
+#include <ctime>
+
+/*
+ * wall_clock returns the elapsed time in clock ticks (CLOCKS_PER_SEC per second)
+ *
+ * It replaces clock() to measure times because clock() sums the CPU time
+ * of all threads and cannot show the gain of the multithreaded steps.
+ */
+clock_t wall_clock ()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (clock_t) tv.tv_sec * CLOCKS_PER_SEC + (clock_t) tv.tv_usec * CLOCKS_PER_SEC / 1000000;
+}
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include "file_manager.h"
+#include "hash_key.h"
+#include "kmer_keys.h"
+#include "index_reads.h"
+#include "wall_clock.h"
+
+std::string version = "2.1";
+
+// -----------------------------------------------------------------------
+//                             PROTOTYPES
+// -----------------------------------------------------------------------
+
+void print_usage ();
+
+// -----------------------------------------------------------------------
+//                             K-MER LOOPS
+// -----------------------------------------------------------------------
+
+/*
+ * Each loop computes the keys of all the k-mers of the reads, as the
+ * index and search loops do (see feed_read in index_reads.h), and returns
+ * a checksum of the keys so that they are not optimized away.
+ */
+
+// Rolling keys, one nucleotide at a time (see ForwardKey in hash_key.h)
+template <class Key>
+unsigned long rolling_keys (Key hash, const std::vector<std::string> & reads, const int & kmer_size)
+{
+	const int size = Key::size(kmer_size);
+	unsigned long checksum = 0;
+	for (size_t read = 0; read < reads.size(); read++) {
+		hash.clear();
+		for (int i = 0; i < (int) reads[read].size(); i++) {
+			if (hash.add(reads[read][i]) >= size) {
+				checksum += hash.key().keya() ^ hash.key().keyb();
+			}
+		}
+	}
+	return checksum;
+}
+
+template <int K>
+unsigned long rolling_keys (HashKey & hash, HashKey & rv_hash, const std::vector<std::string> & reads, const int & kmer_size, const bool & canonical)
+{
+	if (canonical) {
+		return rolling_keys(CanonicalKey<K>(hash, rv_hash), reads, kmer_size);
+	}
+	return rolling_keys(ForwardKey<K>(hash), reads, kmer_size);
+}
+
+// The loops compiled for the usual sizes of k-mers, as in feed_read
+unsigned long rolling_keys (HashKey & hash, HashKey & rv_hash, const std::vector<std::string> & reads, const int & kmer_size, const bool & canonical)
+{
+	switch (kmer_size) {
+		case 21: return rolling_keys<21>(hash, rv_hash, reads, kmer_size, canonical);
+		case 25: return rolling_keys<25>(hash, rv_hash, reads, kmer_size, canonical);
+		case 27: return rolling_keys<27>(hash, rv_hash, reads, kmer_size, canonical);
+		case 31: return rolling_keys<31>(hash, rv_hash, reads, kmer_size, canonical);
+		case 33: return rolling_keys<33>(hash, rv_hash, reads, kmer_size, canonical);
+	}
+	return rolling_keys<0>(hash, rv_hash, reads, kmer_size, canonical);
+}
+
+// Keys of the whole read at once (see KmerKeys in kmer_keys.h)
+unsigned long whole_read_keys (KmerKeys & kmer_keys, const std::vector<std::string> & reads, const bool & canonical)
+{
+	std::vector<unsigned long> keys;
+	std::vector<long> keys_pos;
+	unsigned long checksum = 0;
+	for (size_t read = 0; read < reads.size(); read++) {
+		kmer_keys.set_read(reads[read], canonical);
+		kmer_keys.get_keys(reads[read].size(), false, canonical, keys, keys_pos);
+		for (size_t j = 0; j < keys_pos.size(); j++) {
+			checksum += keys[2 * j] ^ keys[2 * j + 1];
+		}
+	}
+	return checksum;
+}
+
+// Number of k-mers of the reads, as counted under the indexing mutex
+unsigned long count_all_kmers (const std::vector<std::string> & reads, const int & kmer_size)
+{
+	unsigned long nb_kmers = 0;
+	for (size_t read = 0; read < reads.size(); read++) {
+		nb_kmers += count_kmers(reads[read], kmer_size);
+	}
+	return nb_kmers;
+}
+
+// Random reads of the given size, with about n_rate N
+void random_reads (std::vector<std::string> & reads, const unsigned long & nb_reads, const int & read_size, const double & n_rate)
+{
+	const char nucleotides[4] = {'A', 'C', 'G', 'T'};
+	srand(1);
+	reads.resize(nb_reads);
+	for (unsigned long read = 0; read < nb_reads; read++) {
+		reads[read].resize(read_size);
+		for (int i = 0; i < read_size; i++) {
+			reads[read][i] = (double) rand() / RAND_MAX < n_rate ? 'N' : nucleotides[rand() % 4];
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+//                                MAIN
+// -----------------------------------------------------------------------
+
+int main (int argc, char ** argv)
+{
+	std::string input_file_name;
+	int kmer_size = 31;
+	unsigned long nb_reads = 100000;
+	int read_size = 150;
+	int nb_runs = 20;
+	
+	int arg_pos = 1;
+	while (arg_pos < argc){
+		std::string flag = argv[arg_pos];
+		if (flag[0] != '-') {
+			if (input_file_name.empty()) {
+				input_file_name = flag;
+			} else {
+				std::cout << "The read file is already set, unknown file " << flag << " -> ignore\n";
+			}
+		} else if (flag.compare("-k") == 0 && arg_pos + 1 < argc) {
+			arg_pos++;
+			kmer_size = atoi(argv[arg_pos]);
+			if (kmer_size < 1 || kmer_size > MAX_KMER_SIZE) {
+				std::cerr << "Error, the k-mer size (-k) must be between 1 and " << MAX_KMER_SIZE << " -> exit\n";
+				return 1;
+			}
+		} else if (flag.compare("-n") == 0 && arg_pos + 1 < argc) {
+			arg_pos++;
+			nb_reads = atol(argv[arg_pos]);
+		} else if (flag.compare("-l") == 0 && arg_pos + 1 < argc) {
+			arg_pos++;
+			read_size = atoi(argv[arg_pos]);
+		} else if (flag.compare("-r") == 0 && arg_pos + 1 < argc) {
+			arg_pos++;
+			nb_runs = atoi(argv[arg_pos]);
+			if (nb_runs < 1) {
+				nb_runs = 1;
+			}
+		} else if (flag.compare("-h") == 0) {
+			print_usage ();
+			return 0;
+		} else if (flag.compare("-v") == 0) {
+			std::cout << "\nbench_kmers version " << version << "\n";
+			return 0;
+		} else {
+			std::cerr << "Unknown option " << flag << "\n";
+			print_usage ();
+			return 1;
+		}
+		arg_pos++;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Load the reads in memory: only the k-mer loops are timed
+	//
+	std::vector<std::string> reads;
+	if (input_file_name.empty()) {
+		random_reads(reads, nb_reads, read_size, 0.001);
+		std::cout << nb_reads << " random reads of " << read_size << " bases (0.1% N)";
+	} else {
+		FileManager file_manager;
+		file_manager.addFile(input_file_name);
+		if (file_manager.empty()) {
+			std::cerr << "Error, cannot read " << input_file_name << " -> exit\n";
+			return 1;
+		}
+		std::string & read = file_manager.get_next_read_to_compare();
+		while (!read.empty()) {
+			reads.push_back(read);
+			read = file_manager.get_next_read_to_compare();
+		}
+		std::cout << reads.size() << " reads of " << input_file_name;
+	}
+	unsigned long nb_bases = 0;
+	for (size_t read = 0; read < reads.size(); read++) {
+		nb_bases += reads[read].size();
+	}
+	std::cout << ", k = " << kmer_size << ", best of " << nb_runs << " runs\n";
+	if (nb_bases == 0) {
+		return 0;
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Time each loop, the best of nb_runs runs
+	//
+	const char * names[5] = {"forward keys, rolling", "canonical keys, rolling", "forward keys, whole read", "canonical keys, whole read", "count_kmers"};
+	HashKey hash (kmer_size);
+	HashKey rv_hash (kmer_size);
+	KmerKeys kmer_keys (kmer_size);
+	unsigned long checksum = 0;
+	for (int loop = 0; loop < 5; loop++) {
+		double best_time = 0;
+		for (int run = 0; run < nb_runs; run++) {
+			const clock_t begin_time = wall_clock();
+			switch (loop) {
+				case 0: checksum += rolling_keys(hash, rv_hash, reads, kmer_size, false); break;
+				case 1: checksum += rolling_keys(hash, rv_hash, reads, kmer_size, true); break;
+				case 2: checksum += whole_read_keys(kmer_keys, reads, false); break;
+				case 3: checksum += whole_read_keys(kmer_keys, reads, true); break;
+				default: checksum += count_all_kmers(reads, kmer_size);
+			}
+			const double time = (double) (wall_clock() - begin_time) / CLOCKS_PER_SEC;
+			if (run == 0 || time < best_time) {
+				best_time = time;
+			}
+		}
+		std::cout << names[loop] << ": " << (best_time > 0 ? nb_bases / best_time / 1e6 : 0) << " Mbases/s\n";
+	}
+	// Print the checksum, so that the keys are computed
+	std::cout << "checksum: " << checksum << "\n";
+	return 0;
+}
+
+
+// -----------------------------------------------------------------------
+//                                USAGE
+// -----------------------------------------------------------------------
+
+void print_usage () {
+	std::cout << "\nbench_kmers v" << version << "\n";
+	std::cout << "Usage:\n\t./bench_kmers [read_file] [options]\n";
+	std::cout << "Times the loops that compute the keys of the k-mers of the reads, in bases per second.\n";
+	std::cout << "Optional:\n";
+	std::cout << "\t[read_file]\t: file containing reads, in fasta or fastq format, gzipped or not, or a packed read file [default=random reads]\n";
+	std::cout << "Options:\n";
+	std::cout << "\t -k int\t\t: k-mer size [default=31]\n";
+	std::cout << "\t -n int\t\t: number of random reads [default=100000]\n";
+	std::cout << "\t -l int\t\t: size of the random reads [default=150]\n";
+	std::cout << "\t -r int\t\t: number of runs of each loop, the best one is kept [default=20]\n";
+	std::cout << "\t -h\t\t: prints this help\n";
+	std::cout << "\t -v\t\t: prints the version number.\n\n";
+}
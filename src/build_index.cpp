@@ -0,0 +1,498 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "index_reads.h"
+#include "file_manager.h"
+#include "bloom_filter.h"
+#include "index_memory.h"
+#include "index_type.h"
+#include "index_file.h"
+#include "partitioned_index.h"
+#include "set_parser.h"
+#include "wall_clock.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <ctime>
+#include <map>
+
+std::string version = "2.1";
+
+// -----------------------------------------------------------------------
+//                              PROTOTYPE
+// -----------------------------------------------------------------------
+void print_usage ();
+unsigned long write_index (FileManager * index_set, const std::string & out_file, const std::vector <std::string> & sources, const int & kmer_size, const int & nb_threads, const int & index_type, const unsigned long & index_memory, const unsigned long & max_kmer, const double & max_fpr, const bool & canonical, const int & min_count, const int & nb_partitions, const KmerSampling & sampling, unsigned long & nb_chunks, IndexFill & index_fill);
+bool is_up_to_date (const std::string & index_file_name, const std::string & file_name, const std::string & bv_name, const std::vector <std::string> & sources, const int & kmer_size, const int & index_type, const unsigned long & index_memory, const bool & canonical, const int & nb_partitions, const KmerSampling & sampling, const int & min_count, const double & max_fpr);
+
+// -----------------------------------------------------------------------
+//                                MAIN
+// -----------------------------------------------------------------------
+
+int main (int argc, char ** argv)
+{
+	// index files variables
+	std::string index_file_list;
+	FileManager * index_set = new FileManager;
+	std::map <std::string, std::vector <std::string> > index_file_names;
+	std::map <std::string, std::vector <std::string> > index_bv_names;
+	
+	// general parameters
+	int kmer_size = 33;
+	int nb_threads = 1;
+	int index_type = CLASSIC_INDEX;
+	unsigned long index_memory = 0;
+	bool canonical = false;
+	int min_count = 1;
+	KmerSampling sampling;
+	int nb_partitions = 0;
+	double max_fpr = 0;
+	bool per_file = false;
+	unsigned long max_kmer;
+	
+	// output index file (directory of the index files with -F)
+	std::string out_file;
+	
+	////////////////////////////////////////////////////////////
+	// Read command line arguments
+	//
+	if (argc == 1) {
+		print_usage ();
+		return (0);
+	}
+	int arg_pos = 1;
+	while (arg_pos < argc){
+		std::string flag = argv[arg_pos];
+		if (flag.compare("-i") == 0) {
+			// File name for list of index files
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			if (!index_file_list.empty()) {
+				std::cerr << "index files already given (-i) -> ignore";
+			} else {
+				index_file_list = argv[arg_pos];
+			}
+		} else if (flag.compare("-o") == 0) {
+			// The index file to write
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			out_file = argv[arg_pos];
+		} else if (flag.compare("-k") == 0) {
+			// The size of k-mers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			kmer_size = atoi(argv[arg_pos]);
+			if (kmer_size < 1 || kmer_size > MAX_KMER_SIZE) {
+				std::cerr << "Error, the size of k-mers must be between 1 and " << MAX_KMER_SIZE << "\n";
+				exit(1);
+			}
+			std::cout << "k-mer size (-k) = " << kmer_size << "\n";
+		} else if (flag.compare("-p") == 0) {
+			// The number of threads
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			nb_threads = atoi(argv[arg_pos]);
+			if (nb_threads < 1) {
+				nb_threads = 1;
+			}
+			std::cout << "threads (-p) = " << nb_threads << "\n";
+		} else if (flag.compare("-x") == 0) {
+			// The type of index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_type = parse_index_type(argv[arg_pos]);
+			if (index_type < 0 || index_type == SLICED_INDEX) {
+				std::cerr << "Error, unknown index type " << argv[arg_pos] << "\n";
+				print_usage();
+				exit(1);
+			}
+			std::cout << "index type (-x) = " << argv[arg_pos] << "\n";
+		} else if (flag.compare("-m") == 0) {
+			// The memory budget of the index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_memory = parse_memory(argv[arg_pos]);
+			if (index_memory == 0) {
+				std::cerr << "Error, invalid memory size " << argv[arg_pos] << "\n";
+				print_usage();
+				exit(1);
+			}
+			std::cout << "index memory (-m) = " << index_memory << " bytes\n";
+		} else if (flag.compare("-a") == 0) {
+			// The minimal number of occurrences of an indexed k-mer
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			min_count = atoi(argv[arg_pos]);
+			if (min_count < 1 || min_count > COUNTER_MAX) {
+				std::cerr << "Error, the minimal count of k-mers must be between 1 and " << COUNTER_MAX << "\n";
+				exit(1);
+			}
+			std::cout << "min k-mer count (-a) = " << min_count << "\n";
+		} else if (flag.compare("-P") == 0) {
+			// The number of partitions of the index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			nb_partitions = atoi(argv[arg_pos]);
+			if (nb_partitions < 1 || nb_partitions > MAX_PARTITIONS) {
+				std::cerr << "Error, the number of partitions must be between 1 and " << MAX_PARTITIONS << "\n";
+				exit(1);
+			}
+			std::cout << "partitions (-P) = " << nb_partitions << "\n";
+		} else if (flag.compare("-w") == 0) {
+			// The window of the sampling minimizers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			sampling.window = atoi(argv[arg_pos]);
+			if (sampling.window < 1) {
+				std::cerr << "Error, the window of minimizers must be at least 1\n";
+				exit(1);
+			}
+			std::cout << "minimizer window (-w) = " << sampling.window << "\n";
+		} else if (flag.compare("-y") == 0) {
+			// The size of the s-mers of the sampling syncmers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			sampling.syncmer_size = atoi(argv[arg_pos]);
+			if (sampling.syncmer_size < 1) {
+				std::cerr << "Error, the size of syncmers must be at least 1\n";
+				exit(1);
+			}
+			std::cout << "syncmer size (-y) = " << sampling.syncmer_size << "\n";
+		} else if (flag.compare("-e") == 0) {
+			// The target false positive rate of the index chunks
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			max_fpr = atof(argv[arg_pos]);
+			if (max_fpr <= 0 || max_fpr >= 1) {
+				std::cerr << "Error, the target false positive rate must be between 0 and 1\n";
+				exit(1);
+			}
+			std::cout << "target false positive rate (-e) = " << max_fpr << "\n";
+		} else if (flag.compare("-c") == 0) {
+			canonical = true;
+			std::cout << "canonical k-mers (-c)\n";
+		} else if (flag.compare("-F") == 0) {
+			per_file = true;
+			std::cout << "one index file per file (-F)\n";
+		} else if (flag.compare("-h") == 0) {
+			print_usage ();
+			return 0;
+		} else if (flag.compare("-v") == 0) {
+			std::cout << "\nbuild_index version " << version << "\n";
+			return 0;
+		} else {
+			std::cerr << "Unknown option " << flag << "\n";
+			print_usage ();
+			return (0);
+		}
+		arg_pos++;
+	}
+	
+	if (index_file_list.empty()) {
+		std::cerr << "Error, no file to index (-i)\n";
+		print_usage();
+		exit(1);
+	}
+	if (sampling.window > 1 && sampling.syncmer_size > 0) {
+		std::cerr << "Error, the k-mers are sampled either by minimizers (-w) or by syncmers (-y)\n";
+		exit(1);
+	}
+	if (sampling.syncmer_size > 0 && (sampling.syncmer_size >= kmer_size || (kmer_size - sampling.syncmer_size) % 2 != 0)) {
+		std::cerr << "Error, the size of syncmers (-y) must be lower than k, with an even difference\n";
+		exit(1);
+	}
+	if (max_fpr > 0 && nb_partitions > 0) {
+		std::cerr << "Error, the target false positive rate (-e) is not available with partitions (-P)\n";
+		exit(1);
+	}
+	// The classic index cannot be resized, a memory budget needs a hashed one
+	// and so do partitions, which share the budget
+	if (index_memory > 0 && index_type == CLASSIC_INDEX) {
+		index_type = HASHED_INDEX;
+		std::cout << "index type = hashed (memory budget given)\n";
+	} else if (nb_partitions > 0 && index_type == CLASSIC_INDEX) {
+		index_type = HASHED_INDEX;
+		std::cout << "index type = hashed (partitions given)\n";
+	}
+	max_kmer = index_max_kmer(index_type, index_size(index_type, kmer_size, index_memory));
+	// Filters used by several threads are spread over the NUMA nodes
+	IndexMemory::getInstance()->set_nb_threads(nb_threads);
+	
+	////////////////////////////////////////////////////////////
+	// Put index files in a file manager
+	//
+	read_sets(index_file_list, index_file_names, index_bv_names);
+	if (index_file_names.size() != 1) {
+		std::cerr << "Only one set of files is allowed for indexing\n";
+		exit(1);
+	}
+	index_set->set_nickname(index_file_names.begin()->first);
+	std::vector <std::string> tmp_index_file_names = index_file_names.begin()->second;
+	std::vector <std::string> tmp_index_bv_names = index_bv_names.begin()->second;
+	std::vector <std::string> sources;
+	for (size_t file_pos = 0; file_pos < tmp_index_file_names.size(); file_pos++) {
+		if (tmp_index_bv_names[file_pos].empty()) {
+			sources.push_back(tmp_index_file_names[file_pos]);
+		} else {
+			sources.push_back(tmp_index_file_names[file_pos] + "," + tmp_index_bv_names[file_pos]);
+		}
+	}
+	
+	////////////////////////////////////////////////////////////
+	// With -F, each file is indexed in its own index file, named after
+	// the file, so that merge_index can OR them in any grouping
+	//
+	if (per_file) {
+		if (out_file.empty()) {
+			out_file = ".";
+		}
+		struct stat info;
+		if (stat (out_file.c_str(), &info ) != 0){
+			mkdir(out_file.c_str(), S_IRWXU|S_IRGRP|S_IXGRP);
+		} else if (!(info.st_mode & S_IFDIR)) {
+			std::cerr << "Error: " << out_file << " already exists and is not a directory\n";
+			exit(1);
+		}
+		// The index files are named after the files: two files of the same
+		// name (in different directories) would share one
+		std::vector <std::string> nicknames;
+		std::map <std::string, size_t> nickname_files;
+		for (size_t file_pos = 0; file_pos < tmp_index_file_names.size(); file_pos++) {
+			nicknames.push_back(tmp_index_file_names[file_pos].substr(tmp_index_file_names[file_pos].rfind("/") + 1));
+			if (nickname_files.count(nicknames[file_pos]) > 0) {
+				std::cerr << "Error, " << sources[nickname_files[nicknames[file_pos]]] << " and " << sources[file_pos] << " would both be indexed in " << out_file << "/" << nicknames[file_pos] << ".cbf with -F, index them with separate runs (-o)\n";
+				exit(1);
+			}
+			nickname_files[nicknames[file_pos]] = file_pos;
+		}
+		clock_t start_time = wall_clock();
+		for (size_t file_pos = 0; file_pos < tmp_index_file_names.size(); file_pos++) {
+			const std::string & nickname = nicknames[file_pos];
+			const std::string file_index_name = out_file + "/" + nickname + ".cbf";
+			const std::vector <std::string> file_sources (1, sources[file_pos]);
+			if (is_up_to_date(file_index_name, tmp_index_file_names[file_pos], tmp_index_bv_names[file_pos], file_sources, kmer_size, index_type, index_memory, canonical, nb_partitions, sampling, min_count, max_fpr)) {
+				std::cout << "keep " << file_index_name << " (up to date)\n";
+				continue;
+			}
+			std::cout << "open " << sources[file_pos] << "\n";
+			FileManager * file_set = new FileManager;
+			file_set->set_nickname(nickname);
+			if (tmp_index_bv_names[file_pos].empty()) {
+				file_set->addFile(tmp_index_file_names[file_pos]);
+			} else {
+				file_set->addFile(tmp_index_file_names[file_pos], tmp_index_bv_names[file_pos]);
+			}
+			unsigned long nb_chunks = 0;
+			IndexFill index_fill;
+			const unsigned long nb_indexed_reads = write_index(file_set, file_index_name, file_sources, kmer_size, nb_threads, index_type, index_memory, max_kmer, max_fpr, canonical, min_count, nb_partitions, sampling, nb_chunks, index_fill);
+			std::cout << "[indexed " << nb_indexed_reads << " reads of {" << nickname << "} in " << nb_chunks << (nb_partitions > 0 ? " partition(s)" : " chunk(s)") << " -> " << file_index_name << "]\n";
+			if (nb_partitions == 0) {
+				std::cout << "Index  fill: " << index_fill.get_stats() << "\n";
+			}
+			delete file_set;
+		}
+		std::cout << "Index  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+		return 0;
+	}
+	
+	for (size_t file_pos = 0; file_pos < tmp_index_file_names.size(); file_pos++) {
+		std::cout << "open " << sources[file_pos] << "\n";
+		if (tmp_index_bv_names[file_pos].empty()) {
+			index_set->addFile(tmp_index_file_names[file_pos]);
+		} else {
+			index_set->addFile(tmp_index_file_names[file_pos], tmp_index_bv_names[file_pos]);
+		}
+	}
+	if (out_file.empty()) {
+		out_file = index_set->get_nickname() + ".cbf";
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Create the index and write it in the index file
+	//
+	unsigned long nb_chunks = 0;
+	clock_t start_time = wall_clock();
+	IndexFill index_fill;
+	const unsigned long nb_indexed_reads = write_index(index_set, out_file, sources, kmer_size, nb_threads, index_type, index_memory, max_kmer, max_fpr, canonical, min_count, nb_partitions, sampling, nb_chunks, index_fill);
+	std::cout << "Index  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+	if (nb_partitions == 0) {
+		std::cout << "Index  fill: " << index_fill.get_stats() << "\n";
+	}
+	std::cout << "[indexed " << nb_indexed_reads << " reads of {" << index_set->get_nickname() << "} in " << nb_chunks << (nb_partitions > 0 ? " partition(s)" : " chunk(s)") << " -> " << out_file << "]\n";
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+//                             WRITE INDEX
+// -----------------------------------------------------------------------
+// Create the index of the reads of index_set chunk by chunk, as
+// index_and_search does, or partition by partition, and write it in the
+// index file out_file. Return the number of indexed reads, and the number
+// of chunks (or partitions) in nb_chunks. The chunks are added to
+// index_fill, which reports the fullest of them
+unsigned long write_index (FileManager * index_set, const std::string & out_file, const std::vector <std::string> & sources, const int & kmer_size, const int & nb_threads, const int & index_type, const unsigned long & index_memory, const unsigned long & max_kmer, const double & max_fpr, const bool & canonical, const int & min_count, const int & nb_partitions, const KmerSampling & sampling, unsigned long & nb_chunks, IndexFill & index_fill)
+{
+	IndexFileWriter index_file (out_file, kmer_size, index_type, canonical, index_set->get_nickname(), sources, nb_partitions > 0 ? partition_minimizer_size(kmer_size) : 0, sampling, min_count, max_fpr);
+	unsigned long nb_reads_to_index = index_set->get_total_nb_reads();
+	unsigned long nb_indexed_reads = 0;
+	nb_chunks = 0;
+	if (nb_partitions > 0) {
+		nb_indexed_reads = build_partitioned_index(index_file, index_set, kmer_size, nb_partitions, index_type, index_memory, canonical, min_count, out_file, sampling);
+		index_file.close();
+		nb_chunks = nb_partitions;
+		return nb_indexed_reads;
+	}
+	while (index_set->get_reads_count() < nb_reads_to_index) {
+		unsigned long nb_chunk_reads = 0;
+		BloomFilter * index = index_reads (index_set, kmer_size, 0, max_kmer, nb_chunk_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+		index_fill.add(index);
+		index_file.add_chunk(index, nb_chunk_reads);
+		delete index;
+		nb_indexed_reads += nb_chunk_reads;
+		nb_chunks++;
+	}
+	index_file.close();
+	return nb_indexed_reads;
+}
+
+// -----------------------------------------------------------------------
+//                             IS UP TO DATE
+// -----------------------------------------------------------------------
+// Return true if index_file_name is the index of the given file, built
+// after the file (and its boolean vector) with the given options, so that
+// build_index -F does not index it again. An index file of an older
+// format, which does not give -a and -e, is built again
+bool is_up_to_date (const std::string & index_file_name, const std::string & file_name, const std::string & bv_name, const std::vector <std::string> & sources, const int & kmer_size, const int & index_type, const unsigned long & index_memory, const bool & canonical, const int & nb_partitions, const KmerSampling & sampling, const int & min_count, const double & max_fpr)
+{
+	struct stat index_info, file_info, bv_info;
+	if (stat(index_file_name.c_str(), &index_info) != 0 || stat(file_name.c_str(), &file_info) != 0 || index_info.st_mtime <= file_info.st_mtime) {
+		return false;
+	}
+	if (!bv_name.empty() && (stat(bv_name.c_str(), &bv_info) != 0 || index_info.st_mtime <= bv_info.st_mtime)) {
+		return false;
+	}
+	IndexFile index_file (index_file_name);
+	if (index_file.get_kmer_size() != kmer_size || index_file.get_index_type() != index_type || index_file.is_canonical() != canonical || index_file.get_sources() != sources) {
+		return false;
+	}
+	if (index_file.get_sampling().window != sampling.window || index_file.get_sampling().syncmer_size != sampling.syncmer_size) {
+		return false;
+	}
+	if (index_file.get_version() != INDEX_FILE_VERSION || index_file.get_min_count() != min_count || index_file.get_max_fpr() != max_fpr) {
+		return false;
+	}
+	if (nb_partitions > 0 ? !index_file.is_partitioned() || index_file.get_nb_chunks() != (unsigned long) nb_partitions : index_file.is_partitioned() || index_file.get_nb_chunks() == 0) {
+		return false;
+	}
+	const unsigned long memory = nb_partitions > 0 ? partition_memory(index_type, kmer_size, index_memory, nb_partitions) : index_memory;
+	return index_type == EXACT_INDEX || index_file.get_chunk_size(0) == index_size(index_type, kmer_size, memory);
+}
+
+// -----------------------------------------------------------------------
+//                             PRINT USAGE
+// -----------------------------------------------------------------------
+void print_usage ()
+{
+	std::cerr << "\nbuild_index, version " << version << "\n";
+	std::cerr << "Usage : ./build_index -i <file> [options]\n";
+	std::cerr << "Mandatory:\n";
+	std::cerr << "\t -i <file>: A file containing the list of files to index - MANDATORY\n";
+	std::cerr << "Options:\n";
+	std::cerr << "\t -o <file>: Index file to write, or directory of the index files with -F. [default=<set name>.cbf, ./ with -F]\n";
+	std::cerr << "\t -k <value>: Size of k-mers (value of k), at most 63. [default=33]\n";
+	std::cerr << "\t -p <value>: Number of threads. [default=1]\n";
+	std::cerr << "\t -x <type>: Type of index, classic, blocked (one cache line per k-mer), hashed or exact. [default=classic]\n";
+	std::cerr << "\t -m <size>: Memory budget of a blocked, hashed or exact index, in bytes or with K, M, G (ie 2G).\n";
+	std::cerr << "\t            A classic index becomes hashed. [default=2^(k-1) bytes]\n";
+	std::cerr << "\t -a <value>: Minimal number of occurrences of an indexed k-mer, up to 255 (ie 2 to ignore sequencing errors). [default=1]\n";
+	std::cerr << "\t -P <value>: Number of partitions of the index, up to " << MAX_PARTITIONS << ": the k-mers are split by minimizer instead of the reads\n";
+	std::cerr << "\t            in chunks, and index_and_search reads each searched set once. The partitions share the memory\n";
+	std::cerr << "\t            budget (-m) and a classic index becomes hashed. [default=no partition]\n";
+	std::cerr << "\t -w <value>: Index and search only the (w,k)-minimizers, the k-mer of smallest hash of each window\n";
+	std::cerr << "\t            of w k-mers (about 2/(w+1) of the k-mers). -t then counts sampled k-mers. [default=1, all k-mers]\n";
+	std::cerr << "\t -y <value>: Index and search only the open syncmers, the k-mers whose s-mer of smallest hash is\n";
+	std::cerr << "\t            in their middle (about 1/(k-s+1) of the k-mers, k-s even). -t then counts sampled k-mers. [default=no syncmer]\n";
+	std::cerr << "\t -e <value>: Target false positive rate of the index, ie 0.01: a chunk of the index stops once its estimated\n";
+	std::cerr << "\t            false positive rate reaches it, instead of after a number of k-mers given by -m. [default=none]\n";
+	std::cerr << "\t -c: Index canonical k-mers [default=false]\n";
+	std::cerr << "\t -F: Index each file of the set in its own index file, <file name>.cbf in the directory given by -o.\n";
+	std::cerr << "\t     An index file newer than its file and built with the same options is kept. [default=false]\n";
+	std::cerr << "\t -h: Prints this message\n";
+	std::cerr << "\t -v: Prints the version number\n";
+	std::cerr << "The index file is given to index_and_search or compare_reads with -I <file>\n";
+	std::cerr << "The index files of -F are merged in the index of any set of files with merge_index\n";
+}
@@ -29,8 +29,12 @@
 #include "file_manager.h"
 #include "file_manager_max.h"
 #include "bloom_filter.h"
+#include "index_memory.h"
+#include "index_type.h"
+#include "index_file.h"
 #include "boolean_vector.h"
 #include "set_parser.h"
+#include "wall_clock.h"
 
 
 #include <sys/types.h>
@@ -61,6 +65,10 @@ int main (int argc, char ** argv)
 	std::map <std::string, std::vector <std::string> > A_file_names;
 	std::map <std::string, std::vector <std::string> > A_bv_names;
 	
+	// index file of A built by build_index
+	std::string index_file_name;
+	IndexFile * index_file = NULL;
+	
 	// B files variables
 	std::string B_file_list;
 	FileManager * B_set = new FileManager;
@@ -70,7 +78,14 @@ int main (int argc, char ** argv)
 	// general parameters
 	int kmer_size = 33;
 	int min_hits = 2;
-	unsigned long max_kmer = (unsigned long) (1000000000.0 / pow (2, 33 - kmer_size));
+	int nb_threads = 1;
+	int index_type = CLASSIC_INDEX;
+	unsigned long index_memory = 0;
+	bool canonical = false;
+	int min_count = 1;
+	KmerSampling sampling;
+	double max_fpr = 0;
+	unsigned long max_kmer;
 	
 	// path to output messages
 	std::string log_path = ".";
@@ -100,6 +115,15 @@ int main (int argc, char ** argv)
 			} else {
 				A_file_list = argv[arg_pos];
 			}
+		} else if (flag.compare("-I") == 0) {
+			// Index file of A built by build_index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_file_name = argv[arg_pos];
 		} else if (flag.compare("-s") == 0) {
 			// File name for list of B files
 			arg_pos++;
@@ -140,7 +164,10 @@ int main (int argc, char ** argv)
 				exit(1);
 			}
 			kmer_size = atoi(argv[arg_pos]);
-			max_kmer = (unsigned long) (1000000000.0 / pow (2, 33 - kmer_size));
+			if (kmer_size < 1 || kmer_size > MAX_KMER_SIZE) {
+				std::cerr << "Error, the size of k-mers must be between 1 and " << MAX_KMER_SIZE << "\n";
+				exit(1);
+			}
 			std::cout << "k-mer size (-k) = " << kmer_size << "\n";
 		} else if (flag.compare("-t") == 0) {
 			// The minimal number of hits to consider two reads as similar
@@ -152,6 +179,108 @@ int main (int argc, char ** argv)
 			}
 			min_hits = atoi(argv[arg_pos]);
 			std::cout << "min hits (-t) = " << min_hits << "\n";
+		} else if (flag.compare("-p") == 0) {
+			// The number of threads
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			nb_threads = atoi(argv[arg_pos]);
+			if (nb_threads < 1) {
+				nb_threads = 1;
+			}
+			std::cout << "threads (-p) = " << nb_threads << "\n";
+		} else if (flag.compare("-x") == 0) {
+			// The type of index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_type = parse_index_type(argv[arg_pos]);
+			if (index_type < 0 || index_type == SLICED_INDEX) {
+				std::cerr << "Error, unknown index type " << argv[arg_pos] << "\n";
+				print_usage();
+				exit(1);
+			}
+			std::cout << "index type (-x) = " << argv[arg_pos] << "\n";
+		} else if (flag.compare("-m") == 0) {
+			// The memory budget of the index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_memory = parse_memory(argv[arg_pos]);
+			if (index_memory == 0) {
+				std::cerr << "Error, invalid memory size " << argv[arg_pos] << "\n";
+				print_usage();
+				exit(1);
+			}
+			std::cout << "index memory (-m) = " << index_memory << " bytes\n";
+		} else if (flag.compare("-a") == 0) {
+			// The minimal number of occurrences of an indexed k-mer
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			min_count = atoi(argv[arg_pos]);
+			if (min_count < 1 || min_count > COUNTER_MAX) {
+				std::cerr << "Error, the minimal count of k-mers must be between 1 and " << COUNTER_MAX << "\n";
+				exit(1);
+			}
+			std::cout << "min k-mer count (-a) = " << min_count << "\n";
+		} else if (flag.compare("-w") == 0) {
+			// The window of the sampling minimizers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			sampling.window = atoi(argv[arg_pos]);
+			if (sampling.window < 1) {
+				std::cerr << "Error, the window of minimizers must be at least 1\n";
+				exit(1);
+			}
+			std::cout << "minimizer window (-w) = " << sampling.window << "\n";
+		} else if (flag.compare("-y") == 0) {
+			// The size of the s-mers of the sampling syncmers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			sampling.syncmer_size = atoi(argv[arg_pos]);
+			if (sampling.syncmer_size < 1) {
+				std::cerr << "Error, the size of syncmers must be at least 1\n";
+				exit(1);
+			}
+			std::cout << "syncmer size (-y) = " << sampling.syncmer_size << "\n";
+		} else if (flag.compare("-e") == 0) {
+			// The target false positive rate of the index chunks
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			max_fpr = atof(argv[arg_pos]);
+			if (max_fpr <= 0 || max_fpr >= 1) {
+				std::cerr << "Error, the target false positive rate must be between 0 and 1\n";
+				exit(1);
+			}
+			std::cout << "target false positive rate (-e) = " << max_fpr << "\n";
+		} else if (flag.compare("-c") == 0) {
+			canonical = true;
+			std::cout << "canonical k-mers (-c)\n";
 		} else if (flag.compare("-h") == 0) {
 			print_usage ();
 			return 0;
@@ -166,6 +295,36 @@ int main (int argc, char ** argv)
 		arg_pos++;
 	}
 	
+	// The parameters of an index file replace the given ones
+	if (!index_file_name.empty()) {
+		index_file = new IndexFile (index_file_name);
+		kmer_size = index_file->get_kmer_size();
+		index_type = index_file->get_index_type();
+		canonical = index_file->is_canonical();
+		sampling = index_file->get_sampling();
+		std::cout << "index file (-I) = " << index_file_name << ": set " << index_file->get_nickname() << ", " << index_file->get_nb_chunks() << (index_file->is_partitioned() ? " partition(s)" : " chunk(s)") << ", k-mer size = " << kmer_size << (canonical ? ", canonical k-mers" : "") << "\n";
+		if (index_file->is_partitioned()) {
+			std::cerr << "Error, a partitioned index file is only searched by index_and_search\n";
+			exit(1);
+		}
+	}
+	if (sampling.window > 1 && sampling.syncmer_size > 0) {
+		std::cerr << "Error, the k-mers are sampled either by minimizers (-w) or by syncmers (-y)\n";
+		exit(1);
+	}
+	if (sampling.syncmer_size > 0 && (sampling.syncmer_size >= kmer_size || (kmer_size - sampling.syncmer_size) % 2 != 0)) {
+		std::cerr << "Error, the size of syncmers (-y) must be lower than k, with an even difference\n";
+		exit(1);
+	}
+	// The classic index cannot be resized, a memory budget needs a hashed one
+	if (index_memory > 0 && index_type == CLASSIC_INDEX) {
+		index_type = HASHED_INDEX;
+		std::cout << "index type = hashed (memory budget given)\n";
+	}
+	max_kmer = index_max_kmer(index_type, index_size(index_type, kmer_size, index_memory));
+	// Filters used by several threads are spread over the NUMA nodes
+	IndexMemory::getInstance()->set_nb_threads(nb_threads);
+	
 	////////////////////////////////////////////////////////////
 	// Check existence of out_path and log_path
 	// if not then create them
@@ -193,6 +352,9 @@ int main (int argc, char ** argv)
 		std::cerr << "Only one set of files is allowed for A -> keep first set only\n";
 	}
 	A_set->set_nickname(A_file_names.begin()->first);
+	if (index_file != NULL && index_file->get_nickname() != A_set->get_nickname()) {
+		std::cerr << "Warning, the index file was built from the set " << index_file->get_nickname() << ", not from " << A_set->get_nickname() << "\n";
+	}
 	std::vector <std::string> tmp_A_file_names = A_file_names.begin()->second;
 	std::vector <std::string> tmp_A_bv_names = A_bv_names.begin()->second;
 	for (size_t file_pos = 0; file_pos < tmp_A_file_names.size(); file_pos++) {
@@ -245,24 +407,34 @@ int main (int argc, char ** argv)
 	unsigned long nb_found_reads = 0;
 	unsigned long nb_searched_reads = 0;
 	clock_t index_time = 0;
+	IndexFill index_fill;
 	clock_t search_time = 0;
-	clock_t start_time = clock();
-	while (nb_indexed_reads < nb_reads_to_index) {
+	clock_t start_time = wall_clock();
+	unsigned long chunk = 0;
+	while (index_file != NULL ? chunk < index_file->get_nb_chunks() : A_set->get_reads_count() < nb_reads_to_index) {
 		if (index != NULL) {
 			delete index;
 			index = NULL;
 		}
-		const clock_t index_start = clock();
-		index = index_reads (A_set, kmer_size, min_hits, max_kmer, nb_indexed_reads);
-		index_time += clock() - index_start;
-		const clock_t search_start = clock();
-		nb_found_reads += search_reads(index, B_set, kmer_size, min_hits, nb_searched_reads);
-		search_time += clock() - search_start;
+		const clock_t index_start = wall_clock();
+		if (index_file != NULL) {
+			index = index_file->get_chunk(chunk, nb_indexed_reads);
+		} else {
+			index = index_reads (A_set, kmer_size, min_hits, max_kmer, nb_indexed_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+		}
+		chunk++;
+		index_time += wall_clock() - index_start;
+		index_fill.add(index);
+		const clock_t search_start = wall_clock();
+		nb_found_reads += search_reads(index, B_set, kmer_size, min_hits, nb_searched_reads, nb_threads, sampling);
+		search_time += wall_clock() - search_start;
 	}
 	B_set->apply_bv_on_files();
 	std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+	std::cout << "Index  fill: " << index_fill.get_stats() << "\n";
 	std::cout << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-	std::cout << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 	std::cout << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "]\n";
 	
 	////////////////////////////////////////////////////////////
@@ -276,27 +448,31 @@ int main (int argc, char ** argv)
 	nb_found_reads = 0;
 	nb_searched_reads = 0;
 	index_time = 0;
+	index_fill = IndexFill();
 	search_time = 0;
 	B_set->rewind();
 	A_set->rewind();
-	start_time = clock();
-	while (nb_indexed_reads < nb_reads_to_index) {
+	start_time = wall_clock();
+	while (B_set->get_reads_count() < nb_reads_to_index) {
 		if (index != NULL) {
 			delete index;
 			index = NULL;
 		}
-		const clock_t index_start = clock();
-		index = index_reads (B_set, kmer_size, min_hits, max_kmer, nb_indexed_reads);
-		index_time += clock() - index_start;
-		const clock_t search_start = clock();
-		nb_found_reads += search_reads(index, A_set, kmer_size, min_hits, nb_searched_reads);
-		search_time += clock() - search_start;
+		const clock_t index_start = wall_clock();
+		index = index_reads (B_set, kmer_size, min_hits, max_kmer, nb_indexed_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+		index_time += wall_clock() - index_start;
+		index_fill.add(index);
+		const clock_t search_start = wall_clock();
+		nb_found_reads += search_reads(index, A_set, kmer_size, min_hits, nb_searched_reads, nb_threads, sampling);
+		search_time += wall_clock() - search_start;
 	}
 	A_set->save_bv(out_path, B_set->get_nickname());
 	A_set->apply_bv_on_files();
 	std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+	std::cout << "Index  fill: " << index_fill.get_stats() << "\n";
 	std::cout << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-	std::cout << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 	std::cout << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "] "<< 100 * (float) nb_found_reads / (float) nb_reads_A <<"%\n";
 	
 	////////////////////////////////////////////////////////////
@@ -310,31 +486,44 @@ int main (int argc, char ** argv)
 	nb_found_reads = 0;
 	nb_searched_reads = 0;
 	index_time = 0;
+	index_fill = IndexFill();
 	search_time = 0;
-	start_time = clock();
+	start_time = wall_clock();
 	B_set->rewind();
 	A_set->rewind();
-	while (nb_indexed_reads < nb_reads_to_index) {
+	chunk = 0;
+	while (index_file != NULL ? chunk < index_file->get_nb_chunks() : A_set->get_reads_count() < nb_reads_to_index) {
 		if (index != NULL) {
 			delete index;
 			index = NULL;
 		}
-		const clock_t index_start = clock();
-		index = index_reads (A_set, kmer_size, min_hits, max_kmer, nb_indexed_reads);
-		index_time += clock() - index_start;
-		const clock_t search_start = clock();
-		nb_found_reads += search_reads(index, B_set, kmer_size, min_hits, nb_searched_reads);
-		search_time += clock() - search_start;
+		const clock_t index_start = wall_clock();
+		if (index_file != NULL) {
+			index = index_file->get_chunk(chunk, nb_indexed_reads);
+		} else {
+			index = index_reads (A_set, kmer_size, min_hits, max_kmer, nb_indexed_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+		}
+		chunk++;
+		index_time += wall_clock() - index_start;
+		index_fill.add(index);
+		const clock_t search_start = wall_clock();
+		nb_found_reads += search_reads(index, B_set, kmer_size, min_hits, nb_searched_reads, nb_threads, sampling);
+		search_time += wall_clock() - search_start;
 	}
 	B_set->save_bv(out_path, A_set->get_nickname());
 	std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+	std::cout << "Index  fill: " << index_fill.get_stats() << "\n";
 	std::cout << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-	std::cout << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 	std::cout << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "] "<< 100 * (float) nb_found_reads / (float) nb_reads_B <<"%\n";
 	if (index != NULL) {
 		delete index;
 		index = NULL;
 	}
+	if (index_file != NULL) {
+		delete index_file;
+	}
 	return 0;
 }
 
@@ -351,10 +540,24 @@ void print_usage ()
 	std::cerr << "\t -s <file>: A file containing the list of file sets to search - MANDATORY\n";
 	std::cerr << "\t            Each line of the file corresponds to a set of files (comma separated)\n";
 	std::cerr << "Options:\n";
+	std::cerr << "\t -I <file>: Index file of the files of -i built by build_index, used instead of indexing them\n";
+	std::cerr << "\t            (-k, -x, -m, -c, -w and -y are then given by the index file, -a is ignored)\n";
 	std::cerr << "\t -l </.../>: ABSOLUTE path to log folder\n";
 	std::cerr << "\t -o </.../>: ABSOLUTE path to output folder\n";
-	std::cerr << "\t -k <value>: Size of k-mers (value of k). [default=32]\n";
+	std::cerr << "\t -k <value>: Size of k-mers (value of k), at most 63. [default=32]\n";
 	std::cerr << "\t -t <value>: Number of shared k-mers. [default=2]\n";
+	std::cerr << "\t -p <value>: Number of threads. [default=1]\n";
+	std::cerr << "\t -x <type>: Type of index, classic, blocked (one cache line per k-mer), hashed or exact. [default=classic]\n";
+	std::cerr << "\t -m <size>: Memory budget of a blocked, hashed or exact index, in bytes or with K, M, G (ie 2G).\n";
+	std::cerr << "\t            A classic index becomes hashed. [default=2^(k-1) bytes]\n";
+	std::cerr << "\t -a <value>: Minimal number of occurrences of an indexed k-mer, up to 255 (ie 2 to ignore sequencing errors). [default=1]\n";
+	std::cerr << "\t -w <value>: Index and search only the (w,k)-minimizers, the k-mer of smallest hash of each window\n";
+	std::cerr << "\t            of w k-mers (about 2/(w+1) of the k-mers). -t then counts sampled k-mers. [default=1, all k-mers]\n";
+	std::cerr << "\t -y <value>: Index and search only the open syncmers, the k-mers whose s-mer of smallest hash is\n";
+	std::cerr << "\t            in their middle (about 1/(k-s+1) of the k-mers, k-s even). -t then counts sampled k-mers. [default=no syncmer]\n";
+	std::cerr << "\t -e <value>: Target false positive rate of the index, ie 0.01: a chunk of the index stops once its estimated\n";
+	std::cerr << "\t            false positive rate reaches it, instead of after a number of k-mers given by -m. [default=none]\n";
+	std::cerr << "\t -c: Index canonical k-mers and search both strands of a read at once [default=false]\n";
 	std::cerr << "\t -h: Prints this message and exit\n";
 	std::cerr << "\t -v: Prints the version number and exit\n";
 }
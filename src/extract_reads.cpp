@@ -120,6 +120,9 @@ int main (int argc, char ** argv)
 	} else if (c == '@') {
 		infile.close();
 		read_file = new FastqFile(input_file_name, bv_file_name);
+	} else if (c == 'C' && PackedReadFile::is_packed(input_file_name)) {
+		infile.close();
+		read_file = new PackedReadFile(input_file_name, bv_file_name);
 	} else {
 		infile.close();
 		gzFile tmp_gz_file = (gzFile) gzopen(input_file_name.c_str(), "r");
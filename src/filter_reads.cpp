@@ -133,6 +133,9 @@ int main (int argc, char ** argv)
 	} else if (c == '@') {
 		infile.close();
 		read_file = new FastqFile(input_file_name);
+	} else if (c == 'C' && PackedReadFile::is_packed(input_file_name)) {
+		infile.close();
+		read_file = new PackedReadFile(input_file_name);
 	} else {
 		infile.close();
 		gzFile tmp_gz_file = (gzFile) gzopen(input_file_name.c_str(), "r");
@@ -248,12 +251,11 @@ void print_usage () {
 
 int number_of_N (const std::string & read)
 {
-	Alphabet * alphabet = Alphabet::getInstance();
+	const unsigned char * codes = Alphabet::getInstance()->get_codes();
 	int nb = 0;
 	for (int i = 0; i < (int) read.size(); i++) {
-		if (!alphabet->is_in(read[i])) {
-			nb++;
-		}
+		// NOT_NUCLEOTIDE is the only code >= 4
+		nb += codes[(unsigned char) read[i]] >> 2;
 	}
 	return nb;
 }
@@ -29,11 +29,18 @@
 #include "file_manager.h"
 #include "file_manager_max.h"
 #include "bloom_filter.h"
+#include "index_memory.h"
+#include "index_type.h"
+#include "index_file.h"
+#include "partitioned_index.h"
 #include "boolean_vector.h"
 #include "set_parser.h"
+#include "wall_clock.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <limits.h>
 #include <iostream>
 #include <fstream>
@@ -44,10 +51,17 @@
 
 std::string version = "2.1";
 
+// Temporary partitioned index built in the output directory (-P) and its
+// number of partitions, removed at exit (see remove_partitioned_file)
+std::string partitioned_file_name;
+int nb_temporary_partitions = 0;
+
 // -----------------------------------------------------------------------
 //                              PROTOTYPE
 // -----------------------------------------------------------------------
 void print_usage ();
+void remove_partitioned_file ();
+void colored_search (std::vector <FileManager * > & index_sets, std::vector <FileManager * > & search_sets, const int & kmer_size, const int & min_hits, const unsigned long & max_kmer, const int & nb_threads, const int & index_type, const unsigned long & index_memory, const bool & canonical, const int & min_count, const KmerSampling & sampling, const double & max_fpr, const std::string & out_path, const std::string & log_path);
 
 // -----------------------------------------------------------------------
 //                                MAIN
@@ -67,10 +81,24 @@ int main (int argc, char ** argv)
 	std::map <std::string, std::vector <std::string> > index_file_names;
 	std::map <std::string, std::vector <std::string> > index_bv_names;
 	
+	// index file built by build_index
+	std::string index_file_name;
+	IndexFile * index_file = NULL;
+	
+	// partitioned index built in the output directory (-P)
+	int nb_partitions = 0;
+	double max_fpr = 0;
+	
 	// general parameters
 	int kmer_size = 33;
 	int min_hits = 2;
-	unsigned long max_kmer = (unsigned long) (1000000000.0 / pow (2, 33 - kmer_size));
+	int nb_threads = 1;
+	int index_type = CLASSIC_INDEX;
+	unsigned long index_memory = 0;
+	bool canonical = false;
+	int min_count = 1;
+	KmerSampling sampling;
+	unsigned long max_kmer;
 	
 	// path to output messages
 	std::string log_path = ".";
@@ -103,6 +131,15 @@ int main (int argc, char ** argv)
 			} else {
 				index_file_list = argv[arg_pos];
 			}
+		} else if (flag.compare("-I") == 0) {
+			// Index file built by build_index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_file_name = argv[arg_pos];
 		} else if (flag.compare("-s") == 0) {
 			// File name for list of search files
 			arg_pos++;
@@ -143,7 +180,10 @@ int main (int argc, char ** argv)
 				exit(1);
 			}
 			kmer_size = atoi(argv[arg_pos]);
-			max_kmer = (unsigned long) (1000000000.0 / pow (2, 33 - kmer_size));
+			if (kmer_size < 1 || kmer_size > MAX_KMER_SIZE) {
+				std::cerr << "Error, the size of k-mers must be between 1 and " << MAX_KMER_SIZE << "\n";
+				exit(1);
+			}
 			std::cout << "k-mer size (-k) = " << kmer_size << "\n";
 		} else if (flag.compare("-t") == 0) {
 			// The minimal number of hits to consider two reads as similar
@@ -155,6 +195,122 @@ int main (int argc, char ** argv)
 			}
 			min_hits = atoi(argv[arg_pos]);
 			std::cout << "min hits (-t) = " << min_hits << "\n";
+		} else if (flag.compare("-p") == 0) {
+			// The number of threads
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			nb_threads = atoi(argv[arg_pos]);
+			if (nb_threads < 1) {
+				nb_threads = 1;
+			}
+			std::cout << "threads (-p) = " << nb_threads << "\n";
+		} else if (flag.compare("-x") == 0) {
+			// The type of index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_type = parse_index_type(argv[arg_pos]);
+			if (index_type < 0) {
+				std::cerr << "Error, unknown index type " << argv[arg_pos] << "\n";
+				print_usage();
+				exit(1);
+			}
+			std::cout << "index type (-x) = " << argv[arg_pos] << "\n";
+		} else if (flag.compare("-m") == 0) {
+			// The memory budget of the index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			index_memory = parse_memory(argv[arg_pos]);
+			if (index_memory == 0) {
+				std::cerr << "Error, invalid memory size " << argv[arg_pos] << "\n";
+				print_usage();
+				exit(1);
+			}
+			std::cout << "index memory (-m) = " << index_memory << " bytes\n";
+		} else if (flag.compare("-a") == 0) {
+			// The minimal number of occurrences of an indexed k-mer
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			min_count = atoi(argv[arg_pos]);
+			if (min_count < 1 || min_count > COUNTER_MAX) {
+				std::cerr << "Error, the minimal count of k-mers must be between 1 and " << COUNTER_MAX << "\n";
+				exit(1);
+			}
+			std::cout << "min k-mer count (-a) = " << min_count << "\n";
+		} else if (flag.compare("-P") == 0) {
+			// The number of partitions of the index
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			nb_partitions = atoi(argv[arg_pos]);
+			if (nb_partitions < 1 || nb_partitions > MAX_PARTITIONS) {
+				std::cerr << "Error, the number of partitions must be between 1 and " << MAX_PARTITIONS << "\n";
+				exit(1);
+			}
+			std::cout << "partitions (-P) = " << nb_partitions << "\n";
+		} else if (flag.compare("-w") == 0) {
+			// The window of the sampling minimizers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			sampling.window = atoi(argv[arg_pos]);
+			if (sampling.window < 1) {
+				std::cerr << "Error, the window of minimizers must be at least 1\n";
+				exit(1);
+			}
+			std::cout << "minimizer window (-w) = " << sampling.window << "\n";
+		} else if (flag.compare("-y") == 0) {
+			// The size of the s-mers of the sampling syncmers
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			sampling.syncmer_size = atoi(argv[arg_pos]);
+			if (sampling.syncmer_size < 1) {
+				std::cerr << "Error, the size of syncmers must be at least 1\n";
+				exit(1);
+			}
+			std::cout << "syncmer size (-y) = " << sampling.syncmer_size << "\n";
+		} else if (flag.compare("-e") == 0) {
+			// The target false positive rate of the index chunks
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			max_fpr = atof(argv[arg_pos]);
+			if (max_fpr <= 0 || max_fpr >= 1) {
+				std::cerr << "Error, the target false positive rate must be between 0 and 1\n";
+				exit(1);
+			}
+			std::cout << "target false positive rate (-e) = " << max_fpr << "\n";
+		} else if (flag.compare("-c") == 0) {
+			canonical = true;
+			std::cout << "canonical k-mers (-c)\n";
 		} else if (flag.compare("-f") == 0) {
 			full = true;
 		} else if (flag.compare("-h") == 0) {
@@ -171,6 +327,52 @@ int main (int argc, char ** argv)
 		arg_pos++;
 	}
 	
+	// The parameters of an index file replace the given ones
+	if (!index_file_name.empty()) {
+		index_file = new IndexFile (index_file_name);
+		kmer_size = index_file->get_kmer_size();
+		index_type = index_file->get_index_type();
+		canonical = index_file->is_canonical();
+		sampling = index_file->get_sampling();
+		std::cout << "index file (-I) = " << index_file_name << ": set " << index_file->get_nickname() << ", " << index_file->get_nb_chunks() << (index_file->is_partitioned() ? " partition(s)" : " chunk(s)") << ", k-mer size = " << kmer_size << (canonical ? ", canonical k-mers" : "") << "\n";
+		if (full && index_file_list.empty()) {
+			std::cerr << "Error, the full comparison (-f) needs the indexed files (-i)\n";
+			exit(1);
+		}
+		if (nb_partitions > 0) {
+			std::cout << "the partitions are given by the index file, -P is ignored\n";
+			nb_partitions = 0;
+		}
+	} else if (index_file_list.empty()) {
+		std::cerr << "Error, no file to index (-i or -I)\n";
+		print_usage();
+		exit(1);
+	}
+	if (sampling.window > 1 && sampling.syncmer_size > 0) {
+		std::cerr << "Error, the k-mers are sampled either by minimizers (-w) or by syncmers (-y)\n";
+		exit(1);
+	}
+	if (sampling.syncmer_size > 0 && (sampling.syncmer_size >= kmer_size || (kmer_size - sampling.syncmer_size) % 2 != 0)) {
+		std::cerr << "Error, the size of syncmers (-y) must be lower than k, with an even difference\n";
+		exit(1);
+	}
+	if (max_fpr > 0 && (index_type == SLICED_INDEX || nb_partitions > 0)) {
+		std::cerr << "Error, the target false positive rate (-e) is not available with a sliced index or with partitions (-P)\n";
+		exit(1);
+	}
+	// The classic index cannot be resized, a memory budget needs a hashed one
+	// and so do partitions, which share the budget
+	if (index_memory > 0 && index_type == CLASSIC_INDEX) {
+		index_type = HASHED_INDEX;
+		std::cout << "index type = hashed (memory budget given)\n";
+	} else if (nb_partitions > 0 && index_type == CLASSIC_INDEX) {
+		index_type = HASHED_INDEX;
+		std::cout << "index type = hashed (partitions given)\n";
+	}
+	max_kmer = index_max_kmer(index_type, index_size(index_type, kmer_size, index_memory));
+	// Filters used by several threads are spread over the NUMA nodes
+	IndexMemory::getInstance()->set_nb_threads(nb_threads);
+	
 	////////////////////////////////////////////////////////////
 	// Check existence of out_path and log_path
 	// if not then create them
@@ -193,22 +395,33 @@ int main (int argc, char ** argv)
 	////////////////////////////////////////////////////////////
 	// Put index files in a file manager
 	//
-	read_sets(index_file_list, index_file_names, index_bv_names);
-	if (index_file_names.size() != 1) {
-		std::cerr << "Only one set of files is allowed for indexing\n";
-		exit(1);
-	}
-	index_set->set_nickname(index_file_names.begin()->first);
-	std::vector <std::string> tmp_index_file_names = index_file_names.begin()->second;
-	std::vector <std::string> tmp_index_bv_names = index_bv_names.begin()->second;
-	for (size_t file_pos = 0; file_pos < tmp_index_file_names.size(); file_pos++) {
-		if (tmp_index_bv_names[file_pos].empty()) {
-			std::cout << "open " << tmp_index_file_names[file_pos] << "\n";
-			index_set->addFile(tmp_index_file_names[file_pos]);
-		} else {
-			std::cout << "open " << tmp_index_file_names[file_pos] << "," << tmp_index_bv_names[file_pos] << "\n";
-			index_set->addFile(tmp_index_file_names[file_pos], tmp_index_bv_names[file_pos]);
+	// Several sets of files are indexed at once (colored search)
+	std::vector <FileManager * > index_sets;
+	if (!index_file_list.empty()) {
+		read_sets(index_file_list, index_file_names, index_bv_names);
+		if (index_file_names.size() != 1 && (full || index_file != NULL)) {
+			std::cerr << "Only one set of files is allowed for indexing with -f or -I\n";
+			exit(1);
 		}
+		for (std::map <std::string, std::vector <std::string> >::iterator it_set = index_file_names.begin(); it_set != index_file_names.end(); it_set++) {
+			FileManager * current_manager = index_sets.empty() ? index_set : new FileManager ();
+			current_manager->set_nickname(it_set->first);
+			std::vector <std::string> & tmp_index_file_names = it_set->second;
+			std::vector <std::string> & tmp_index_bv_names = index_bv_names[it_set->first];
+			for (size_t file_pos = 0; file_pos < tmp_index_file_names.size(); file_pos++) {
+				if (tmp_index_bv_names[file_pos].empty()) {
+					std::cout << "open " << tmp_index_file_names[file_pos] << "\n";
+					current_manager->addFile(tmp_index_file_names[file_pos]);
+				} else {
+					std::cout << "open " << tmp_index_file_names[file_pos] << "," << tmp_index_bv_names[file_pos] << "\n";
+					current_manager->addFile(tmp_index_file_names[file_pos], tmp_index_bv_names[file_pos]);
+				}
+			}
+			index_sets.push_back(current_manager);
+		}
+	}
+	if (index_file != NULL) {
+		index_set->set_nickname(index_file->get_nickname());
 	}
 	
 	////////////////////////////////////////////////////////////
@@ -233,6 +446,19 @@ int main (int argc, char ** argv)
 		}
 	}
 	
+	if (index_type == SLICED_INDEX && index_sets.size() < 2) {
+		std::cerr << "Error, a sliced index needs several sets of files to index (-i)\n";
+		exit(1);
+	}
+	if ((nb_partitions > 0 || (index_file != NULL && index_file->is_partitioned())) && (full || index_sets.size() > 1)) {
+		std::cerr << "Error, a partitioned index is not allowed with -f or several sets of files to index\n";
+		exit(1);
+	}
+	if (index_sets.size() > 1) {
+		colored_search(index_sets, search_sets, kmer_size, min_hits, max_kmer, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr, out_path, log_path);
+		return 0;
+	}
+	
 	////////////////////////////////////////////////////////////
 	// Create the index in a BloomFilter
 	// and
@@ -250,26 +476,77 @@ int main (int argc, char ** argv)
 	BloomFilter * index = NULL;
 	
 	clock_t index_time = 0;
+	unsigned long index_memory_used = 0;
+	IndexFill index_fill;
 	std::vector<clock_t> search_times (search_sets.size(), 0);
-	clock_t start_time = clock();
-	while (index_set->get_reads_count() < nb_reads_to_index) {
+	clock_t start_time = wall_clock();
+	unsigned long chunk = 0;
+	if (nb_partitions > 0) {
+		// Build the partitioned index in one pass, in a temporary index file
+		// A unique name, not to overwrite a file of the user, and removed at
+		// exit even after an error, with the temporary files of the partitions
+		std::string name_template = out_path + "/" + index_set->get_nickname() + ".cbf.XXXXXX";
+		const int fd = mkstemp(&name_template[0]);
+		if (fd == -1) {
+			std::cerr << "Cannot create temporary index file " << name_template << " -> exit\n";
+			exit(1);
+		}
+		close(fd);
+		partitioned_file_name = name_template;
+		nb_temporary_partitions = nb_partitions;
+		atexit(remove_partitioned_file);
+		IndexFileWriter partitioned_file (partitioned_file_name, kmer_size, index_type, canonical, index_set->get_nickname(), index_set->get_file_names(), partition_minimizer_size(kmer_size), sampling, min_count);
+		build_partitioned_index(partitioned_file, index_set, kmer_size, nb_partitions, index_type, index_memory, canonical, min_count, partitioned_file_name, sampling);
+		partitioned_file.close();
+		index_file = new IndexFile (partitioned_file_name);
+		index_time = wall_clock() - start_time;
+	}
+	if (index_file != NULL && index_file->is_partitioned()) {
+		// All the partitions are searched at once: each search set is read once
+		nb_indexed_reads = index_file->get_nb_indexed_reads();
+		for (chunk = 0; chunk < index_file->get_nb_chunks(); chunk++) {
+			index_memory_used += index_file->get_chunk_size(chunk);
+			unsigned long nb_partition_reads = 0;
+			BloomFilter * partition = index_file->get_chunk(chunk, nb_partition_reads);
+			index_fill.add(partition);
+			delete partition;
+		}
+		for (size_t set_pos = 0; set_pos < search_sets.size(); set_pos++) {
+			std::cout << "\n------------------------------------------------------------------\n";
+			std::cout << "finding reads from {" << search_sets[set_pos]->get_nickname() << "} present in raw {" << index_set->get_nickname() << "} (" << index_file->get_nb_chunks() << " partitions)\n";
+			std::cout << "------------------------------------------------------------------\n";
+			const clock_t search_start = wall_clock();
+			nb_found_reads[set_pos] = search_reads_partitioned(index_file, search_sets[set_pos], kmer_size, min_hits, nb_searched_reads[set_pos], nb_threads);
+			search_times[set_pos] = wall_clock() - search_start;
+		}
+	}
+	while (index_file != NULL ? chunk < index_file->get_nb_chunks() : index_set->get_reads_count() < nb_reads_to_index) {
 		if (index != NULL) {
 			delete index;
 			index = NULL;
 		}
 		// index
-		const clock_t index_start = clock();
-		index = index_reads (index_set, kmer_size, min_hits, max_kmer, nb_indexed_reads);
-		index_time += clock() - index_start;
+		const clock_t index_start = wall_clock();
+		if (index_file != NULL) {
+			index = index_file->get_chunk(chunk, nb_indexed_reads);
+		} else {
+			index = index_reads (index_set, kmer_size, min_hits, max_kmer, nb_indexed_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+		}
+		chunk++;
+		index_time += wall_clock() - index_start;
+		index_fill.add(index);
+		if ((unsigned long) index->get_size() > index_memory_used) {
+			index_memory_used = index->get_size();
+		}
 		
 		// search
 		for (size_t set_pos = 0; set_pos < search_sets.size(); set_pos++) {
 			std::cout << "\n------------------------------------------------------------------\n";
 			std::cout << "finding reads from {" << search_sets[set_pos]->get_nickname() << "} present in raw {" << index_set->get_nickname() << "}\n";
 			std::cout << "------------------------------------------------------------------\n";
-			const clock_t search_start = clock();
-			nb_found_reads[set_pos] += search_reads(index, search_sets[set_pos], kmer_size, min_hits, nb_searched_reads[set_pos]);
-			search_times[set_pos] += clock() - search_start;
+			const clock_t search_start = wall_clock();
+			nb_found_reads[set_pos] += search_reads(index, search_sets[set_pos], kmer_size, min_hits, nb_searched_reads[set_pos], nb_threads, sampling);
+			search_times[set_pos] += wall_clock() - search_start;
 			if (full) {
 				break;
 			}
@@ -281,8 +558,12 @@ int main (int argc, char ** argv)
 		std::cout << "Reads from {" << search_sets[set_pos]->get_nickname() << "} present in raw {" << index_set->get_nickname() << "}\n";
 		std::cout << "------------------------------------------------------------------\n";
 		std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+		std::cout << "Index  size: " << float (index_memory_used) / (1024 * 1024) << " MB\n";
+		std::cout << "Index  fill: " << index_fill.get_stats() << "\n";
+		std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
 		std::cout << "Search time: " << float (search_times[set_pos]) / CLOCKS_PER_SEC << " s\n";
-		std::cout << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		std::cout << "Search rate: " << (search_times[set_pos] > 0 ? (unsigned long) (nb_searched_reads[set_pos] / (float (search_times[set_pos]) / CLOCKS_PER_SEC)) : 0) << " reads/s\n";
+		std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 		std::cout << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads[set_pos] << ", shared " << nb_found_reads[set_pos] << "]\n";
 		
 		// Write on log file
@@ -294,8 +575,12 @@ int main (int argc, char ** argv)
 			exit(1);
 		}
 		log_file << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+		log_file << "Index  size: " << float (index_memory_used) / (1024 * 1024) << " MB\n";
+		log_file << "Index  fill: " << index_fill.get_stats() << "\n";
+		log_file << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
 		log_file << "Search time: " << float (search_times[set_pos]) / CLOCKS_PER_SEC << " s\n";
-		log_file << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		log_file << "Search rate: " << (search_times[set_pos] > 0 ? (unsigned long) (nb_searched_reads[set_pos] / (float (search_times[set_pos]) / CLOCKS_PER_SEC)) : 0) << " reads/s\n";
+		log_file << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 		log_file << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads[set_pos] << ", shared " << nb_found_reads[set_pos] << "]\n";
 		log_file.close();
 	}
@@ -322,28 +607,28 @@ int main (int argc, char ** argv)
 		search_sets[0]->rewind();
 		index_time = 0;
 		clock_t search_time = 0;
-		start_time = clock();
+		start_time = wall_clock();
 		while (search_sets[0]->get_reads_count() < nb_reads_to_index) {
 			if (index != NULL) {
 				delete index;
 				index = NULL;
 			}
-			const clock_t index_start = clock();
-			index = index_reads (search_sets[0], kmer_size, min_hits, max_kmer, nb_indexed_reads);
-			index_time += clock() - index_start;
-			const clock_t search_start = clock();
-			nb_found_reads += search_reads(index, index_set, kmer_size, min_hits, nb_searched_reads);
-			search_time += clock() - search_start;
+			const clock_t index_start = wall_clock();
+			index = index_reads (search_sets[0], kmer_size, min_hits, max_kmer, nb_indexed_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+			index_time += wall_clock() - index_start;
+			const clock_t search_start = wall_clock();
+			nb_found_reads += search_reads(index, index_set, kmer_size, min_hits, nb_searched_reads, nb_threads, sampling);
+			search_time += wall_clock() - search_start;
 		}
 		index_set->save_bv(out_path, search_sets[0]->get_nickname());
 		index_set->apply_bv_on_files();
 		std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
 		std::cout << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-		std::cout << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 		std::cout << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "]\n" << 100 * (float) nb_found_reads / (float) nb_reads_A <<"%\n";
 		log_file << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
 		log_file << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-		log_file << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		log_file << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 		log_file << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "]\n" << 100 * (float) nb_found_reads / (float) nb_reads_A <<"%\n";
 		log_file.close();
 		
@@ -365,27 +650,33 @@ int main (int argc, char ** argv)
 		index_set->rewind();
 		index_time = 0;
 		search_time = 0;
-		start_time = clock();
-		while (index_set->get_reads_count() < nb_reads_to_index) {
+		start_time = wall_clock();
+		chunk = 0;
+		while (index_file != NULL ? chunk < index_file->get_nb_chunks() : index_set->get_reads_count() < nb_reads_to_index) {
 			if (index != NULL) {
 				delete index;
 				index = NULL;
 			}
-			const clock_t index_start = clock();
-			index = index_reads (index_set, kmer_size, min_hits, max_kmer, nb_indexed_reads);
-			index_time += clock() - index_start;
-			const clock_t search_start = clock();
-			nb_found_reads += search_reads(index, search_sets[0], kmer_size, min_hits, nb_searched_reads);
-			search_time += clock() - search_start;
+			const clock_t index_start = wall_clock();
+			if (index_file != NULL) {
+				index = index_file->get_chunk(chunk, nb_indexed_reads);
+			} else {
+				index = index_reads (index_set, kmer_size, min_hits, max_kmer, nb_indexed_reads, nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+			}
+			chunk++;
+			index_time += wall_clock() - index_start;
+			const clock_t search_start = wall_clock();
+			nb_found_reads += search_reads(index, search_sets[0], kmer_size, min_hits, nb_searched_reads, nb_threads, sampling);
+			search_time += wall_clock() - search_start;
 		}
 		search_sets[0]->save_bv(out_path, index_set->get_nickname());
 		std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
 		std::cout << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-		std::cout << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 		std::cout << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "]\n" << 100 * (float) nb_found_reads / (float) nb_reads_B <<"%\n";
 		log_file << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
 		log_file << "Search time: " << float (search_time) / CLOCKS_PER_SEC << " s\n";
-		log_file << "Total  time: " << float (clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+		log_file << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
 		log_file << "[indexed " << nb_indexed_reads << ", searched " << nb_searched_reads << ", shared " << nb_found_reads << "]\n" << 100 * (float) nb_found_reads / (float) nb_reads_B <<"%\n";
 		log_file.close();
 	}
@@ -393,13 +684,181 @@ int main (int argc, char ** argv)
 	if (index != NULL) {
 		delete index;
 	}
-	
+	if (index_file != NULL) {
+		delete index_file;
+	}
 	for (size_t set_pos = 0; set_pos < search_sets.size(); set_pos++) {
-		search_sets[set_pos]->save_bv(out_path, index_file_names.begin()->first);
+		search_sets[set_pos]->save_bv(out_path, index_set->get_nickname());
 	}
 	return 0;
 }
 
+// -----------------------------------------------------------------------
+//                            COLORED SEARCH
+// -----------------------------------------------------------------------
+// Search each set of search_sets once in the indexes of all index_sets.
+// The results are the same as with one run of index_and_search per index
+// set: for each index set, the found reads of each file are saved in a .bv
+// file and the statistics of each searched set are written in a log file.
+// At each round, the next chunk of every index set is built, so the memory
+// used is the size of one index (-m) times the number of index sets.
+// With a bit-sliced index (-x sliced), the chunks of a round are the slices
+// of a single index, and -m is the memory of this index.
+void colored_search (std::vector <FileManager * > & index_sets, std::vector <FileManager * > & search_sets, const int & kmer_size, const int & min_hits, const unsigned long & max_kmer, const int & nb_threads, const int & index_type, const unsigned long & index_memory, const bool & canonical, const int & min_count, const KmerSampling & sampling, const double & max_fpr, const std::string & out_path, const std::string & log_path)
+{
+	const size_t nb_colors = index_sets.size();
+	ColoredIndexes colored;
+	colored.indexes.assign(nb_colors, NULL);
+	SlicedBloomFilter * sliced = NULL;
+	unsigned long color_max_kmer = max_kmer;
+	if (index_type == SLICED_INDEX) {
+		sliced = new_sliced_index(kmer_size, nb_colors, index_memory);
+		sliced->set_canonical(canonical);
+		color_max_kmer = index_max_kmer(HASHED_INDEX, sliced->get_nb_rows() / 8);
+		std::cout << "sliced index: " << nb_colors << " colors, " << sliced->get_nb_rows() << " rows of " << 8 * sliced->get_row_bytes() << " bits\n";
+	}
+	colored.sliced = sliced;
+	std::vector <unsigned long> nb_reads_to_index (nb_colors);
+	std::vector <unsigned long> nb_indexed_reads (nb_colors, 0);
+	for (size_t color = 0; color < nb_colors; color++) {
+		nb_reads_to_index[color] = index_sets[color]->get_total_nb_reads();
+	}
+	
+	// For each searched set, the reads found in each index set
+	std::vector < std::vector < std::vector<BooleanVector> > > set_colors (search_sets.size());
+	std::vector < std::vector <unsigned long> > nb_found_reads (search_sets.size(), std::vector <unsigned long> (nb_colors, 0));
+	std::vector < std::vector <unsigned long> > nb_searched_reads (search_sets.size(), std::vector <unsigned long> (nb_colors, 0));
+	std::vector <unsigned long> nb_read_reads (search_sets.size(), 0);
+	for (size_t set_pos = 0; set_pos < search_sets.size(); set_pos++) {
+		set_colors[set_pos].assign(nb_colors, search_sets[set_pos]->get_empty_bvs());
+	}
+	
+	clock_t index_time = 0;
+	unsigned long index_memory_used = 0;
+	// The fill of each index, or of the sliced index
+	std::vector<IndexFill> index_fills (sliced != NULL ? 1 : nb_colors);
+	std::vector<clock_t> search_times (search_sets.size(), 0);
+	const clock_t start_time = wall_clock();
+	while (true) {
+		// index the next chunk of each index set
+		const clock_t index_start = wall_clock();
+		unsigned long round_memory = 0;
+		bool indexed = false;
+		if (sliced != NULL) {
+			sliced->clear();
+			round_memory = sliced->get_size();
+		}
+		for (size_t color = 0; color < nb_colors; color++) {
+			if (sliced == NULL) {
+				delete colored.indexes[color];
+			}
+			colored.indexes[color] = NULL;
+			if (index_sets[color]->get_reads_count() < nb_reads_to_index[color]) {
+				if (sliced != NULL) {
+					sliced->set_color(color);
+					index_reads_into(sliced, index_sets[color], kmer_size, color_max_kmer, nb_indexed_reads[color], nb_threads, min_count, sampling);
+					colored.indexes[color] = sliced;
+				} else {
+					colored.indexes[color] = index_reads (index_sets[color], kmer_size, min_hits, max_kmer, nb_indexed_reads[color], nb_threads, index_type, index_memory, canonical, min_count, sampling, max_fpr);
+					round_memory += colored.indexes[color]->get_size();
+				}
+				indexed = true;
+			}
+		}
+		index_time += wall_clock() - index_start;
+		if (!indexed) {
+			break;
+		}
+		if (round_memory > index_memory_used) {
+			index_memory_used = round_memory;
+		}
+		if (sliced != NULL) {
+			index_fills[0].add(sliced);
+		} else {
+			for (size_t color = 0; color < nb_colors; color++) {
+				if (colored.indexes[color] != NULL) {
+					index_fills[color].add(colored.indexes[color]);
+				}
+			}
+		}
+		
+		// search
+		for (size_t set_pos = 0; set_pos < search_sets.size(); set_pos++) {
+			std::cout << "\n------------------------------------------------------------------\n";
+			std::cout << "finding reads from {" << search_sets[set_pos]->get_nickname() << "} present in raw {";
+			for (size_t color = 0; color < nb_colors; color++) {
+				if (colored.indexes[color] != NULL) {
+					std::cout << " " << index_sets[color]->get_nickname();
+				}
+			}
+			std::cout << " }\n";
+			std::cout << "------------------------------------------------------------------\n";
+			const clock_t search_start = wall_clock();
+			colored.colors.swap(set_colors[set_pos]);
+			unsigned long nb_reads = 0;
+			search_reads_colors(&colored, search_sets[set_pos], kmer_size, min_hits, nb_found_reads[set_pos], nb_searched_reads[set_pos], nb_reads, nb_threads, sampling);
+			nb_read_reads[set_pos] += nb_reads;
+			colored.colors.swap(set_colors[set_pos]);
+			search_times[set_pos] += wall_clock() - search_start;
+		}
+	}
+	
+	for (size_t set_pos = 0; set_pos < search_sets.size(); set_pos++) {
+		for (size_t color = 0; color < nb_colors; color++) {
+			std::cout << "\n------------------------------------------------------------------\n";
+			std::cout << "Reads from {" << search_sets[set_pos]->get_nickname() << "} present in raw {" << index_sets[color]->get_nickname() << "}\n";
+			std::cout << "------------------------------------------------------------------\n";
+			std::cout << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+			std::cout << "Index  size: " << float (index_memory_used) / (1024 * 1024) << " MB\n";
+			std::cout << "Index  fill: " << index_fills[sliced != NULL ? 0 : color].get_stats() << "\n";
+			std::cout << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+			std::cout << "Search time: " << float (search_times[set_pos]) / CLOCKS_PER_SEC << " s\n";
+			std::cout << "Search rate: " << (search_times[set_pos] > 0 ? (unsigned long) (nb_read_reads[set_pos] / (float (search_times[set_pos]) / CLOCKS_PER_SEC)) : 0) << " reads/s\n";
+			std::cout << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+			std::cout << "[indexed " << nb_indexed_reads[color] << ", searched " << nb_searched_reads[set_pos][color] << ", shared " << nb_found_reads[set_pos][color] << "]\n";
+			
+			// Write on log file
+			std::string fname = log_path + "/" + search_sets[set_pos]->get_nickname() + "_in_" + index_sets[color]->get_nickname() + ".log";
+			std::ofstream log_file;
+			log_file.open(fname.c_str());
+			if (!log_file.good()) {
+				std::cerr << "Cannot open log file : " << fname << "\n";
+				exit(1);
+			}
+			log_file << "Index  time: " << float (index_time) / CLOCKS_PER_SEC << " s\n";
+			log_file << "Index  size: " << float (index_memory_used) / (1024 * 1024) << " MB\n";
+			log_file << "Index  fill: " << index_fills[sliced != NULL ? 0 : color].get_stats() << "\n";
+			log_file << "Index pages: " << IndexMemory::getInstance()->get_stats() << "\n";
+			log_file << "Search time: " << float (search_times[set_pos]) / CLOCKS_PER_SEC << " s\n";
+			log_file << "Search rate: " << (search_times[set_pos] > 0 ? (unsigned long) (nb_read_reads[set_pos] / (float (search_times[set_pos]) / CLOCKS_PER_SEC)) : 0) << " reads/s\n";
+			log_file << "Total  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+			log_file << "[indexed " << nb_indexed_reads[color] << ", searched " << nb_searched_reads[set_pos][color] << ", shared " << nb_found_reads[set_pos][color] << "]\n";
+			log_file.close();
+			
+			search_sets[set_pos]->save_bv(out_path, index_sets[color]->get_nickname(), set_colors[set_pos][color]);
+		}
+	}
+	delete sliced;
+}
+
+// -----------------------------------------------------------------------
+//                        REMOVE PARTITIONED FILE
+// -----------------------------------------------------------------------
+// Remove the temporary partitioned index file and the temporary files of
+// its partitions, if any are left (see build_partitioned_index)
+void remove_partitioned_file ()
+{
+	if (partitioned_file_name.empty()) {
+		return;
+	}
+	remove(partitioned_file_name.c_str());
+	for (int partition = 0; partition < nb_temporary_partitions; partition++) {
+		std::stringstream file_name;
+		file_name << partitioned_file_name << "." << partition;
+		remove(file_name.str().c_str());
+	}
+}
+
 // -----------------------------------------------------------------------
 //                             PRINT USAGE
 // -----------------------------------------------------------------------
@@ -408,14 +867,33 @@ void print_usage ()
 	std::cerr << "\nindex_and_search, version " << version << "\n";
 	std::cerr << "Usage : ./index_and_search -i <file> -s <file> [options]\n";
 	std::cerr << "Mandatory:\n";
-	std::cerr << "\t -i <file>: A file containing the list of files to index - MANDATORY\n";
+	std::cerr << "\t -i <file>: A file containing the list of files to index - MANDATORY without -I\n";
+	std::cerr << "\t            With several sets of files, each searched read is read once and searched in all of them\n";
 	std::cerr << "\t -s <file>: A file containing the list of files to search - MANDATORY\n";
 	std::cerr << "\t            Each line of the file corresponds to a set of files to search\n";
 	std::cerr << "Options:\n";
+	std::cerr << "\t -I <file>: Index file built by build_index, used instead of indexing the files of -i\n";
+	std::cerr << "\t            (-k, -x, -m, -c, -w and -y are then given by the index file, -a is ignored)\n";
 	std::cerr << "\t -l </.../>: ABSOLUTE path to log folder\n";
 	std::cerr << "\t -o </.../>: ABSOLUTE path to output folder\n";
-	std::cerr << "\t -k <value>: Size of k-mers (value of k). [default=33]\n";
+	std::cerr << "\t -k <value>: Size of k-mers (value of k), at most 63. [default=33]\n";
 	std::cerr << "\t -t <value>: Number of shared k-mers. [default=2]\n";
+	std::cerr << "\t -p <value>: Number of threads. [default=1]\n";
+	std::cerr << "\t -x <type>: Type of index, classic, blocked (one cache line per k-mer), hashed, exact,\n";
+	std::cerr << "\t            or sliced (one filter for several sets to index). [default=classic]\n";
+	std::cerr << "\t -m <size>: Memory budget of a blocked, hashed or exact index, in bytes or with K, M, G (ie 2G).\n";
+	std::cerr << "\t            A classic index becomes hashed. [default=2^(k-1) bytes]\n";
+	std::cerr << "\t -a <value>: Minimal number of occurrences of an indexed k-mer, up to 255 (ie 2 to ignore sequencing errors). [default=1]\n";
+	std::cerr << "\t -P <value>: Number of partitions of the index, up to " << MAX_PARTITIONS << ": the k-mers are split by minimizer instead of the reads\n";
+	std::cerr << "\t            in chunks, and each searched set is read once (not with -f or several sets to index). The partitions share the memory\n";
+	std::cerr << "\t            budget (-m) and a classic index becomes hashed. [default=no partition]\n";
+	std::cerr << "\t -w <value>: Index and search only the (w,k)-minimizers, the k-mer of smallest hash of each window\n";
+	std::cerr << "\t            of w k-mers (about 2/(w+1) of the k-mers). -t then counts sampled k-mers. [default=1, all k-mers]\n";
+	std::cerr << "\t -y <value>: Index and search only the open syncmers, the k-mers whose s-mer of smallest hash is\n";
+	std::cerr << "\t            in their middle (about 1/(k-s+1) of the k-mers, k-s even). -t then counts sampled k-mers. [default=no syncmer]\n";
+	std::cerr << "\t -e <value>: Target false positive rate of the index, ie 0.01: a chunk of the index stops once its estimated\n";
+	std::cerr << "\t            false positive rate reaches it, instead of after a number of k-mers given by -m. [default=none]\n";
+	std::cerr << "\t -c: Index canonical k-mers and search both strands of a read at once [default=false]\n";
 	std::cerr << "\t -f: Full comparison of index set and the first searched set [default=false]\n";
 	std::cerr << "\t -h: Prints this message\n";
 	std::cerr << "\t -v: Prints the version number\n";
@@ -0,0 +1,216 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bloom_filter.h"
+#include "index_memory.h"
+#include "index_type.h"
+#include "index_file.h"
+#include "wall_clock.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
+
+std::string version = "2.1";
+
+// -----------------------------------------------------------------------
+//                              PROTOTYPE
+// -----------------------------------------------------------------------
+void print_usage ();
+
+// Return true if the filters of both index files can be ORed chunk by chunk
+bool same_geometry (const IndexFile * a, const IndexFile * b)
+{
+	if (a->get_kmer_size() != b->get_kmer_size() || a->get_index_type() != b->get_index_type() || a->is_canonical() != b->is_canonical()) {
+		return false;
+	}
+	if (a->get_minimizer_size() != b->get_minimizer_size() || a->get_sampling().window != b->get_sampling().window || a->get_sampling().syncmer_size != b->get_sampling().syncmer_size) {
+		return false;
+	}
+	if (a->get_nb_chunks() != b->get_nb_chunks()) {
+		return false;
+	}
+	for (unsigned long chunk = 0; chunk < a->get_nb_chunks(); chunk++) {
+		if (a->get_chunk_size(chunk) != b->get_chunk_size(chunk)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------
+//                                MAIN
+// -----------------------------------------------------------------------
+
+int main (int argc, char ** argv)
+{
+	std::vector<std::string> in_file_names;
+	std::string out_file;
+	std::string nickname;
+	
+	////////////////////////////////////////////////////////////
+	// Read command line arguments
+	//
+	if (argc == 1) {
+		print_usage ();
+		return (0);
+	}
+	int arg_pos = 1;
+	while (arg_pos < argc){
+		std::string flag = argv[arg_pos];
+		if (flag.compare("-o") == 0) {
+			// The merged index file to write
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			out_file = argv[arg_pos];
+		} else if (flag.compare("-n") == 0) {
+			// The name of the merged set
+			arg_pos++;
+			if (arg_pos >= argc) {
+				std::cerr << "Error, flag " << argv[arg_pos - 1] << " needs an argument\n";
+				print_usage();
+				exit(1);
+			}
+			nickname = argv[arg_pos];
+		} else if (flag.compare("-h") == 0) {
+			print_usage ();
+			return 0;
+		} else if (flag.compare("-v") == 0) {
+			std::cout << "\nmerge_index version " << version << "\n";
+			return 0;
+		} else if (flag[0] == '-') {
+			std::cerr << "Unknown option " << flag << "\n";
+			print_usage ();
+			return (0);
+		} else {
+			in_file_names.push_back(flag);
+		}
+		arg_pos++;
+	}
+	
+	if (in_file_names.empty()) {
+		std::cerr << "Error, no index file to merge\n";
+		print_usage();
+		exit(1);
+	}
+	if (out_file.empty()) {
+		std::cerr << "Error, no merged index file (-o)\n";
+		print_usage();
+		exit(1);
+	}
+	if (nickname.empty()) {
+		nickname = out_file.substr(out_file.rfind("/") + 1);
+		if (nickname.size() > 4 && nickname.compare(nickname.size() - 4, 4, ".cbf") == 0) {
+			nickname = nickname.substr(0, nickname.size() - 4);
+		}
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Open the index files and check that their filters can be ORed
+	//
+	std::vector<IndexFile *> index_files;
+	std::vector<std::string> sources;
+	for (size_t file_pos = 0; file_pos < in_file_names.size(); file_pos++) {
+		std::cout << "open " << in_file_names[file_pos] << "\n";
+		IndexFile * index_file = new IndexFile (in_file_names[file_pos]);
+		if (index_file->get_index_type() == EXACT_INDEX) {
+			std::cerr << "Error, " << in_file_names[file_pos] << " is an exact index, whose k-mers are compressed and cannot be merged\n";
+			exit(1);
+		}
+		if (!index_file->is_partitioned() && index_file->get_nb_chunks() != 1) {
+			std::cerr << "Error, " << in_file_names[file_pos] << " has " << index_file->get_nb_chunks() << " chunks, build it with a larger memory budget (-m) or with partitions (-P)\n";
+			exit(1);
+		}
+		if (!index_files.empty() && !same_geometry(index_files[0], index_file)) {
+			std::cerr << "Error, " << in_file_names[file_pos] << " and " << in_file_names[0] << " are not built with the same parameters (-k, -x, -m, -P, -w, -y, -c)\n";
+			exit(1);
+		}
+		sources.insert(sources.end(), index_file->get_sources().begin(), index_file->get_sources().end());
+		index_files.push_back(index_file);
+	}
+	
+	////////////////////////////////////////////////////////////
+	// OR the filters chunk by chunk (partition by partition)
+	// and write them in the merged index file
+	//
+	const IndexFile * first = index_files[0];
+	// -a and -e are kept if all the index files were built with the same
+	int min_count = first->get_min_count();
+	double max_fpr = first->get_max_fpr();
+	for (size_t file_pos = 1; file_pos < index_files.size(); file_pos++) {
+		if (index_files[file_pos]->get_min_count() != min_count) {
+			min_count = 0;
+		}
+		if (index_files[file_pos]->get_max_fpr() != max_fpr) {
+			max_fpr = -1;
+		}
+	}
+	IndexFileWriter merged_file (out_file, first->get_kmer_size(), first->get_index_type(), first->is_canonical(), nickname, sources, first->get_minimizer_size(), first->get_sampling(), min_count, max_fpr);
+	unsigned long nb_indexed_reads = 0;
+	clock_t start_time = wall_clock();
+	for (unsigned long chunk = 0; chunk < first->get_nb_chunks(); chunk++) {
+		unsigned long nb_chunk_reads = 0;
+		BloomFilter * merged = new_index(first->get_index_type(), first->get_kmer_size(), first->get_chunk_size(chunk));
+		for (size_t file_pos = 0; file_pos < index_files.size(); file_pos++) {
+			BloomFilter * index = index_files[file_pos]->get_chunk(chunk, nb_chunk_reads);
+			merged->merge(*index);
+			delete index;
+		}
+		merged_file.add_chunk(merged, nb_chunk_reads);
+		delete merged;
+		nb_indexed_reads += nb_chunk_reads;
+	}
+	merged_file.close();
+	std::cout << "Merge  time: " << float (wall_clock() - start_time) / CLOCKS_PER_SEC << " s\n";
+	std::cout << "[merged " << index_files.size() << " index file(s), " << nb_indexed_reads << " reads of {" << nickname << "} in " << first->get_nb_chunks() << (first->is_partitioned() ? " partition(s)" : " chunk(s)") << " -> " << out_file << "]\n";
+	for (size_t file_pos = 0; file_pos < index_files.size(); file_pos++) {
+		delete index_files[file_pos];
+	}
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+//                             PRINT USAGE
+// -----------------------------------------------------------------------
+void print_usage ()
+{
+	std::cerr << "\nmerge_index, version " << version << "\n";
+	std::cerr << "Usage : ./merge_index -o <file> <index file 1> <index file 2> ... [options]\n";
+	std::cerr << "Mandatory:\n";
+	std::cerr << "\t -o <file>: Merged index file to write - MANDATORY\n";
+	std::cerr << "\t <index file>: Index files built by build_index with the same options (-k, -x, -m, -P, -w, -y, -c) - MANDATORY\n";
+	std::cerr << "Options:\n";
+	std::cerr << "\t -n <name>: Name of the merged set. [default=name of the merged index file]\n";
+	std::cerr << "\t -h: Prints this message\n";
+	std::cerr << "\t -v: Prints the version number\n";
+	std::cerr << "The merged index contains the k-mers of all the index files, it is given to index_and_search\n";
+	std::cerr << "or compare_reads with -I <file>. Exact indexes and indexes of several chunks cannot be merged.\n";
+}
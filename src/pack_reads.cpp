@@ -0,0 +1,160 @@
+/*
+ * Contributors :
+ *   Pierre PETERLONGO, pierre.peterlongo@inria.fr [12/06/13]
+ *   Nicolas MAILLET, nicolas.maillet@inria.fr     [12/06/13]
+ *   Guillaume Collet, guillaume@gcollet.fr        [27/05/14]
+ *
+ * This software is a computer program whose purpose is to find all the
+ * similar reads between two set of NGS reads. It also provide a similarity
+ * score between the two samples.
+ *
+ * Copyright (C) 2014  INRIA
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <ctime>
+#include "file_manager.h"
+#include "packed_read_file.h"
+
+std::string version = "2.1";
+
+// -----------------------------------------------------------------------
+//                             PROTOTYPES
+// -----------------------------------------------------------------------
+
+void print_usage ();
+
+// -----------------------------------------------------------------------
+//                                MAIN
+// -----------------------------------------------------------------------
+
+int main (int argc, char ** argv)
+{
+	const clock_t begin_time = clock();
+	
+	std::string input_file_name;
+	std::string output_file_name;
+	
+	int arg_pos = 1;
+	while (arg_pos < argc){
+		std::string flag = argv[arg_pos];
+		if (flag[0] != '-') {
+			if (input_file_name.empty()) {
+				input_file_name = flag;
+			} else if (output_file_name.empty()){
+				output_file_name = flag;
+			} else {
+				std::cout << "The mandatory files are already set, unknown file " << flag << " -> ignore\n";
+			}
+		} else if (flag.compare("-o") == 0) {
+			arg_pos++;
+			output_file_name = argv[arg_pos];
+		} else if (flag.compare("-h") == 0) {
+			print_usage ();
+			return 0;
+		} else if (flag.compare("-v") == 0) {
+			std::cout << "\npack_reads version " << version << "\n";
+			return 0;
+		} else {
+			std::cerr << "Unknown option " << flag << "\n";
+			print_usage ();
+			return 1;
+		}
+		arg_pos++;
+	}
+	
+	if (input_file_name.empty()) {
+		std::cerr << "Error: An input file name is needed -> exit\n";
+		print_usage ();
+		return 1;
+	}
+	if (output_file_name.empty()) {
+		output_file_name = input_file_name + ".pk";
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Open the given file to check its type (fasta, fastq, gzip ?)
+	//
+	ReadFile * read_file = NULL;
+	
+	std::ifstream infile;
+	infile.open(input_file_name.c_str());
+	if (!infile.good()) {
+		std::cerr << "Cannot open file " << input_file_name << " -> quit\n";
+		return 1;
+	}
+	// Check the first char
+	char c = infile.get();
+	if (c == '>') {
+		infile.close();
+		read_file = new FastaFile(input_file_name);
+	} else if (c == '@') {
+		infile.close();
+		read_file = new FastqFile(input_file_name);
+	} else if (c == 'C' && PackedReadFile::is_packed(input_file_name)) {
+		std::cerr << input_file_name << " is already a packed read file -> quit\n";
+		return 1;
+	} else {
+		infile.close();
+		gzFile tmp_gz_file = (gzFile) gzopen(input_file_name.c_str(), "r");
+		if (!tmp_gz_file) {
+			std::cerr << "Cannot open file " << input_file_name << " -> quit\n";
+			exit(1);
+		}
+		c = gzgetc(tmp_gz_file);
+		if (c == '>') {
+			gzclose(tmp_gz_file);
+			read_file = new GzFastaFile(input_file_name);
+		} else if (c == '@') {
+			gzclose(tmp_gz_file);
+			read_file = new GzFastqFile(input_file_name);
+		} else {
+			std::cerr << "Unknown format: " << input_file_name << " -> quit\n";
+			exit(1);
+		}
+	}
+	
+	////////////////////////////////////////////////////////////
+	// Write the packed reads
+	//
+	PackedReadFile::pack(*read_file, output_file_name);
+	struct stat input_info, output_info;
+	stat(input_file_name.c_str(), &input_info);
+	stat(output_file_name.c_str(), &output_info);
+	std::cout << read_file->get_nb_reads() << " reads of " << input_file_name << " (" << input_info.st_size << " bytes) packed in " << output_file_name << " (" << output_info.st_size << " bytes)\n";
+	delete read_file;
+	std::cout << "Total  time : " << float (clock () - begin_time) / CLOCKS_PER_SEC << " s\n";
+	return 0;
+}
+
+
+// -----------------------------------------------------------------------
+//                                USAGE
+// -----------------------------------------------------------------------
+
+void print_usage () {
+	std::cout << "\npack_reads v" << version << "\n";
+	std::cout << "Usage:\n\t./pack_reads <input_file> [options]\n";
+	std::cout << "Mandatory:\n";
+	std::cout << "\t<input_file>\t: file containing reads, in fasta or fastq format, gzipped or not\n";
+	std::cout << "Options:\n";
+	std::cout << "\t -o string\t: packed read file [default=input_file.pk]\n";
+	std::cout << "\t -h\t\t: prints this help\n";
+	std::cout << "\t -v\t\t: prints the version number.\n\n";
+}